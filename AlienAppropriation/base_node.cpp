@@ -4,7 +4,9 @@
 namespace game
 {
 
-BaseNode::BaseNode(std::string name) : mName(name)
+std::atomic<uint32_t> BaseNode::mNextId(1);
+
+BaseNode::BaseNode(std::string name) : mId(mNextId++), mName(name), mParentNode(nullptr)
 {
 }
 
@@ -17,6 +19,10 @@ void BaseNode::update(double deltaTime)
 	for (BaseNode* n : getChildNodes())	n->update(deltaTime);
 }
 
+void BaseNode::onDeleted(void)
+{
+}
+
 void BaseNode::removeChildNode(std::string name)
 {
 	int index = 0;
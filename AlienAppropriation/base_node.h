@@ -3,6 +3,10 @@
 #include <glm/glm.hpp>
 #include <string.h>
 #include <vector>
+#include <atomic>
+#include <stdint.h>
+
+#include "node_pool.h"
 
 
 
@@ -15,6 +19,7 @@ namespace game
 	class BaseNode {
 
 	protected:
+		uint32_t mId; // Unique for the lifetime of the game, never reused
 		std::string mName;
 		BaseNode* mParentNode;
 		std::vector<BaseNode*> mChildNodes;
@@ -23,11 +28,20 @@ namespace game
 
 	public:
 		BaseNode(std::string name);
-		~BaseNode();
+		virtual ~BaseNode();
+
+		// Every node, whatever its type, lives in the NodePool. The destructor is virtual, so size is the
+		// size of the type actually being deleted
+		static void* operator new(size_t size) { return NodePool::Allocate(size); }
+		static void operator delete(void* node, size_t size) { NodePool::Free(node, size); }
 
 		virtual void update(double deltaTime);
 
+		// Called when the node leaves the scene, before anything else can see it gone
+		virtual void onDeleted(void);
+
 		// Getters
+		inline uint32_t getId() const { return mId; }
 		const std::string getName() const { return mName; }
 		inline BaseNode* getParentNode() { return mParentNode; }
 		inline std::vector<BaseNode*> getChildNodes() { return mChildNodes; }
@@ -38,6 +52,7 @@ namespace game
 
 		// Children
 		template<class T> void addChildNode(T* n) { mChildNodes.push_back(n);}
+		template<class T> void addChildNodes(T* const* nodes, size_t count) { mChildNodes.insert(mChildNodes.end(), nodes, nodes + count); }
 		void removeChildNode(std::string name);
 		void removeChildNode(BaseNode* node);
 
@@ -47,6 +62,10 @@ namespace game
 		void addTag(std::string tag);
 		void removeTag(std::string tag);
 		bool hasTag(std::string tag);
+		inline const std::vector<std::string>& getTags() const { return tags; }
+
+	private:
+		static std::atomic<uint32_t> mNextId;
 
 	};
 
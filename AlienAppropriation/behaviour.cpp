@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <new>
+
+#include "behaviour.h"
+
+namespace game {
+
+struct BehaviourScheduler::Task {
+	std::coroutine_handle<Behaviour::promise_type> handle; // Null while the slot is free
+	uint32_t generation; // Bumped every time the slot is released
+};
+
+double BehaviourScheduler::mTime = 0.0;
+uint64_t BehaviourScheduler::mNextSequence = 0;
+std::vector<BehaviourScheduler::Task> BehaviourScheduler::mTasks;
+std::vector<uint32_t> BehaviourScheduler::mFreeSlots;
+std::vector<BehaviourScheduler::Timer> BehaviourScheduler::mTimers;
+std::vector<uint32_t> BehaviourScheduler::mWaiting;
+std::vector<BehaviourScheduler::Timer> BehaviourScheduler::mDue;
+void* BehaviourScheduler::mFreeFrames[FRAME_CLASSES] = {};
+std::mutex BehaviourScheduler::mFrameMutex;
+
+bool BehaviourScheduler::LaterTimer(const Timer& a, const Timer& b)
+{
+	if (a.time != b.time) return a.time > b.time;
+	return a.sequence > b.sequence;
+}
+
+
+BehaviourHandle BehaviourScheduler::Start(Behaviour behaviour)
+{
+	uint32_t slot;
+	if (!mFreeSlots.empty()) {
+		slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else {
+		slot = (uint32_t)mTasks.size();
+		Task task;
+		task.handle = nullptr;
+		task.generation = 0;
+		mTasks.push_back(task);
+	}
+
+	Task& task = mTasks[slot];
+	task.handle = behaviour.release();
+	task.handle.promise().slot = slot;
+
+	Sleep(slot, 0.0);
+
+	BehaviourHandle handle;
+	handle.slot = slot;
+	handle.generation = task.generation;
+	return handle;
+}
+
+
+void BehaviourScheduler::Stop(BehaviourHandle handle)
+{
+	if (handle.slot >= mTasks.size() || mTasks[handle.slot].generation != handle.generation || !mTasks[handle.slot].handle) return;
+
+	// Its timer is left in the heap and skipped when it comes up, since the generation will not match
+	mWaiting.erase(std::remove(mWaiting.begin(), mWaiting.end(), handle.slot), mWaiting.end());
+	Release(handle.slot);
+}
+
+
+void BehaviourScheduler::Sleep(uint32_t slot, double seconds)
+{
+	Timer timer;
+	timer.time = mTime + seconds;
+	timer.sequence = mNextSequence++;
+	timer.slot = slot;
+	timer.generation = mTasks[slot].generation;
+	mTimers.push_back(timer);
+	std::push_heap(mTimers.begin(), mTimers.end(), LaterTimer);
+}
+
+
+void BehaviourScheduler::WaitUntil(uint32_t slot)
+{
+	mWaiting.push_back(slot);
+}
+
+
+void BehaviourScheduler::update(double deltaTime)
+{
+	mTime += deltaTime;
+
+	// Collect everything due before resuming anything, so a behaviour that sleeps for 0 waits for the next tick
+	mDue.clear();
+	while (!mTimers.empty() && mTimers.front().time <= mTime) {
+		std::pop_heap(mTimers.begin(), mTimers.end(), LaterTimer);
+		Timer timer = mTimers.back();
+		mTimers.pop_back();
+		if (mTasks[timer.slot].generation == timer.generation) {
+			mDue.push_back(timer);
+		}
+	}
+
+	for (size_t i = 0; i < mWaiting.size(); ) {
+		Task& task = mTasks[mWaiting[i]];
+		if (task.handle.promise().condition()) {
+			Timer timer;
+			timer.time = mTime;
+			timer.sequence = 0;
+			timer.slot = mWaiting[i];
+			timer.generation = task.generation;
+			task.handle.promise().condition = nullptr;
+			mDue.push_back(timer);
+
+			mWaiting[i] = mWaiting.back();
+			mWaiting.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+
+	for (const Timer& due : mDue) {
+		// A behaviour resumed earlier in this loop may have stopped this one
+		if (mTasks[due.slot].generation == due.generation) {
+			Resume(due.slot);
+		}
+	}
+}
+
+
+void BehaviourScheduler::Resume(uint32_t slot)
+{
+	std::coroutine_handle<Behaviour::promise_type> handle = mTasks[slot].handle;
+	handle.resume();
+	if (handle.done()) {
+		Release(slot);
+	}
+}
+
+
+void BehaviourScheduler::Release(uint32_t slot)
+{
+	Task& task = mTasks[slot];
+	std::coroutine_handle<Behaviour::promise_type> handle = task.handle;
+	task.handle = nullptr;
+	task.generation++;
+	mFreeSlots.push_back(slot);
+
+	// Destroying the frame runs destructors of the coroutine's locals, which may stop other behaviours
+	handle.destroy();
+}
+
+
+void* BehaviourScheduler::AllocateFrame(size_t size)
+{
+	size_t sizeClass = (size + FRAME_GRANULARITY - 1) / FRAME_GRANULARITY - 1;
+	if (sizeClass >= FRAME_CLASSES) {
+		return ::operator new(size);
+	}
+
+	std::lock_guard<std::mutex> lock(mFrameMutex);
+	if (!mFreeFrames[sizeClass]) {
+		// Carve a new block into frames and thread them onto the free list
+		size_t frameSize = (sizeClass + 1) * FRAME_GRANULARITY;
+		char* block = (char*)::operator new(frameSize * FRAMES_PER_BLOCK);
+		for (size_t i = 0; i < FRAMES_PER_BLOCK; i++) {
+			void* frame = block + i * frameSize;
+			*(void**)frame = mFreeFrames[sizeClass];
+			mFreeFrames[sizeClass] = frame;
+		}
+	}
+
+	void* frame = mFreeFrames[sizeClass];
+	mFreeFrames[sizeClass] = *(void**)frame;
+	return frame;
+}
+
+
+void BehaviourScheduler::FreeFrame(void* frame, size_t size)
+{
+	size_t sizeClass = (size + FRAME_GRANULARITY - 1) / FRAME_GRANULARITY - 1;
+	if (sizeClass >= FRAME_CLASSES) {
+		::operator delete(frame);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mFrameMutex);
+	*(void**)frame = mFreeFrames[sizeClass];
+	mFreeFrames[sizeClass] = frame;
+}
+
+} // namespace game
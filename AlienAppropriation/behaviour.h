@@ -0,0 +1,147 @@
+#ifndef BEHAVIOUR_H_
+#define BEHAVIOUR_H_
+
+#include <coroutine>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace game {
+
+	class Behaviour;
+
+	// Identifies a running behaviour so its owner can stop it
+	// Stays safe to use after the behaviour has finished: the generation no longer matches
+	struct BehaviourHandle {
+		uint32_t slot;
+		uint32_t generation;
+	};
+
+	// class BehaviourScheduler
+	// Runs entity behaviours written as coroutines
+	// A behaviour suspends with co_await sleep(seconds) or co_await until(condition) and is only resumed
+	// once it is due, so an entity that is waiting costs nothing but its place in the timer heap
+	// (conditions are polled once per tick). Time is simulation time, advanced by update.
+	// Everything except frame allocation must be called from the simulation thread
+	class BehaviourScheduler {
+
+	public:
+		// Take ownership of a new behaviour; it first runs on the next update
+		static BehaviourHandle Start(Behaviour behaviour);
+
+		// Destroy a behaviour wherever it is suspended. Does nothing if it already finished
+		static void Stop(BehaviourHandle handle);
+
+		// Advance the clock and resume every behaviour that is due
+		static void update(double deltaTime);
+
+		inline static double Now(void) { return mTime; }
+
+		// Coroutine frames come from here instead of the heap
+		static void* AllocateFrame(size_t size);
+		static void FreeFrame(void* frame, size_t size);
+
+		// Used by the awaitables
+		static void Sleep(uint32_t slot, double seconds);
+		static void WaitUntil(uint32_t slot);
+
+	private:
+		struct Task;
+		struct Timer {
+			double time;
+			uint64_t sequence; // Behaviours due at the same time resume in the order they went to sleep
+			uint32_t slot;
+			uint32_t generation;
+		};
+
+		static double mTime;
+		static uint64_t mNextSequence;
+		static std::vector<Task> mTasks;
+		static std::vector<uint32_t> mFreeSlots;
+		static std::vector<Timer> mTimers; // Min-heap on (time, sequence)
+		static std::vector<uint32_t> mWaiting; // Slots waiting on a condition
+		static std::vector<Timer> mDue;
+
+		// Frame pool: one free list per 64 byte size class, refilled a block at a time
+		static const size_t FRAME_GRANULARITY = 64;
+		static const size_t FRAME_CLASSES = 16;
+		static const size_t FRAMES_PER_BLOCK = 32;
+		static void* mFreeFrames[FRAME_CLASSES];
+		static std::mutex mFrameMutex;
+
+		static bool LaterTimer(const Timer& a, const Timer& b); // Heap order, the earliest timer is at the front
+		static void Resume(uint32_t slot);
+		static void Release(uint32_t slot);
+
+	}; // class BehaviourScheduler
+
+
+	// class Behaviour
+	// Return type of a behaviour coroutine, e.g.
+	//     Behaviour CowEntityNode::graze(void) { for (;;) { ... co_await sleep(2.0); } }
+	// Hand it to BehaviourScheduler::Start (or EntityNode::startBehaviour) to run it
+	class Behaviour {
+
+	public:
+		struct promise_type {
+			uint32_t slot;
+			std::function<bool()> condition;
+
+			Behaviour get_return_object() { return Behaviour(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { throw; }
+
+			static void* operator new(size_t size) { return BehaviourScheduler::AllocateFrame(size); }
+			static void operator delete(void* frame, size_t size) { BehaviourScheduler::FreeFrame(frame, size); }
+		};
+
+		Behaviour(Behaviour&& other) noexcept : mHandle(other.mHandle) { other.mHandle = nullptr; }
+		~Behaviour() { if (mHandle) mHandle.destroy(); }
+
+		// Give up ownership, used by the scheduler
+		inline std::coroutine_handle<promise_type> release(void) { std::coroutine_handle<promise_type> h = mHandle; mHandle = nullptr; return h; }
+
+	private:
+		explicit Behaviour(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+		Behaviour(const Behaviour&) = delete;
+		Behaviour& operator=(const Behaviour&) = delete;
+
+		std::coroutine_handle<promise_type> mHandle;
+
+	}; // class Behaviour
+
+
+	// co_await sleep(seconds): resume once that much simulation time has passed
+	// sleep(0) resumes on the next tick
+	struct SleepAwaitable {
+		double seconds;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<Behaviour::promise_type> h) { BehaviourScheduler::Sleep(h.promise().slot, seconds); }
+		void await_resume() const noexcept {}
+	};
+
+	// co_await until(condition): resume on the first tick the condition holds
+	// Does not suspend at all if it already holds
+	struct UntilAwaitable {
+		std::function<bool()> condition;
+
+		bool await_ready() const { return condition(); }
+		void await_suspend(std::coroutine_handle<Behaviour::promise_type> h)
+		{
+			h.promise().condition = std::move(condition);
+			BehaviourScheduler::WaitUntil(h.promise().slot);
+		}
+		void await_resume() const noexcept {}
+	};
+
+	inline SleepAwaitable sleep(double seconds) { return SleepAwaitable{ seconds }; }
+	inline UntilAwaitable until(std::function<bool()> condition) { return UntilAwaitable{ std::move(condition) }; }
+
+} // namespace game
+
+#endif // BEHAVIOUR_H_
@@ -0,0 +1,145 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "block_compressor.h"
+
+namespace game {
+
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+// The format ends every block on literals: the last match starts at least MATCH_LIMIT bytes before the end
+// and stops at least LAST_LITERALS bytes before it
+static const size_t LAST_LITERALS = 5;
+static const size_t MATCH_LIMIT = 12;
+static const int HASH_BITS = 14;
+
+
+static inline uint32_t Read32(const char* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+
+static inline uint32_t Hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+// Lengths of 15 and up spill into extra bytes of 255 each, ended by a byte under 255
+static inline void PutLength(std::vector<char>& out, size_t length)
+{
+	while (length >= 255) {
+		out.push_back((char)255);
+		length -= 255;
+	}
+	out.push_back((char)length);
+}
+
+
+static void PutSequence(std::vector<char>& out, const char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+	unsigned char token = (unsigned char)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+	out.push_back((char)token);
+	if (literalCount >= 15) PutLength(out, literalCount - 15);
+	out.insert(out.end(), literals, literals + literalCount);
+
+	// The last sequence has literals only
+	if (!matchLength) return;
+	out.push_back((char)(offset & 0xff));
+	out.push_back((char)(offset >> 8));
+	if (matchCode >= 15) PutLength(out, matchCode - 15);
+}
+
+
+void BlockCompressor::Compress(const char* data, size_t size, std::vector<char>& out)
+{
+	// Position + 1 of the last place each hash was seen, 0 for never
+	std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+	size_t anchor = 0;
+
+	if (size > MATCH_LIMIT) {
+		size_t matchEnd = size - LAST_LITERALS;
+		size_t i = 0;
+		while (i + MATCH_LIMIT <= size) {
+			uint32_t sequence = Read32(data + i);
+			uint32_t& slot = table[Hash(sequence)];
+			size_t candidate = slot;
+			slot = (uint32_t)(i + 1);
+
+			if (!candidate || i - (candidate - 1) > MAX_OFFSET || Read32(data + candidate - 1) != sequence) {
+				i++;
+				continue;
+			}
+
+			size_t match = candidate - 1;
+			size_t length = MIN_MATCH;
+			while (i + length < matchEnd && data[match + length] == data[i + length]) {
+				length++;
+			}
+
+			PutSequence(out, data + anchor, i - anchor, i - match, length);
+			i += length;
+			anchor = i;
+		}
+	}
+
+	PutSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+
+bool BlockCompressor::Decompress(const char* block, size_t blockSize, char* out, size_t size)
+{
+	const unsigned char* in = (const unsigned char*)block;
+	size_t at = 0, written = 0;
+
+	// Reads a spilled length; false if it runs off the block
+	auto getLength = [&](size_t& length) {
+		unsigned char next;
+		do {
+			if (at >= blockSize) return false;
+			next = in[at++];
+			length += next;
+		} while (next == 255);
+		return true;
+	};
+
+	while (at < blockSize) {
+		unsigned char token = in[at++];
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !getLength(literalCount)) return false;
+		if (literalCount > blockSize - at || literalCount > size - written) return false;
+		if (literalCount) memcpy(out + written, in + at, literalCount);
+		at += literalCount;
+		written += literalCount;
+
+		// Only the last sequence ends the block after its literals
+		if (at == blockSize) break;
+
+		if (blockSize - at < 2) return false;
+		size_t offset = in[at] | ((size_t)in[at + 1] << 8);
+		at += 2;
+		size_t length = token & 15;
+		if (length == 15 && !getLength(length)) return false;
+		length += MIN_MATCH;
+		if (offset == 0 || offset > written || length > size - written) return false;
+
+		// The copy may overlap what it is writing, which repeats the last offset bytes
+		const char* from = out + written - offset;
+		if (offset >= length) {
+			memcpy(out + written, from, length);
+		}
+		else {
+			for (size_t k = 0; k < length; k++) out[written + k] = from[k];
+		}
+		written += length;
+	}
+
+	return written == size;
+}
+
+} // namespace game
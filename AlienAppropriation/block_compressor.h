@@ -0,0 +1,28 @@
+#ifndef BLOCK_COMPRESSOR_H_
+#define BLOCK_COMPRESSOR_H_
+
+#include <vector>
+#include <stddef.h>
+
+namespace game {
+
+	// class BlockCompressor
+	// Fast LZ77 compression of one block in memory, in the LZ4 block format: runs of literals, each followed by a
+	// copy of 4 or more bytes from up to 64 KB back. Matches are found through a hash of the next 4 bytes, so
+	// compressing is one pass and decompressing is little more than memcpy. Made for snapshots, which repeat
+	// the same names, tags and nearly equal floats over and over
+	class BlockCompressor {
+
+	public:
+		// Append the compressed block to out
+		static void Compress(const char* data, size_t size, std::vector<char>& out);
+
+		// Decompress a whole block into out, which must be exactly the size it was compressed from
+		// Returns false if the block is damaged; it never reads or writes outside the buffers
+		static bool Decompress(const char* block, size_t blockSize, char* out, size_t size);
+
+	}; // class BlockCompressor
+
+} // namespace game
+
+#endif // BLOCK_COMPRESSOR_H_
@@ -0,0 +1,157 @@
+#include <float.h>
+#include <algorithm>
+
+#include "broad_phase.h"
+#include "scene_node.h"
+
+namespace game {
+
+BroadPhase::BroadPhase(void)
+{
+}
+
+
+BroadPhase::~BroadPhase()
+{
+}
+
+
+uint32_t BroadPhase::add(SceneNode* node, CollisionLayer layer, bool fitToNode)
+{
+	uint32_t proxy;
+	if (!mFreeProxies.empty()) {
+		proxy = mFreeProxies.back();
+		mFreeProxies.pop_back();
+	}
+	else {
+		proxy = (uint32_t)mProxies.size();
+		mProxies.push_back(Proxy());
+	}
+
+	Proxy& p = mProxies[proxy];
+	p.node = node;
+	p.layer = layer;
+	p.fitToNode = fitToNode;
+	clearBounds(proxy);
+
+	// New proxies are sorted on their own and merged into the order on the next update
+	mAdded.push_back(proxy);
+	return proxy;
+}
+
+
+void BroadPhase::reserve(size_t count)
+{
+	// Keep growing geometrically, or many small batches would each copy everything
+	if (mProxies.size() + count > mProxies.capacity()) {
+		mProxies.reserve(std::max(mProxies.size() + count, mProxies.capacity() * 2));
+	}
+	if (mOrder.size() + mAdded.size() + count > mOrder.capacity()) {
+		mOrder.reserve(std::max(mOrder.size() + mAdded.size() + count, mOrder.capacity() * 2));
+	}
+	mAdded.reserve(mAdded.size() + count);
+}
+
+
+void BroadPhase::remove(uint32_t proxy)
+{
+	mProxies[proxy].node = nullptr;
+	mRemoved.push_back(proxy);
+}
+
+
+void BroadPhase::setLayer(uint32_t proxy, CollisionLayer layer)
+{
+	mProxies[proxy].layer = layer;
+}
+
+
+void BroadPhase::setBounds(uint32_t proxy, const glm::vec3& min, const glm::vec3& max)
+{
+	mProxies[proxy].min = min;
+	mProxies[proxy].max = max;
+}
+
+
+void BroadPhase::clearBounds(uint32_t proxy)
+{
+	// An inverted box fails every overlap test
+	mProxies[proxy].min = glm::vec3(FLT_MAX);
+	mProxies[proxy].max = glm::vec3(-FLT_MAX);
+}
+
+
+void BroadPhase::update(void)
+{
+	// Drop removed proxies from the order; only then can their slots be handed out again
+	if (!mRemoved.empty()) {
+		size_t kept = 0;
+		for (size_t i = 0; i < mOrder.size(); i++) {
+			if (mProxies[mOrder[i]].node) mOrder[kept++] = mOrder[i];
+		}
+		mOrder.resize(kept);
+		kept = 0;
+		for (size_t i = 0; i < mAdded.size(); i++) {
+			if (mProxies[mAdded[i]].node) mAdded[kept++] = mAdded[i];
+		}
+		mAdded.resize(kept);
+		mFreeProxies.insert(mFreeProxies.end(), mRemoved.begin(), mRemoved.end());
+		mRemoved.clear();
+	}
+
+	for (Proxy& p : mProxies) {
+		if (p.node && p.fitToNode) {
+			p.node->getCollisionBounds(p.min, p.max);
+		}
+	}
+
+	// Insertion sort: close to linear when the previous order is nearly right
+	for (size_t i = 1; i < mOrder.size(); i++) {
+		uint32_t proxy = mOrder[i];
+		float key = mProxies[proxy].min.x;
+		size_t j = i;
+		while (j > 0 && mProxies[mOrder[j - 1]].min.x > key) {
+			mOrder[j] = mOrder[j - 1];
+			j--;
+		}
+		mOrder[j] = proxy;
+	}
+
+	// A whole batch may have been added, which insertion would sort one by one across everything
+	if (!mAdded.empty()) {
+		auto lowerX = [&](uint32_t a, uint32_t b) { return mProxies[a].min.x < mProxies[b].min.x; };
+		std::sort(mAdded.begin(), mAdded.end(), lowerX);
+		size_t sorted = mOrder.size();
+		mOrder.insert(mOrder.end(), mAdded.begin(), mAdded.end());
+		std::inplace_merge(mOrder.begin(), mOrder.begin() + sorted, mOrder.end(), lowerX);
+		mAdded.clear();
+	}
+
+	// Sweep: everything that starts before this box ends overlaps it on x
+	mPairs.clear();
+	for (size_t i = 0; i < mOrder.size(); i++) {
+		const Proxy& a = mProxies[mOrder[i]];
+		if (a.min.x > a.max.x) break; // Cleared boxes sort to the end
+		uint32_t interacts = mMatrix.getRow(a.layer);
+
+		for (size_t j = i + 1; j < mOrder.size(); j++) {
+			const Proxy& b = mProxies[mOrder[j]];
+			if (b.min.x > a.max.x) break;
+
+			if (!(interacts & (1u << b.layer))) continue;
+			if (a.min.y > b.max.y || b.min.y > a.max.y) continue;
+			if (a.min.z > b.max.z || b.min.z > a.max.z) continue;
+
+			CollisionPair pair;
+			pair.proxyA = mOrder[i];
+			pair.proxyB = mOrder[j];
+			pair.a = a.node;
+			pair.b = b.node;
+			pair.layerA = a.layer;
+			pair.layerB = b.layer;
+			mPairs.push_back(pair);
+		}
+	}
+}
+
+} // namespace game
@@ -0,0 +1,122 @@
+#ifndef BROAD_PHASE_H_
+#define BROAD_PHASE_H_
+
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+namespace game {
+
+	class SceneNode;
+
+	// What a collider is
+	// Layers that react to others come first, so in a pair the lower layer is the one that acts
+	enum CollisionLayer : uint32_t {
+		LayerNone = 0,    // Does not collide with anything
+		LayerPlayer,
+		LayerTractorBeam, // The cone under the player while the beam is on
+		LayerBomb,
+		LayerScenery,     // Trees, barns and anything else that just blocks the player
+		LayerCow,
+		LayerBull,
+		LayerHay,
+		LayerFarmer,
+		LayerProjectile,
+		LayerBombable,
+		LayerCount
+	};
+
+	// Sets of layers, for queries
+	inline uint32_t LayerBit(CollisionLayer layer) { return 1u << layer; }
+	const uint32_t ALL_LAYERS = ~1u; // Everything but LayerNone
+
+	// class CollisionMatrix
+	// Which layers interact, one bit per layer pair
+	// Row i holds a bit for every layer that interacts with layer i, so filtering a pair is a single AND
+	class CollisionMatrix {
+
+	public:
+		CollisionMatrix(void) { clear(); }
+
+		inline void clear(void) { for (uint32_t i = 0; i < 32; i++) mRows[i] = 0; }
+
+		// Interactions are symmetric
+		inline void set(CollisionLayer a, CollisionLayer b, bool interact = true)
+		{
+			if (interact) { mRows[a] |= 1u << b; mRows[b] |= 1u << a; }
+			else { mRows[a] &= ~(1u << b); mRows[b] &= ~(1u << a); }
+		}
+
+		inline bool interacts(uint32_t a, uint32_t b) const { return (mRows[a] & (1u << b)) != 0; }
+		inline uint32_t getRow(uint32_t layer) const { return mRows[layer]; }
+
+	private:
+		uint32_t mRows[32];
+
+	}; // class CollisionMatrix
+
+	// Two colliders whose bounds overlap and whose layers interact
+	struct CollisionPair {
+		uint32_t proxyA;
+		uint32_t proxyB;
+		SceneNode* a;
+		SceneNode* b;
+		CollisionLayer layerA;
+		CollisionLayer layerB;
+	};
+
+	// class BroadPhase
+	// Finds pairs of colliders that may touch, anywhere on the map
+	// Every collider has a proxy with an axis aligned box and a layer; the collision matrix says which layers meet.
+	// Proxies are kept sorted on the low x of their box, and each update sweeps along x reporting boxes that
+	// overlap. Things move little between ticks, so the order is nearly right already and the insertion sort
+	// that restores it costs about one pass
+	class BroadPhase {
+
+	public:
+		static const uint32_t NO_PROXY = 0xffffffff;
+
+		BroadPhase(void);
+		~BroadPhase();
+
+		// fitToNode proxies take their box from the node's collision shape on every update;
+		// the others keep the box last given to setBounds
+		uint32_t add(SceneNode* node, CollisionLayer layer, bool fitToNode = true);
+		void remove(uint32_t proxy);
+		// Make room for count more proxies before adding them
+		void reserve(size_t count);
+
+		void setLayer(uint32_t proxy, CollisionLayer layer);
+		void setBounds(uint32_t proxy, const glm::vec3& min, const glm::vec3& max);
+		void clearBounds(uint32_t proxy); // Overlaps nothing until the next setBounds
+		inline CollisionLayer getLayer(uint32_t proxy) const { return mProxies[proxy].layer; }
+
+		inline CollisionMatrix& getMatrix(void) { return mMatrix; }
+
+		// Refresh boxes, restore the order and collect the pairs
+		void update(void);
+		inline const std::vector<CollisionPair>& getPairs(void) const { return mPairs; }
+
+	private:
+		struct Proxy {
+			SceneNode* node; // Null once removed
+			glm::vec3 min;
+			glm::vec3 max;
+			CollisionLayer layer;
+			bool fitToNode;
+		};
+
+		CollisionMatrix mMatrix;
+		std::vector<Proxy> mProxies;
+		std::vector<uint32_t> mOrder; // Proxy indices sorted on min.x
+		std::vector<uint32_t> mAdded; // Added since the last update, merged into mOrder by the next
+		std::vector<uint32_t> mFreeProxies;
+		std::vector<uint32_t> mRemoved; // Freed on the next update, once they are out of mOrder
+		std::vector<CollisionPair> mPairs;
+
+	}; // class BroadPhase
+
+} // namespace game
+
+#endif // BROAD_PHASE_H_
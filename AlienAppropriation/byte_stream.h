@@ -0,0 +1,93 @@
+#ifndef BYTE_STREAM_H_
+#define BYTE_STREAM_H_
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scene_graph.h"
+
+namespace game {
+
+	// The game's binary files (maps, snapshots) are values written out as their bytes. They are only read back
+	// by the same build of the game, so byte order and padding are the same on both ends
+
+	// class ByteWriter
+	// Appends values to a buffer
+	class ByteWriter {
+
+	public:
+		ByteWriter(std::vector<char>& out) : mOut(out) {}
+
+		template<class T> void put(const T& value)
+		{
+			const char* bytes = (const char*)&value;
+			mOut.insert(mOut.end(), bytes, bytes + sizeof(T));
+		}
+
+		void putBytes(const void* data, size_t size)
+		{
+			const char* bytes = (const char*)data;
+			mOut.insert(mOut.end(), bytes, bytes + size);
+		}
+
+		// Its length, then its characters
+		void putString(const std::string& value)
+		{
+			put((uint32_t)value.size());
+			putBytes(value.data(), value.size());
+		}
+
+	private:
+		std::vector<char>& mOut;
+
+	}; // class ByteWriter
+
+
+	// class ByteReader
+	// Reads values back in the order they were written. Throws if the data runs out
+	class ByteReader {
+
+	public:
+		// what names the data in the error, e.g. "Map file \"start.map\""
+		ByteReader(const char* data, size_t size, const std::string& what) : mData(data), mSize(size), mAt(0), mWhat(what) {}
+
+		template<class T> void get(T& value)
+		{
+			memcpy(&value, getBytes(sizeof(T)), sizeof(T));
+		}
+
+		// The next size bytes, where they are
+		const char* getBytes(size_t size)
+		{
+			if (mSize - mAt < size) {
+				throw(GameException(mWhat + std::string(" is cut short")));
+			}
+			const char* bytes = mData + mAt;
+			mAt += size;
+			return bytes;
+		}
+
+		std::string getString(void)
+		{
+			uint32_t length;
+			get(length);
+			const char* chars = getBytes(length);
+			return std::string(chars, length);
+		}
+
+		inline bool atEnd(void) const { return mAt == mSize; }
+
+	private:
+		const char* mData;
+		size_t mSize;
+		size_t mAt;
+		std::string mWhat;
+
+	}; // class ByteReader
+
+} // namespace game
+
+#endif // BYTE_STREAM_H_
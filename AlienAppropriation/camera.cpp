@@ -42,19 +42,18 @@ glm::vec3 Camera::GetUp(void) const {
 }
 
 
-void Camera::draw(SceneNode *camera, glm::mat4 parentTransf)
+void Camera::extract(RenderSnapshot& snapshot, const NodeTransform& parent)
 {
-	// The camera cannot be drawn - instead the function passes the camera's transform to its children
-	glm::mat4 rotation = glm::mat4_cast(mOrientation);
-	glm::mat4 translation = glm::translate(parentTransf, mPosition);
+	// The camera cannot be drawn - instead the function passes the camera's position to its children
+	NodeTransform transf;
+	transf.position = parent.position + parent.orientation * mPosition;
+	transf.orientation = parent.orientation;
+
+	if (mCameraPerspective != Third) return;
 
-	parentTransf = translation;
-	
 	for (BaseNode* bn : getChildNodes())
 	{
-		if (mCameraPerspective == Third) {
-			dynamic_cast<SceneNode*>(bn)->draw(camera, parentTransf);
-		}
+		dynamic_cast<SceneNode*>(bn)->extract(snapshot, transf);
 	}
 }
 
@@ -69,9 +68,8 @@ void Camera::update(double deltaTime)
 	mPosition += -mVelocity.z * playerForward;
 	mVelocity.z *= 0.95;
 
-	mPosition.x = glm::clamp(mPosition.x, 0.0f, 300.0f);
+	// The world has no edge, only a ceiling and a floor
 	mPosition.y = glm::clamp(mPosition.y, 5.0f, 50.0f);
-	mPosition.z = glm::clamp(mPosition.z, 40.0f, 340.0f);
 
 	for (BaseNode* bn : getChildNodes())
 	{
@@ -147,72 +145,60 @@ void Camera::SetView(glm::vec3 position, glm::vec3 look_at, glm::vec3 up){
 }
 
 
-void Camera::SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h){
+void Camera::extractView(RenderView& view){
 
-    // Set projection based on field-of-view
-    float top = tan((fov/2.0)*(glm::pi<float>()/180.0))*near;
-    float right = top * w/h;
-    mProjectionMatrix = glm::frustum(-right, right, -top, top, near, far);
+	view.position = mPosition;
+	view.orientation = mOrientation;
+	view.forward = mForward;
+	view.side = mSide;
+	view.playerOffset = SceneGraph::getPlayerNode()->getPosition() - mPosition;
+	view.thirdPerson = (mCameraPerspective == Third);
 }
 
 
-void Camera::SetupShader(GLuint program, glm::mat4& parentTransf){
-
-    // update view matrix
-    SetupViewMatrix();
-
-    // Set view matrix in shader
-    GLint view_mat = glGetUniformLocation(program, "view_mat");
-    glUniformMatrix4fv(view_mat, 1, GL_FALSE, glm::value_ptr(mViewMatrix));
-    
-    // Set projection matrix in shader
-    GLint projection_mat = glGetUniformLocation(program, "projection_mat");
-    glUniformMatrix4fv(projection_mat, 1, GL_FALSE, glm::value_ptr(mProjectionMatrix));
-}
-
-
-void Camera::SetupViewMatrix(void){
+glm::mat4 Camera::ComputeViewMatrix(const RenderView& view){
 
     // view_matrix_ = glm::lookAt(position, look_at, up);
 
     // Get current vectors of coordinate system
     // [side, up, forward]
     // See slide in "Camera control" for details
-    glm::vec3 current_forward = mOrientation * mForward;
-    glm::vec3 current_side = mOrientation * mSide;
+    glm::vec3 current_forward = view.orientation * view.forward;
+    glm::vec3 current_side = view.orientation * view.side;
     glm::vec3 current_up = glm::cross(current_forward, current_side);
     current_up = glm::normalize(current_up);
 
     // Initialize the view matrix as an identity matrix
-    mViewMatrix = glm::mat4(1.0); 
+    glm::mat4 view_matrix = glm::mat4(1.0); 
 
 	// Adding player to the view Matrix
-	if (mCameraPerspective == Third)
-	mViewMatrix = glm::translate(mViewMatrix, SceneGraph::getPlayerNode()->getPosition() - mPosition);
+	if (view.thirdPerson)
+	view_matrix = glm::translate(view_matrix, view.playerOffset);
 
     // Copy vectors to matrix
     // Add vectors to rows, not columns of the matrix, so that we get
     // the inverse transformation
     // Note that in glm, the reference for matrix entries is of the form
     // matrix[column][row]
-    mViewMatrix[0][0] = current_side[0]; // First row
-    mViewMatrix[1][0] = current_side[1];
-    mViewMatrix[2][0] = current_side[2];
-    mViewMatrix[0][1] = current_up[0]; // Second row
-    mViewMatrix[1][1] = current_up[1];
-    mViewMatrix[2][1] = current_up[2];
-    mViewMatrix[0][2] = current_forward[0]; // Third row
-    mViewMatrix[1][2] = current_forward[1];
-    mViewMatrix[2][2] = current_forward[2];
-
-	if (mCameraPerspective == Third)
-		mViewMatrix = glm::translate(mViewMatrix, -(SceneGraph::getPlayerNode()->getPosition() - mPosition));
+    view_matrix[0][0] = current_side[0]; // First row
+    view_matrix[1][0] = current_side[1];
+    view_matrix[2][0] = current_side[2];
+    view_matrix[0][1] = current_up[0]; // Second row
+    view_matrix[1][1] = current_up[1];
+    view_matrix[2][1] = current_up[2];
+    view_matrix[0][2] = current_forward[0]; // Third row
+    view_matrix[1][2] = current_forward[1];
+    view_matrix[2][2] = current_forward[2];
+
+	if (view.thirdPerson)
+		view_matrix = glm::translate(view_matrix, -view.playerOffset);
 
     // Create translation to camera position
-    glm::mat4 trans = glm::translate(glm::mat4(1.0), -mPosition);
+    glm::mat4 trans = glm::translate(glm::mat4(1.0), -view.position);
 
     // Combine translation and view matrix in proper order
-    mViewMatrix *= trans;
+    view_matrix *= trans;
+    return view_matrix;
 }
 
 } // namespace game
@@ -11,6 +11,7 @@
 #include <string>
 
 #include "scene_node.h"
+#include "render_snapshot.h"
 
 
 namespace game {
@@ -27,8 +28,6 @@ namespace game {
 
 			glm::vec3 mForward; // Initial forward vector
 			glm::vec3 mSide; // Initial side vector
-			glm::mat4 mViewMatrix; // View matrix
-			glm::mat4 mProjectionMatrix; // Projection matrix
 
 
 			glm::vec3 mVelocity;
@@ -36,17 +35,14 @@ namespace game {
 
 			glm::vec3 playerForward;
 
-			// Create view matrix from current camera parameters
-			void SetupViewMatrix(void);
-
 			Perspective mCameraPerspective;
 
         public:
             Camera(std::string name);
             ~Camera();
  
-			// Dummy draw function, just to update parentTransF for any children
-			virtual void draw(SceneNode *camera, glm::mat4 parentTransf = glm::mat4(1.0));
+			// The camera itself is not drawn, it only passes its transform on to its children
+			virtual void extract(RenderSnapshot& snapshot, const NodeTransform& parent);
 			virtual void update(double deltaTime);
 
 			// Camera Perspective
@@ -62,6 +58,9 @@ namespace game {
 
 			inline void setVelocity(glm::vec3 velocity) { mVelocity = velocity; }
 			inline void addVelocity(glm::vec3 velocity) { mVelocity += velocity;  }
+			// Direction the player flies in, turned by Yaw
+			inline glm::vec3 getPlayerForward() const { return playerForward; }
+			inline void setPlayerForward(glm::vec3 forward) { playerForward = forward; }
 
 			inline glm::vec3 getVelocityRaw() {
 				glm::vec3 current = mVelocity.x * glm::cross(playerForward, glm::vec3(0.0f, -1.0f, 0.0f));
@@ -78,11 +77,10 @@ namespace game {
             // point looking at, and up vector
             // Resets the current orientation and position of the camera
             void SetView(glm::vec3 position, glm::vec3 look_at, glm::vec3 up);
-            // Set projection from frustum parameters: field-of-view,
-            // near and far planes, and width and height of viewport
-            void SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h);
-            // Set all camera-related variables in shader program
-            virtual void SetupShader(GLuint program, glm::mat4& parentTransf = glm::mat4(1.0));
+            // Copy the current view parameters into a render snapshot
+            void extractView(RenderView& view);
+            // Create view matrix from camera parameters captured in a snapshot
+            static glm::mat4 ComputeViewMatrix(const RenderView& view);
 
 			inline float GetHeight() { return mPosition.y; };
 
@@ -0,0 +1,59 @@
+#include <algorithm>
+
+#include "command_buffer.h"
+#include "base_node.h"
+
+namespace game {
+
+CommandBuffer::CommandBuffer(void)
+	: mNextSequence(0)
+{
+}
+
+
+CommandBuffer::~CommandBuffer()
+{
+}
+
+
+void CommandBuffer::push(SceneCommandType type, BaseNode* node, BaseNode* parent, const std::string& tag)
+{
+	uint32_t sequence = mNextSequence++;
+	auto fill = [&](SceneCommand& command) {
+		command.type = type;
+		command.node = node;
+		command.parent = parent;
+		command.tag = tag;
+		command.sequence = sequence;
+	};
+
+	if (!mQueue.tryPushWith(fill)) {
+		SceneCommand command;
+		fill(command);
+		std::lock_guard<std::mutex> lock(mOverflowMutex);
+		mOverflow.push_back(command);
+	}
+}
+
+
+void CommandBuffer::take(std::vector<SceneCommand>& out)
+{
+	out.clear();
+	while (mQueue.tryPopWith([&out](SceneCommand& command) { out.push_back(std::move(command)); })) {
+	}
+	{
+		std::lock_guard<std::mutex> lock(mOverflowMutex);
+		out.insert(out.end(), mOverflow.begin(), mOverflow.end());
+		mOverflow.clear();
+	}
+
+	std::sort(out.begin(), out.end(), [](const SceneCommand& a, const SceneCommand& b) {
+		if (a.type != b.type) return a.type < b.type;
+		if (a.node->getId() != b.node->getId()) return a.node->getId() < b.node->getId();
+		int tagOrder = a.tag.compare(b.tag);
+		if (tagOrder != 0) return tagOrder < 0;
+		return a.sequence < b.sequence;
+	});
+}
+
+} // namespace game
@@ -0,0 +1,64 @@
+#ifndef COMMAND_BUFFER_H_
+#define COMMAND_BUFFER_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+#include "ring_buffer.h"
+
+namespace game {
+
+	class BaseNode;
+
+	// Kinds of scene change, in the order they are applied within one commit
+	// Spawns go first so a node created and changed in the same tick exists before it is changed,
+	// deletes go last so nothing is applied to a node after it has left the scene
+	enum SceneCommandType {
+		CmdSpawn,     // Link node under parent (the root if parent is null) and put it in the grid
+		CmdReparent,  // Move node under parent
+		CmdAddTag,
+		CmdRemoveTag,
+		CmdDelete     // Remove node and its children from the scene
+	};
+
+	struct SceneCommand {
+		SceneCommandType type;
+		BaseNode* node;
+		BaseNode* parent;
+		std::string tag;
+		uint32_t sequence; // Push order, only used to order otherwise identical commands
+	};
+
+	// class CommandBuffer
+	// Changes to the scene structure requested while a tick is running
+	// Any thread may push; the simulation thread takes them all at the end of the tick.
+	// Commands are handed out sorted by type, then node id, so the scene after a commit does not
+	// depend on which thread happened to push first
+	class CommandBuffer {
+
+	public:
+		CommandBuffer(void);
+		~CommandBuffer();
+
+		void push(SceneCommandType type, BaseNode* node, BaseNode* parent = nullptr, const std::string& tag = std::string());
+
+		// Move every queued command into out (which is cleared first), in the order they must be applied
+		// Only one thread may take at a time, and not while other threads are still pushing
+		void take(std::vector<SceneCommand>& out);
+
+	private:
+		RingBuffer<SceneCommand, 4096> mQueue;
+		std::atomic<uint32_t> mNextSequence;
+
+		// Commands that did not fit in the ring; a burst of spawns must never be dropped
+		std::mutex mOverflowMutex;
+		std::vector<SceneCommand> mOverflow;
+
+	}; // class CommandBuffer
+
+} // namespace game
+
+#endif // COMMAND_BUFFER_H_
@@ -0,0 +1,108 @@
+#include <algorithm>
+
+#include "contact_cache.h"
+#include "scene_node.h"
+
+namespace game {
+
+ContactCache::ContactCache(void)
+{
+}
+
+
+void ContactCache::setHandler(CollisionLayer actor, CollisionLayer other, ContactHandler handler)
+{
+	mHandlers[actor][other] = handler;
+}
+
+
+bool ContactCache::stillApart(uint64_t key, SceneNode* a, SceneNode* b)
+{
+	auto found = std::lower_bound(mSeparations.begin(), mSeparations.end(), key,
+		[](const Separation& s, uint64_t k) { return s.key < k; });
+	if (found == mSeparations.end() || found->key != key || found->distance <= 0.0f) return false;
+
+	if (found->orientationA != a->getOrientation() || found->orientationB != b->getOrientation()) return false;
+
+	float moved = glm::length(a->getPosition() - found->positionA) + glm::length(b->getPosition() - found->positionB);
+	if (moved >= found->distance) return false;
+
+	mMeasured.push_back(*found);
+	return true;
+}
+
+
+void ContactCache::recordSeparation(uint64_t key, SceneNode* a, SceneNode* b, float separation)
+{
+	Separation s;
+	s.key = key;
+	s.distance = separation;
+	s.positionA = a->getPosition();
+	s.positionB = b->getPosition();
+	s.orientationA = a->getOrientation();
+	s.orientationB = b->getOrientation();
+	mMeasured.push_back(s);
+}
+
+
+void ContactCache::touch(uint64_t key, SceneNode* actor, SceneNode* other, CollisionLayer actorLayer, CollisionLayer otherLayer)
+{
+	Contact contact;
+	contact.key = key;
+	contact.actor = actor;
+	contact.other = other;
+	contact.actorLayer = actorLayer;
+	contact.otherLayer = otherLayer;
+	mTouching.push_back(contact);
+}
+
+
+void ContactCache::update(void)
+{
+	std::sort(mTouching.begin(), mTouching.end(), [](const Contact& a, const Contact& b) { return a.key < b.key; });
+	std::sort(mMeasured.begin(), mMeasured.end(), [](const Separation& a, const Separation& b) { return a.key < b.key; });
+
+	// Walk both sorted lists together
+	mEvents.clear();
+	size_t last = 0, now = 0;
+	while (last < mContacts.size() || now < mTouching.size()) {
+		Event event;
+		if (now == mTouching.size() || (last < mContacts.size() && mContacts[last].key < mTouching[now].key)) {
+			event.type = ContactExit;
+			event.contact = mContacts[last++];
+		}
+		else if (last == mContacts.size() || mTouching[now].key < mContacts[last].key) {
+			event.type = ContactEnter;
+			event.contact = mTouching[now++];
+		}
+		else {
+			event.type = ContactStay;
+			event.contact = mTouching[now++];
+			last++;
+		}
+		mEvents.push_back(event);
+	}
+
+	mContacts.swap(mTouching);
+	mTouching.clear();
+	mSeparations.swap(mMeasured);
+	mMeasured.clear();
+
+	// Handlers run after the bookkeeping, so whatever they do cannot disturb it
+	for (const Event& event : mEvents) {
+		const ContactHandler& handler = mHandlers[event.contact.actorLayer][event.contact.otherLayer];
+		if (handler) {
+			handler(event.type, event.contact.actor, event.contact.other);
+		}
+	}
+}
+
+
+void ContactCache::forgetProxy(uint32_t proxy)
+{
+	auto involves = [proxy](uint64_t key) { return (uint32_t)(key >> 32) == proxy || (uint32_t)key == proxy; };
+	mContacts.erase(std::remove_if(mContacts.begin(), mContacts.end(), [&](const Contact& c) { return involves(c.key); }), mContacts.end());
+	mSeparations.erase(std::remove_if(mSeparations.begin(), mSeparations.end(), [&](const Separation& s) { return involves(s.key); }), mSeparations.end());
+}
+
+} // namespace game
@@ -0,0 +1,96 @@
+#ifndef CONTACT_CACHE_H_
+#define CONTACT_CACHE_H_
+
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "broad_phase.h"
+
+namespace game {
+
+	class SceneNode;
+
+	enum ContactEvent {
+		ContactEnter, // First tick the pair touches
+		ContactStay,  // Every later tick it still does
+		ContactExit   // First tick it no longer does
+	};
+
+	// Gameplay reaction to a contact. The actor is the node on the lower layer, see CollisionLayer
+	typedef std::function<void(ContactEvent event, SceneNode* actor, SceneNode* other)> ContactHandler;
+
+	// class ContactCache
+	// Remembers which broad phase pairs touched on the last tick and turns this tick's contacts into
+	// enter, stay and exit events, sent to the handler registered for the two layers once the collision
+	// pass is over. It also keeps the separation the narrow phase last measured for each pair, so pairs
+	// that cannot have closed the gap since are not tested again.
+	// Pairs are keyed by their two broad phase proxies. When a proxy is removed its contacts are dropped
+	// without an exit event, since the node is on its way out
+	class ContactCache {
+
+	public:
+		ContactCache(void);
+
+		static inline uint64_t PairKey(uint32_t proxyA, uint32_t proxyB)
+		{
+			return proxyA < proxyB ? ((uint64_t)proxyA << 32) | proxyB : ((uint64_t)proxyB << 32) | proxyA;
+		}
+
+		void setHandler(CollisionLayer actor, CollisionLayer other, ContactHandler handler);
+
+		// True if the pair was apart by more than both nodes have moved since it was last measured,
+		// in which case that measurement carries over to this tick and the test can be skipped
+		bool stillApart(uint64_t key, SceneNode* a, SceneNode* b);
+		void recordSeparation(uint64_t key, SceneNode* a, SceneNode* b, float separation);
+
+		// The pair touches this tick
+		void touch(uint64_t key, SceneNode* actor, SceneNode* other, CollisionLayer actorLayer, CollisionLayer otherLayer);
+
+		// End the tick: compare with the last one and send the events
+		void update(void);
+
+		void forgetProxy(uint32_t proxy);
+
+	private:
+		struct Contact {
+			uint64_t key;
+			SceneNode* actor;
+			SceneNode* other;
+			CollisionLayer actorLayer;
+			CollisionLayer otherLayer;
+		};
+
+		// Where the pair was when its separation was measured. Only translation is accounted for,
+		// so a turn of either node invalidates it
+		struct Separation {
+			uint64_t key;
+			float distance;
+			glm::vec3 positionA;
+			glm::vec3 positionB;
+			glm::quat orientationA;
+			glm::quat orientationB;
+		};
+
+		struct Event {
+			ContactEvent type;
+			Contact contact;
+		};
+
+		// Last tick's lists are sorted by key, this tick's are sorted when it ends
+		std::vector<Contact> mContacts;
+		std::vector<Contact> mTouching;
+		std::vector<Separation> mSeparations;
+		std::vector<Separation> mMeasured;
+		std::vector<Event> mEvents;
+
+		ContactHandler mHandlers[LayerCount][LayerCount];
+
+	}; // class ContactCache
+
+} // namespace game
+
+#endif // CONTACT_CACHE_H_
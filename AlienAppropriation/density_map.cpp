@@ -0,0 +1,229 @@
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NOISE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_SSE
+#endif
+
+#include "density_map.h"
+
+namespace game {
+
+// Lattice values are hashed with adds, shifts and xors only (Jenkins' one-at-a-time), which SSE2 has for
+// 32 bit lanes, so the vector paths compute exactly what the scalar one does
+static inline uint32_t LatticeHash(uint32_t seed, int32_t x, int32_t z)
+{
+	uint32_t h = seed;
+	h += (uint32_t)x;
+	h += h << 10;
+	h ^= h >> 6;
+	h += (uint32_t)z;
+	h += h << 10;
+	h ^= h >> 6;
+	h += h << 3;
+	h ^= h >> 11;
+	h += h << 15;
+	return h;
+}
+
+
+static inline float LatticeValue(uint32_t seed, int32_t x, int32_t z)
+{
+	return (float)(LatticeHash(seed, x, z) >> 8) * (1.0f / 16777216.0f);
+}
+
+
+// Each octave has its own lattice
+static inline uint32_t OctaveSeed(uint32_t seed, int octave)
+{
+	return seed + (uint32_t)octave * 0x9e3779b9u;
+}
+
+
+NoiseField::NoiseField(uint32_t seed, float scale, int octaves)
+	: mSeed(seed)
+	, mFrequency(1.0f / scale)
+	, mOctaves(octaves)
+{
+	float total = 0.0f, weight = 1.0f;
+	for (int octave = 0; octave < octaves; octave++) {
+		total += weight;
+		weight *= 0.5f;
+	}
+	mNormalize = 1.0f / total;
+}
+
+
+float NoiseField::evaluate(float x, float z) const
+{
+	float sum = 0.0f, weight = 1.0f, frequency = mFrequency;
+	for (int octave = 0; octave < mOctaves; octave++) {
+		uint32_t seed = OctaveSeed(mSeed, octave);
+		float u = x * frequency, v = z * frequency;
+		float fu = floorf(u), fv = floorf(v);
+		int32_t ix = (int32_t)fu, iz = (int32_t)fv;
+		float tx = u - fu, tz = v - fv;
+		tx = tx * tx * (3.0f - 2.0f * tx);
+		tz = tz * tz * (3.0f - 2.0f * tz);
+
+		float v00 = LatticeValue(seed, ix, iz), v10 = LatticeValue(seed, ix + 1, iz);
+		float v01 = LatticeValue(seed, ix, iz + 1), v11 = LatticeValue(seed, ix + 1, iz + 1);
+		float a = v00 + (v10 - v00) * tx;
+		float b = v01 + (v11 - v01) * tx;
+		sum += weight * (a + (b - a) * tz);
+
+		weight *= 0.5f;
+		frequency *= 2.0f;
+	}
+	return sum * mNormalize;
+}
+
+
+#if defined(NOISE_AVX2)
+static inline __m256 LatticeValues(__m256i seed, __m256i x, __m256i z)
+{
+	__m256i h = _mm256_add_epi32(seed, x);
+	h = _mm256_add_epi32(h, _mm256_slli_epi32(h, 10));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 6));
+	h = _mm256_add_epi32(h, z);
+	h = _mm256_add_epi32(h, _mm256_slli_epi32(h, 10));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 6));
+	h = _mm256_add_epi32(h, _mm256_slli_epi32(h, 3));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 11));
+	h = _mm256_add_epi32(h, _mm256_slli_epi32(h, 15));
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+}
+#elif defined(NOISE_SSE)
+static inline __m128 LatticeValues(__m128i seed, __m128i x, __m128i z)
+{
+	__m128i h = _mm_add_epi32(seed, x);
+	h = _mm_add_epi32(h, _mm_slli_epi32(h, 10));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 6));
+	h = _mm_add_epi32(h, z);
+	h = _mm_add_epi32(h, _mm_slli_epi32(h, 10));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 6));
+	h = _mm_add_epi32(h, _mm_slli_epi32(h, 3));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 11));
+	h = _mm_add_epi32(h, _mm_slli_epi32(h, 15));
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+#endif
+
+
+void NoiseField::evaluate(const float* x, const float* z, float* out, size_t count) const
+{
+	size_t i = 0;
+
+#if defined(NOISE_AVX2)
+	const __m256 three = _mm256_set1_ps(3.0f), two = _mm256_set1_ps(2.0f);
+	const __m256i one = _mm256_set1_epi32(1);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), pz = _mm256_loadu_ps(z + i);
+		__m256 sum = _mm256_setzero_ps();
+		float weight = 1.0f, frequency = mFrequency;
+		for (int octave = 0; octave < mOctaves; octave++) {
+			__m256i seed = _mm256_set1_epi32((int)OctaveSeed(mSeed, octave));
+			__m256 u = _mm256_mul_ps(px, _mm256_set1_ps(frequency));
+			__m256 v = _mm256_mul_ps(pz, _mm256_set1_ps(frequency));
+			__m256 fu = _mm256_floor_ps(u), fv = _mm256_floor_ps(v);
+			__m256i ix = _mm256_cvttps_epi32(fu), iz = _mm256_cvttps_epi32(fv);
+			__m256 tx = _mm256_sub_ps(u, fu), tz = _mm256_sub_ps(v, fv);
+			tx = _mm256_mul_ps(_mm256_mul_ps(tx, tx), _mm256_sub_ps(three, _mm256_mul_ps(two, tx)));
+			tz = _mm256_mul_ps(_mm256_mul_ps(tz, tz), _mm256_sub_ps(three, _mm256_mul_ps(two, tz)));
+
+			__m256i ix1 = _mm256_add_epi32(ix, one), iz1 = _mm256_add_epi32(iz, one);
+			__m256 v00 = LatticeValues(seed, ix, iz), v10 = LatticeValues(seed, ix1, iz);
+			__m256 v01 = LatticeValues(seed, ix, iz1), v11 = LatticeValues(seed, ix1, iz1);
+			__m256 a = _mm256_add_ps(v00, _mm256_mul_ps(_mm256_sub_ps(v10, v00), tx));
+			__m256 b = _mm256_add_ps(v01, _mm256_mul_ps(_mm256_sub_ps(v11, v01), tx));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weight), _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), tz))));
+
+			weight *= 0.5f;
+			frequency *= 2.0f;
+		}
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(sum, _mm256_set1_ps(mNormalize)));
+	}
+#elif defined(NOISE_SSE)
+	const __m128 three = _mm_set1_ps(3.0f), two = _mm_set1_ps(2.0f), unit = _mm_set1_ps(1.0f);
+	const __m128i one = _mm_set1_epi32(1);
+
+	// No floor in SSE2: truncate, then step down where that rounded up
+	auto floor4 = [&](__m128 v) {
+		__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+		return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), unit));
+	};
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), pz = _mm_loadu_ps(z + i);
+		__m128 sum = _mm_setzero_ps();
+		float weight = 1.0f, frequency = mFrequency;
+		for (int octave = 0; octave < mOctaves; octave++) {
+			__m128i seed = _mm_set1_epi32((int)OctaveSeed(mSeed, octave));
+			__m128 u = _mm_mul_ps(px, _mm_set1_ps(frequency));
+			__m128 v = _mm_mul_ps(pz, _mm_set1_ps(frequency));
+			__m128 fu = floor4(u), fv = floor4(v);
+			__m128i ix = _mm_cvttps_epi32(fu), iz = _mm_cvttps_epi32(fv);
+			__m128 tx = _mm_sub_ps(u, fu), tz = _mm_sub_ps(v, fv);
+			tx = _mm_mul_ps(_mm_mul_ps(tx, tx), _mm_sub_ps(three, _mm_mul_ps(two, tx)));
+			tz = _mm_mul_ps(_mm_mul_ps(tz, tz), _mm_sub_ps(three, _mm_mul_ps(two, tz)));
+
+			__m128i ix1 = _mm_add_epi32(ix, one), iz1 = _mm_add_epi32(iz, one);
+			__m128 v00 = LatticeValues(seed, ix, iz), v10 = LatticeValues(seed, ix1, iz);
+			__m128 v01 = LatticeValues(seed, ix, iz1), v11 = LatticeValues(seed, ix1, iz1);
+			__m128 a = _mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v10, v00), tx));
+			__m128 b = _mm_add_ps(v01, _mm_mul_ps(_mm_sub_ps(v11, v01), tx));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight), _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), tz))));
+
+			weight *= 0.5f;
+			frequency *= 2.0f;
+		}
+		_mm_storeu_ps(out + i, _mm_mul_ps(sum, _mm_set1_ps(mNormalize)));
+	}
+#endif
+
+	for (; i < count; i++) {
+		out[i] = evaluate(x[i], z[i]);
+	}
+}
+
+
+// Features a few chunks across, biomes larger than density patches
+static const float DENSITY_SCALE = 300.0f;
+static const float BIOME_SCALE = 450.0f;
+// Summed octaves bunch up around one half; these stretch the density back over [0, 1]
+static const float DENSITY_LOW = 0.25f;
+static const float DENSITY_HIGH = 0.75f;
+// Biome field values below these are pasture, then farm, then forest
+static const float PASTURE_BELOW = 0.45f;
+static const float FARM_BELOW = 0.58f;
+
+
+DensityMap::DensityMap(uint32_t seed, const glm::vec2& corner, float size)
+	: mSize(size)
+{
+	const int count = RASTER_SIZE * RASTER_SIZE;
+	float x[count], z[count], wild[count];
+	float step = size / RASTER_SIZE;
+	for (int j = 0; j < RASTER_SIZE; j++) {
+		for (int i = 0; i < RASTER_SIZE; i++) {
+			x[j * RASTER_SIZE + i] = corner.x + (i + 0.5f) * step;
+			z[j * RASTER_SIZE + i] = corner.y + (j + 0.5f) * step;
+		}
+	}
+
+	NoiseField density(seed ^ 0x5bd1e995u, DENSITY_SCALE, 3);
+	NoiseField biome(seed ^ 0x27d4eb2fu, BIOME_SCALE, 2);
+	density.evaluate(x, z, mDensity, count);
+	biome.evaluate(x, z, wild, count);
+
+	for (int i = 0; i < count; i++) {
+		mDensity[i] = glm::clamp((mDensity[i] - DENSITY_LOW) / (DENSITY_HIGH - DENSITY_LOW), 0.0f, 1.0f);
+		mBiome[i] = (uint8_t)(wild[i] < PASTURE_BELOW ? BiomePasture : (wild[i] < FARM_BELOW ? BiomeFarm : BiomeForest));
+	}
+}
+
+} // namespace game
@@ -0,0 +1,76 @@
+#ifndef DENSITY_MAP_H_
+#define DENSITY_MAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <glm/glm.hpp>
+
+namespace game {
+
+	// class NoiseField
+	// Value noise over the whole world: random values on a lattice, hashed from the lattice point and the seed
+	// so nothing is stored, blended smoothly in between and summed over a few octaves. Values are in [0, 1]
+	class NoiseField {
+
+	public:
+		// scale is the lattice spacing of the first octave, in world units
+		NoiseField(uint32_t seed, float scale, int octaves);
+
+		float evaluate(float x, float z) const;
+		// evaluate for count points. Uses AVX2 or SSE when the build enables them
+		void evaluate(const float* x, const float* z, float* out, size_t count) const;
+
+	private:
+		uint32_t mSeed;
+		float mFrequency;
+		int mOctaves;
+		float mNormalize; // One over the sum of the octave weights
+
+	}; // class NoiseField
+
+
+	// class DensityMap
+	// What to place where: rasters of how crowded a square of the world is and which biome it belongs to,
+	// filled from noise fields when the square is planned. Looking a point up is one raster read, however many
+	// kinds of object there are
+	class DensityMap {
+
+	public:
+		// Samples along each side of the square
+		static const int RASTER_SIZE = 16;
+
+		enum Biome {
+			BiomePasture, // Open fields of hay
+			BiomeFarm,    // Hay and barns
+			BiomeForest,  // Trees
+			BiomeCount
+		};
+
+		// Rasters for the square of side size whose low corner is at corner
+		DensityMap(uint32_t seed, const glm::vec2& corner, float size);
+
+		// In [0, 1], where 1 is as crowded as the map gets. local is relative to the corner
+		float getDensity(const glm::vec2& local) const { return mDensity[Cell(local)]; }
+		Biome getBiome(const glm::vec2& local) const { return (Biome)mBiome[Cell(local)]; }
+
+		// The whole density raster, one row of x per z
+		inline const float* getDensities(void) const { return mDensity; }
+
+	private:
+		float mSize;
+		float mDensity[RASTER_SIZE * RASTER_SIZE];
+		uint8_t mBiome[RASTER_SIZE * RASTER_SIZE];
+
+		inline int Cell(const glm::vec2& local) const
+		{
+			int x = glm::clamp((int)(local.x / mSize * RASTER_SIZE), 0, RASTER_SIZE - 1);
+			int z = glm::clamp((int)(local.y / mSize * RASTER_SIZE), 0, RASTER_SIZE - 1);
+			return z * RASTER_SIZE + x;
+		}
+
+	}; // class DensityMap
+
+} // namespace game
+
+#endif // DENSITY_MAP_H_
@@ -8,26 +8,23 @@
 namespace game
 {
 
+// Random duration for a grazing behaviour, in seconds
+static float RandomPeriod(float minPeriod, float maxPeriod)
+{
+	return minPeriod + (maxPeriod - minPeriod) * static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+}
+
 
 CowEntityNode::CowEntityNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture) 
 	: EntityNode(name, geometry, material, texture)
-	, mLastTimer(0.0f)
-	, mNextTimer(0.0f)
 {
 	addTag("canPickUp");
 	addTag("cow");
 	addTag("canCollect");
+	enableHeading();
+	followTerrain();
 
-	int defaultBehaviour = rand() % 2;
-	switch (defaultBehaviour)
-	{
-	case 0:
-		mBehaviour = stand;
-		break;
-	case 1:
-		mBehaviour = walk;
-		break;
-	}
+	startBehaviour(graze(0.0f));
 }
 
 CowEntityNode::~CowEntityNode()
@@ -35,53 +32,41 @@ CowEntityNode::~CowEntityNode()
 
 }
 
-void CowEntityNode::update(double deltaTime)
+// Basic Cow should walk around occasionally, and stop occasionally
+// This behaviors repeats indefinitely
+// If a cow is picked up and then dropped, it should run around erratically for some time, before stopping and continuing normal behavior
+Behaviour CowEntityNode::graze(float runTime)
 {
-	EntityNode::update(deltaTime);
-
-	// Basic Cow should walk around occasionally, and stop occasionally
-	// This behaviors repeats indefinitely
-	// If a cow is picked up and then dropped, it should run around erratically for some time, before stopping and continuing normal behavior
-
-	// Behaviour state timer stuff
-	float currentTime = glfwGetTime();
-	if (currentTime >= mNextTimer)
-	{
-		if (mNextTimer != 0.0f)
-		{
-			if (mBehaviour == stand)
-				mBehaviour = walk;
-			else if (mBehaviour == walk)
-				mBehaviour = stand;
-			else if (mBehaviour == run)
-				mBehaviour = stand;
-		}
-
-		mLastTimer = currentTime;
-
-		float minPeriod = 2.0f;
-		float maxPeriod = 6.0f;
-
-		mNextTimer = currentTime + minPeriod + static_cast <float> (rand()) / static_cast <float> (RAND_MAX / maxPeriod - minPeriod);
+	double stopTime = BehaviourScheduler::Now() + runTime;
+	while (BehaviourScheduler::Now() < stopTime) {
+		if (mIsGrounded) doRun();
+		co_await sleep(0.0);
 	}
 
-	// Behaviour Stuff
-	if (mIsGrounded)
-	{
-		if (mBehaviour == stand)
-			doStand();
-		else if (mBehaviour == walk)
-			doWalk();
-		else if (mBehaviour == run)
-			doRun();
+	bool walking = runTime == 0.0f && rand() % 2 == 1;
+	for (;;) {
+		float period = RandomPeriod(2.0f, 6.0f);
+		if (walking) {
+			// Change direction a little every tick
+			stopTime = BehaviourScheduler::Now() + period;
+			while (BehaviourScheduler::Now() < stopTime) {
+				if (mIsGrounded) doWalk();
+				co_await sleep(0.0);
+			}
+		}
+		else {
+			// Nothing to do until it is time to walk again
+			if (mIsGrounded) doStand();
+			co_await sleep(period);
+		}
+		walking = !walking;
 	}
-
 }
 
 void CowEntityNode::hitGround()
 {
-	mBehaviour = run;
-	mNextTimer = glfwGetTime() + 6.0f;
+	stopBehaviours();
+	startBehaviour(graze(6.0f));
 }
 
 void CowEntityNode::doStand()
@@ -99,7 +84,7 @@ void CowEntityNode::doWalk()
 
 	mVelocity += 0.02f * glm::normalize(dirVec);
 	mVelocity = 0.2f * glm::normalize(mVelocity);
-	rotate(mVelocity);
+	face(mVelocity);
 }
 
 void CowEntityNode::doRun()
@@ -112,7 +97,7 @@ void CowEntityNode::doRun()
 
 	mVelocity += 0.2f * glm::normalize(dirVec);
 	mVelocity = 0.5f * glm::normalize(mVelocity);
-	rotate(mVelocity);
+	face(mVelocity);
 }
 
 
@@ -121,27 +106,15 @@ void CowEntityNode::doRun()
 
 BullEntityNode::BullEntityNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture /*= NULL*/)
 	: EntityNode(name, geometry, material, texture)
-	, mLastTimer(0.0f)
-	, mNextTimer(0.0f)
 {
 
 	addTag("canPickUp");
 	addTag("bull");
 	addTag("canCollect");
-	// Random start behaviour
-	int defaultBehaviour = rand() % 2;
-	switch (defaultBehaviour)
-	{
-	case 0: 
-		mBehaviour = stand;
-		break;
-	case 1: 
-		mBehaviour = walk;
-		break;
-	}
+	enableHeading();
+	followTerrain();
 
-	// Behaviour override
-	//mBehaviour = run;
+	startBehaviour(graze(0.0f));
 }
 
 
@@ -150,55 +123,40 @@ BullEntityNode::~BullEntityNode()
 
 }
 
-void BullEntityNode::update(double deltaTime)
+// Similar to cow
+// Walks around (but faster) and grazes
+// Will run for longer when dropped
+//Thrashing will occur when picked up?
+Behaviour BullEntityNode::graze(float runTime)
 {
-	EntityNode::update(deltaTime);
-
-	// Similar to cow
-	// Walks around (but faster) and grazes
-	// Will thrash if picked up and will run for longer when dropped
-
-	//Timer Stuff
-	float currentTime = glfwGetTime();
-	if (currentTime >= mNextTimer)
-	{
-		if (mNextTimer != 0.0f)
-		{
-			if (mBehaviour == stand)
-				mBehaviour = walk;
-			else if (mBehaviour == walk)
-				mBehaviour = stand;
-			else if (mBehaviour == run)
-				mBehaviour = stand;
-		}
-
-		mLastTimer = currentTime;
-
-		float minPeriod = 3.0f;
-		float maxPeriod = 6.0f;
-
-		mNextTimer = currentTime + minPeriod + static_cast <float> (rand()) / static_cast <float> (RAND_MAX / maxPeriod - minPeriod);
+	double stopTime = BehaviourScheduler::Now() + runTime;
+	while (BehaviourScheduler::Now() < stopTime) {
+		if (mIsGrounded) doRun();
+		co_await sleep(0.0);
 	}
 
-	// Behaviour Stuff
-	if (mIsGrounded)
-	{
-		if (mBehaviour == stand)
-			doStand();
-		else if (mBehaviour == walk)
-			doWalk();
-		else if (mBehaviour == run)
-			doRun();
+	bool walking = runTime == 0.0f && rand() % 2 == 1;
+	for (;;) {
+		float period = RandomPeriod(3.0f, 6.0f);
+		if (walking) {
+			stopTime = BehaviourScheduler::Now() + period;
+			while (BehaviourScheduler::Now() < stopTime) {
+				if (mIsGrounded) doWalk();
+				co_await sleep(0.0);
+			}
+		}
+		else {
+			if (mIsGrounded) doStand();
+			co_await sleep(period);
+		}
+		walking = !walking;
 	}
-
-	//Thrashing will occur when picked up?
-	//When dropped, need to manually set mNextTimer to a greater number than cow
 }
 
 void BullEntityNode::hitGround()
 {
-	mBehaviour = run;
-	mNextTimer = glfwGetTime() + 8.0f;
+	stopBehaviours();
+	startBehaviour(graze(8.0f));
 }
 
 void BullEntityNode::doStand()
@@ -216,7 +174,7 @@ void BullEntityNode::doWalk()
 
 	mVelocity += 0.02f * glm::normalize(dirVec);
 	mVelocity = 0.2f * glm::normalize(mVelocity);
-	rotate(mVelocity);
+	face(mVelocity);
 }
 
 void BullEntityNode::doRun()
@@ -229,7 +187,7 @@ void BullEntityNode::doRun()
 
 	mVelocity += 0.3f * glm::normalize(dirVec);
 	mVelocity = 0.6f * glm::normalize(mVelocity);
-	rotate(mVelocity);
+	face(mVelocity);
 }
 
 
@@ -240,9 +198,13 @@ void BullEntityNode::doRun()
 
 FarmerEntityNode::FarmerEntityNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture /*= NULL*/)
 	: EntityNode(name, geometry, material, texture)
-	, mNextTimer(0.0f)
 {
 	addTag("canPickUp");
+	enableHeading();
+	followTerrain();
+
+	startBehaviour(stalk());
+	startBehaviour(shoot());
 }
 
 FarmerEntityNode::~FarmerEntityNode()
@@ -250,57 +212,61 @@ FarmerEntityNode::~FarmerEntityNode()
 
 }
 
-void FarmerEntityNode::update(double deltaTime)
+float FarmerEntityNode::distanceToPlayer(void)
 {
-	EntityNode::update(deltaTime);
-
-
 	glm::vec3 playerPos = SceneGraph::getPlayerNode()->getPosition();
 	playerPos.y = 0;
+	return glm::distance(mPosition, playerPos);
+}
 
-	glm::vec3 dirPlayer = playerPos - mPosition;
-	dirPlayer.y = 0.0f;
-
-	// If player is within range x, rotate to face player and walk towards until player is within range v
-	if (glm::distance(mPosition, playerPos) < 70.0)
-	{
-		rotate(dirPlayer);
+// If player is within range x, rotate to face player and walk towards until player is within range v
+Behaviour FarmerEntityNode::stalk(void)
+{
+	for (;;) {
+		co_await until([this]() { return distanceToPlayer() < 70.0f; });
+
+		while (distanceToPlayer() < 70.0f) {
+			glm::vec3 dirPlayer = SceneGraph::getPlayerNode()->getPosition() - mPosition;
+			dirPlayer.y = 0.0f;
+			face(dirPlayer);
+
+			if (mIsGrounded) {
+				if (distanceToPlayer() > 10.0f)
+					mVelocity = 0.2f * glm::normalize(dirPlayer);
+				else
+					mVelocity = glm::vec3(0.0f);
+			}
+			co_await sleep(0.0);
+		}
 
-		if (glm::distance(mPosition, playerPos) > 10.0)
-			mVelocity = 0.2f * glm::normalize(dirPlayer);
-		else
-			mVelocity = glm::vec3(0.0f);
+		if (mIsGrounded) mVelocity = glm::vec3(0.0f);
 	}
-	else
-		mVelocity = glm::vec3(0.0f);
-
-	// If player is within range y, and its been atleast z seconds since last shot, fire shotgun at player
-	// Shotgun will auto hit and cant be dodged
-	if (glm::distance(mPosition, playerPos) < 20.0)
-	{
-		float currentTime = glfwGetTime();
-		if (currentTime >= mNextTimer)
-		{
-			doFire();
-
-			// In the meantime, player entity will rise 1 unit.
-			//mPosition.y += 1.0;
+}
 
-			mNextTimer = currentTime + 5.0f;
-		}
+// If player is within range y, and its been atleast z seconds since last shot, fire shotgun at player
+// Shotgun hits unless something solid is in the way
+Behaviour FarmerEntityNode::shoot(void)
+{
+	for (;;) {
+		co_await until([this]() { return distanceToPlayer() < 20.0f; });
+		doFire();
+		co_await sleep(5.0);
 	}
-
 }
 
 
 void FarmerEntityNode::hitGround()
 {
-	addTag("delete");
+	SceneGraph::deleteNode(this);
 }
 
 void FarmerEntityNode::doFire()
 {
-	SceneGraph::getPlayerNode()->takeDamage(GUN);
+	PlayerNode* player = SceneGraph::getPlayerNode();
+	RayHit hit;
+	if (SceneGraph::segmentCast(mPosition, player->getPosition(), hit, LayerBit(LayerPlayer) | LayerBit(LayerScenery), this) && hit.node == player) {
+		player->takeDamage(GUN);
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -313,6 +279,8 @@ CannonMissileEntityNode::CannonMissileEntityNode(const std::string name, const R
 	, mProjectiles(0)
 {
 	addTag("bombable");
+	enableHeading();
+	followTerrain();
 }
 
 CannonMissileEntityNode::~CannonMissileEntityNode()
@@ -330,13 +298,13 @@ void CannonMissileEntityNode::update(double deltaTime)
 	glm::vec3 dirPlayer = playerPos - mPosition;
 	dirPlayer.y = 0.0f;
 
-	rotate(dirPlayer);
+	face(dirPlayer);
 
 	float currentTime = glfwGetTime();
 
 	if (currentTime >= mNextTimer)
 	{
-		if (glm::distance(mPosition, playerPos) < 50.0)
+		if (glm::distance(mPosition, playerPos) < 50.0 && canSeePlayer())
 		{
 			fireHeatMissile();
 
@@ -350,7 +318,15 @@ void CannonMissileEntityNode::update(double deltaTime)
 
 void CannonMissileEntityNode::hitGround()
 {
-	addTag("delete");
+	SceneGraph::deleteNode(this);
+}
+
+// Nothing solid between the cannon and the player
+bool CannonMissileEntityNode::canSeePlayer(void)
+{
+	PlayerNode* player = SceneGraph::getPlayerNode();
+	RayHit hit;
+	return SceneGraph::segmentCast(mPosition, player->getPosition(), hit, LayerBit(LayerPlayer) | LayerBit(LayerScenery), this) && hit.node == player;
 }
 
 void CannonMissileEntityNode::fireHeatMissile()
@@ -362,6 +338,7 @@ void CannonMissileEntityNode::fireHeatMissile()
 
 	glm::vec3 initVelVec = 1.0f * glm::normalize(dirPlayer);
 	HeatMissileNode* missile = SceneGraph::CreateProjectileInstance<HeatMissileNode>(getName() + "missile" + std::to_string(mProjectiles), "missileMesh", "texturedMaterial", "missileTexture", 10, mPosition, initVelVec);
+	SceneGraph::setCollisionLayer(missile, LayerProjectile);
 	mProjectiles += 1;
 	//missile->scale(glm::vec3(0.2, 0.2, 1.5));
 }
@@ -32,30 +32,17 @@ namespace game {
 		// Destructor
 		~CowEntityNode();
 
-		virtual void update(double deltaTime);
-
 	private:
 
 		void hitGround();
 
+		// Alternate between standing and walking forever, after running around for runTime seconds
+		Behaviour graze(float runTime);
+
 		void doStand();
 		void doWalk();
 		void doRun();
 
-		enum Behaviour
-		{
-			walk,
-			stand,
-			run	
-		};
-
-		Behaviour mBehaviour;
-
-
-		// Timers for behaviors purposes
-		float mLastTimer;
-		float mNextTimer;
-
 	}; // class CowEntityNode
 
 
@@ -71,30 +58,17 @@ namespace game {
 		// Destructor
 		~BullEntityNode();
 
-		void update(double deltaTime);
-
 	private:
 
 		void hitGround();
 
+		// Alternate between standing and walking forever, after running around for runTime seconds
+		Behaviour graze(float runTime);
+
 		void doStand();
 		void doWalk();
 		void doRun();
 
-		enum Behaviour
-		{
-			walk,
-			stand,
-			run,
-			thrash
-		};
-
-		Behaviour mBehaviour;
-
-		// Timers for behaviors purposes
-		float mLastTimer;
-		float mNextTimer;
-
 	}; // class BullEntityNode
 
 
@@ -110,17 +84,18 @@ namespace game {
 		// Destructor
 		~FarmerEntityNode();
 
-		void update(double deltaTime);
-		
-
 	private:
 
 		void hitGround();
 
-		void doFire();
+		// Walk towards the player while they are in sight
+		Behaviour stalk(void);
+		// Shoot whenever the player is in range, reloading in between
+		Behaviour shoot(void);
 
-		// Timers for behaviors purposes
-		float mNextTimer;
+		float distanceToPlayer(void);
+
+		void doFire();
 
 	}; // class FarmerEntityNode
 
@@ -143,6 +118,7 @@ namespace game {
 		void hitGround();
 
 		void fireHeatMissile();
+		bool canSeePlayer(void);
 
 		// Timers for behaviors purposes
 		float mLastTimer;
@@ -1,6 +1,9 @@
 
 #include "entity_node.h"
 #include "player_node.h"
+#include "kinematics.h"
+#include "heading_table.h"
+#include "terrain.h"
 
 namespace game
 {
@@ -11,8 +14,10 @@ EntityNode::EntityNode(const std::string name, const Resource *geometry, const R
 	, mVelocity(glm::vec3(0.0f,0.0f,0.0f))
 	, mAcceleration(glm::vec3(0.0f, 0.0f, 0.0f))
 	, mIsGrounded(true)
+	, mFollowsTerrain(false)
+	, mHeadingSlot(HeadingTable::NO_SLOT)
 {
-
+	mKinematicSlot = KinematicsSystem::Register(this);
 }
 
 EntityNode::~EntityNode()
@@ -24,36 +29,16 @@ EntityNode::~EntityNode()
 
 void EntityNode::update(double deltaTime)
 {
-	//Apply Gravity
-	if (!mIsGrounded)
-	{
-		if (mPosition.y > 0.0f)
-		{
-			mVelocity += GRAVITY;
-			mVelocity.x = 0.0f;
-			mVelocity.z = 0.0f;
-		}
-		else
-		{
-			mVelocity.y = 0.0f;
-			mPosition.y = 0.0f;
-			mIsGrounded = true;
-			hitGround();
-		}
-	}
-	else
-		mVelocity.y = std::max(mVelocity.y, 0.0f);
-
-	mPosition += mVelocity;
-
-	SceneNode::update(deltaTime);
-
+	// Skip SceneNode::update, the kinematics pass moves entities
+	BaseNode::update(deltaTime);
 }
 
 void EntityNode::rise(glm::vec3 dir)
 {
- 	if (mPosition.y == 0.0f)
-		mPosition.y = 0.1f;
+	// Lift off the ground first, or the kinematics pass lands the entity again straight away
+	float ground = Terrain::getHeight(mPosition.x, mPosition.z);
+	if (mPosition.y <= ground)
+		mPosition.y = ground + 0.1f;
 	mVelocity += glm::vec3(0.0, 0.2, 0.0) + -GRAVITY;
 	setIsGrounded(false);
 }
@@ -63,6 +48,53 @@ void EntityNode::hitGround()
 
 }
 
+void EntityNode::onDeleted(void)
+{
+	stopBehaviours();
+	if (mKinematicSlot != KinematicsSystem::NO_SLOT) {
+		KinematicsSystem::Unregister(mKinematicSlot);
+		mKinematicSlot = KinematicsSystem::NO_SLOT;
+	}
+	if (mHeadingSlot != HeadingTable::NO_SLOT) {
+		HeadingTable::Unregister(mHeadingSlot);
+		mHeadingSlot = HeadingTable::NO_SLOT;
+	}
+	SceneNode::onDeleted();
+}
+
+void EntityNode::startBehaviour(Behaviour behaviour)
+{
+	mBehaviours.push_back(BehaviourScheduler::Start(std::move(behaviour)));
+}
+
+void EntityNode::stopBehaviours(void)
+{
+	for (BehaviourHandle handle : mBehaviours) {
+		BehaviourScheduler::Stop(handle);
+	}
+	mBehaviours.clear();
+}
+
+void EntityNode::enableHeading(void)
+{
+	if (mHeadingSlot == HeadingTable::NO_SLOT) {
+		mHeadingSlot = HeadingTable::Register(this, 0.0f);
+	}
 }
 
+void EntityNode::setHeadingFrom(const glm::quat& orientation)
+{
+	if (mHeadingSlot == HeadingTable::NO_SLOT) return;
+	face(orientation * glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+void EntityNode::face(glm::vec3 direction)
+{
+	// Same dead zone as rotate, too short to have a direction
+	if (direction.x * direction.x + direction.z * direction.z < 0.0001f)
+		return;
 
+	HeadingTable::setHeading(mHeadingSlot, atan2f(direction.x, direction.z));
+}
+
+}
@@ -5,6 +5,7 @@
 #include <algorithm>
 
 #include "scene_node.h"
+#include "behaviour.h"
 
 #define GRAVITY glm::vec3(0.0f, -1.0f, 0.0f)
 
@@ -14,6 +15,9 @@ namespace game {
 	// A node with some movement behaviour
 	class EntityNode : public SceneNode {
 
+		friend class KinematicsSystem;
+		friend class HeadingTable;
+
 	public:
 		// Create scene node from given resources
 		EntityNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture = NULL);
@@ -21,15 +25,36 @@ namespace game {
 		// Destructor
 		~EntityNode();
 
+		// Movement itself is integrated for all entities at once by the KinematicsSystem
 		virtual void update(double deltaTime);
 
 		void rise(glm::vec3 dir);
 
+		inline glm::vec3 getVelocity(void) const { return mVelocity; }
+		inline void setVelocity(const glm::vec3& velocity) { mVelocity = velocity; }
 		inline bool getIsGrounded() { return mIsGrounded; }
 		inline void setIsGrounded(bool b) { mIsGrounded = b; }
+		// Turn a ground entity to face where orientation faces. Its heading decides its orientation from the next
+		// extract on, so setOrientation alone does not last. Does nothing to other entities
+		void setHeadingFrom(const glm::quat& orientation);
+
+		// Stops all behaviours
+		virtual void onDeleted(void);
 
 	protected:
 
+		// Behaviours run on the behaviour scheduler until they finish, are stopped, or the node is deleted
+		void startBehaviour(Behaviour behaviour);
+		void stopBehaviours(void);
+
+		// Ground entities only turn about the vertical axis. They keep a heading angle in the HeadingTable,
+		// which sets their orientation when the scene is extracted, instead of calling rotate every tick
+		void enableHeading(void);
+		// Walkers are kept on the terrain while they are grounded. Anything else that is grounded, like hay
+		// with its prefab offset or a missile in flight, keeps its height and only cannot move down
+		inline void followTerrain(void) { mFollowsTerrain = true; }
+		void face(glm::vec3 direction);
+
 		//PlayerNode* getPlayerNode();
 		//glm::vec3 getPlayerPosition();
 
@@ -38,8 +63,13 @@ namespace game {
 		glm::vec3 mAcceleration;
 
 		bool mIsGrounded;
+		bool mFollowsTerrain;
 
 	private:
+		std::vector<BehaviourHandle> mBehaviours;
+		uint32_t mKinematicSlot;
+		uint32_t mHeadingSlot;
+
 		virtual void hitGround();
 
 
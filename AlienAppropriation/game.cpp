@@ -1,10 +1,15 @@
 #include <iostream>
 #include <time.h>
 #include <sstream>
+#include <chrono>
+#include <fstream>
 
 #include "game.h"
 #include "bin/path_config.h"
 #include "entity_game_nodes.h"
+#include "logger.h"
+#include "terrain.h"
+#include "prefab.h"
 
 namespace game {
 
@@ -26,32 +31,103 @@ glm::vec3 camera_position_g(100.0, 15.0, 100.0);
 glm::vec3 camera_look_at_g(100.0, 15.0, 50.0);
 glm::vec3 camera_up_g(0.0, 1.0, 0.0);
 
+// Simulation settings
+const double sim_tick_g = 0.05; // Seconds between scene updates
+const uint64_t profile_log_ticks_g = 200; // Ticks between frame phase timings in the log
+const std::string frame_graph_file_g = "frame_graph.dot"; // Written when F9 is pressed
+const int map_file_radius_g = 8; // Chunks around the start saved in a map file
+const std::string quicksave_file_g = "quicksave.snap"; // Written with F5, read back with F6
+const bool snapshot_compress_g = true;
+
 // Materials
 const std::string shader_directory = SHADER_DIRECTORY;
 const std::string asset_directory = ASSET_DIRECTORY;
 
 
 Game::Game(void)
+	: mWindow(NULL)
+	, mSceneGraph(NULL)
+	, mResourceManager(NULL)
+	, mMapGenerator(NULL)
+	, mSeed(0)
+	, mHasSeed(false)
+	, mMapLoaded(false)
+	, mSnapshot(NULL)
+	, mCamera(NULL)
+	, skybox_(NULL)
+	, mRenderer(NULL)
+	, mRunning(false)
+	, mTickDelta(0.0)
+	, mStreamCenter(0.0f)
+	, mPlayerDead(false)
+	, mDumpFrameGraph(false)
+	, mSaveSnapshot(false)
+	, mLoadSnapshot(false)
 {
 
 }
 
 
+void Game::setSeed(unsigned int seed)
+{
+	mSeed = seed;
+	mHasSeed = true;
+}
+
+
+void Game::setMapFile(const std::string& path)
+{
+	mMapFile = path;
+}
+
+
+void Game::setSnapshotFile(const std::string& path)
+{
+	mSnapshotFile = path;
+}
+
+
 void Game::Init(void)
 {
+	// Start the background log writer before anything can log
+	Logger::Init();
+
 	// Set up base variables and members
 	mResourceManager = new ResourceManager();
 	mCamera = new Camera("camera");
+	mRenderer = new Renderer();
 	// Set up the base nodes
 	mSceneGraph = new SceneGraph(mCamera);
-	mMapGenerator = new MapGenerator(mSceneGraph);
+
+	// A snapshot can only be restored into the world it was taken in
+	if (!mSnapshotFile.empty()) {
+		mSnapshot = new WorldSnapshot();
+		if (mSnapshot->open(mSnapshotFile)) {
+			setSeed(mSnapshot->getSeed());
+		}
+		else {
+			LOG_WARNING("No snapshot %s, starting a new world", mSnapshotFile.c_str());
+			delete mSnapshot;
+			mSnapshot = NULL;
+		}
+	}
+
+	// Everything random in the world comes from the seed: the terrain, the map and the rand() the game plays with
+	if (!mHasSeed) mSeed = (unsigned int)time(0);
+	mMapGenerator = new MapGenerator(mSceneGraph, mSeed);
+	if (!mMapFile.empty() && mMapGenerator->LoadMap(mMapFile)) {
+		mSeed = mMapGenerator->getSeed();
+		mMapLoaded = true;
+		LOG_INFO("Loaded map %s", mMapFile.c_str());
+	}
+	LOG_INFO("World seed %u", mSeed);
 
     // Run all initialization steps
     InitWindow();
     InitView();
     InitEventHandlers();
 
-	srand(time(0));
+	srand(mSeed);
 	rand();
 }
 
@@ -105,7 +181,8 @@ void Game::InitView(void){
     // Set current view
     mCamera->SetView(camera_position_g, camera_look_at_g, camera_up_g);
     // Set projection
-    mCamera->SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+    mRenderer->SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+    Terrain::setViewVolume(camera_fov_g, (float)width / height, camera_far_clip_distance_g);
 }
 
 
@@ -122,8 +199,12 @@ void Game::InitEventHandlers(void){
 
 void Game::SetupResources(void){
 
-	// Create a plane
-	mResourceManager->CreateGrid("GridMesh");
+	// Create the terrain, a tile of 320 x 320 in cells of 2.5 repeated in every direction
+	Terrain::Generate(128, 128, 2.5f, 3.0f, mSeed);
+	mResourceManager->CreateHeightMap("terrainHeightMap");
+	mResourceManager->CreateTerrainPatch("terrainPatch", TerrainLodNode::PATCH_CELLS);
+	mResourceManager->CreateTerrainPatch("terrainQuarterPatch", TerrainLodNode::PATCH_CELLS / 2);
+	mRenderer->SetTerrain(mResourceManager->getResource("terrainHeightMap")->getResource(), Terrain::getCellSize());
 	// Create a cube for the skybox
 	mResourceManager->CreateCube("cubeMesh");
 	mResourceManager->CreateCylinder("hayMesh");
@@ -134,7 +215,7 @@ void Game::SetupResources(void){
 	mResourceManager->CreateCylinder("energyMesh", 0.6f, 30, glm::vec3(0.0f, 0.7f, 0.7f));
 
 	std::string filename;
-	std::string materials[] = { "default", "textured", "litTexture", "skybox", "particleBeam", "particleShield" };
+	std::string materials[] = { "default", "textured", "litTexture", "skybox", "particleBeam", "particleShield", "terrain" };
 	for (std::string name : materials) {
 		filename = std::string(shader_directory) + std::string("/" + name);
 		mResourceManager->LoadResource(Material, name + "Material", filename.c_str());
@@ -163,6 +244,73 @@ void Game::SetupResources(void){
 		filename = std::string(asset_directory) + std::string("/skyboxes/" + name + "/" +name +".png");
 		mResourceManager->LoadResource(CubeMap, name + "CubeMap", filename.c_str());
 	}
+
+	SetupPrefabs();
+}
+
+
+void Game::SetupPrefabs(void){
+
+	// Named after the ObjectType of the map they are spawned for
+	PrefabDef hay;
+	hay.name = "hay";
+	hay.mesh = "hayMesh";
+	hay.material = "litTextureMaterial";
+	hay.texture = "hayTexture";
+	hay.tags = { "canPickUp", "canCollect" };
+	hay.orientation = glm::angleAxis(glm::half_pi<float>(), glm::vec3(0, 0, 1)); // A bale lies on its side
+	hay.offset = glm::vec3(0.0f, 0.5f, 0.0f);
+	hay.layer = LayerHay;
+	Prefabs::Define<EntityNode>(hay);
+
+	PrefabDef tree;
+	tree.name = "tree";
+	tree.mesh = "treeMesh";
+	tree.material = "litTextureMaterial";
+	tree.texture = "treeTexture";
+	tree.shape = Capsule;
+	Prefabs::Define<SceneNode>(tree);
+
+	PrefabDef barn;
+	barn.name = "barn";
+	barn.mesh = "barnMesh";
+	barn.material = "litTextureMaterial";
+	barn.texture = "barnTexture";
+	barn.shape = OrientedBox;
+	Prefabs::Define<SceneNode>(barn);
+
+	PrefabDef cow;
+	cow.name = "cow";
+	cow.mesh = "cowMesh";
+	cow.material = "texturedMaterial";
+	cow.texture = "cowTexture";
+	cow.layer = LayerCow;
+	Prefabs::Define<CowEntityNode>(cow);
+
+	PrefabDef bull = cow;
+	bull.name = "bull";
+	bull.texture = "bullTexture";
+	bull.layer = LayerBull;
+	Prefabs::Define<BullEntityNode>(bull);
+
+	PrefabDef farmer;
+	farmer.name = "farmer";
+	farmer.mesh = "farmerMesh";
+	farmer.material = "texturedMaterial";
+	farmer.texture = "farmerTexture";
+	farmer.scale = glm::vec3(0.75f, 1.5f, 0.75f);
+	farmer.layer = LayerFarmer;
+	Prefabs::Define<FarmerEntityNode>(farmer);
+
+	PrefabDef cannon;
+	cannon.name = "cannon";
+	cannon.mesh = "cannonMesh";
+	cannon.material = "litTextureMaterial";
+	cannon.texture = "cannonTexture";
+	cannon.scale = glm::vec3(2.0f);
+	cannon.layer = LayerBombable;
+	cannon.shape = AlignedBox;
+	Prefabs::Define<CannonMissileEntityNode>(cannon);
 }
 
 
@@ -171,31 +319,22 @@ void Game::SetupScene(void){
     // Set background color for the scene
     mSceneGraph->SetBackgroundColor(viewport_background_color_g);
 
-	for (int i = 0; i < 40; i++)
-	{
-		CowEntityNode* cow = mSceneGraph->CreateInstance<CowEntityNode>("Cow" + std::to_string(i), "cowMesh", "texturedMaterial", "cowTexture");
-		cow->translate(glm::vec3((rand() % 300), 0.0, (rand() % 300)));
-	}
-
-	for (int i = 0; i < 20; i++)
-	{
-		BullEntityNode* bull = mSceneGraph->CreateInstance<BullEntityNode>("Bull" + std::to_string(i), "cowMesh", "texturedMaterial", "bullTexture");
-		bull->translate(glm::vec3((rand() % 300), 0.0, (rand() % 300)));
-	}
-
-	for (int i = 0; i < 20; i++)
-	{
-		FarmerEntityNode* farmer = mSceneGraph->CreateInstance<FarmerEntityNode>("Farmer" + std::to_string(i), "farmerMesh", "texturedMaterial", "farmerTexture");
-		farmer->scale(glm::vec3(0.75, 1.5, 0.75));
-		farmer->translate(glm::vec3((rand() % 300), 0.0, (rand() % 300)));
-	}
-
-	for (int i = 0; i < 5; i++)
-	{
-		CannonMissileEntityNode* cannon = mSceneGraph->CreateInstance<CannonMissileEntityNode>("Cannon" + std::to_string(i), "cannonMesh", "litTextureMaterial", "cannonTexture");
-		cannon->scale(glm::vec3(2.0, 2.0, 2.0));
-		cannon->translate(glm::vec3((rand() % 300), 0.0, (rand() % 300)));
-	}
+	// Which collision layers interact. The player bumps into everything solid and takes whatever it
+	// collects, the beam lifts anything loose, bombs only hit what can be bombed and missiles stop at anything solid
+	CollisionMatrix& collisions = mSceneGraph->getCollisionMatrix();
+	collisions.set(LayerPlayer, LayerScenery);
+	collisions.set(LayerPlayer, LayerCow);
+	collisions.set(LayerPlayer, LayerBull);
+	collisions.set(LayerPlayer, LayerHay);
+	collisions.set(LayerPlayer, LayerFarmer);
+	collisions.set(LayerPlayer, LayerProjectile);
+	collisions.set(LayerPlayer, LayerBombable);
+	collisions.set(LayerTractorBeam, LayerCow);
+	collisions.set(LayerTractorBeam, LayerBull);
+	collisions.set(LayerTractorBeam, LayerHay);
+	collisions.set(LayerTractorBeam, LayerFarmer);
+	collisions.set(LayerBomb, LayerBombable);
+	collisions.set(LayerProjectile, LayerScenery);
 
 	// stats for the player and ui nodes to hold
 	float* max_stat = new float(100);
@@ -210,6 +349,7 @@ void Game::SetupScene(void){
 	//Create tractor beam
 	SceneNode* weapon = mSceneGraph->CreateInstance<SceneNode>("TRACTORBEAM", "coneParticles", "particleBeamMaterial");
 	mSceneGraph->getRootNode()->removeChildNode("TRACTORBEAM");
+	mSceneGraph->setCollisionLayer(weapon, LayerNone);
 	player->addWeapon(weapon);
 	weapon->translate(glm::vec3(0.0, 0.0, 0.0));
 	weapon->scale(glm::vec3(10.0, 50.0, 10.0));
@@ -220,11 +360,23 @@ void Game::SetupScene(void){
 	//Create shields
 	weapon = mSceneGraph->CreateInstance<SceneNode>("SHIELD", "shieldParticles", "particleShieldMaterial");
 	mSceneGraph->getRootNode()->removeChildNode("SHIELD");
+	mSceneGraph->setCollisionLayer(weapon, LayerNone);
 	player->addWeapon(weapon);
 	weapon->translate(glm::vec3(0.0, 0.0, 0.0));
 	weapon->scale(glm::vec3(10.0, 10.0, 10.0));
 
-	mMapGenerator->GenerateMap();
+	// The map streams in around the camera from here on, see the stream task
+	mMapGenerator->GenerateMap(mCamera->getPosition());
+	if (!mMapFile.empty() && !mMapLoaded) {
+		mMapGenerator->SaveMap(mMapFile, mCamera->getPosition(), map_file_radius_g);
+		LOG_INFO("Saved map %s", mMapFile.c_str());
+	}
+	if (mSnapshot) {
+		mSnapshot->restore(mSceneGraph, *mMapGenerator);
+		LOG_INFO("Restored snapshot %s", mSnapshotFile.c_str());
+		delete mSnapshot;
+		mSnapshot = NULL;
+	}
 
 
 	//Create UI elements
@@ -239,26 +391,32 @@ void Game::SetupScene(void){
 	// Create skybox
 	skybox_ = mSceneGraph->CreateInstance<SceneNode>("skybox", "cubeMesh", "skyboxMaterial", "Day1CubeMap");
 	skybox_->scale(glm::vec3(1000.0, 1000.0, 1000.0));
+	mSceneGraph->setCollisionLayer(skybox_, LayerNone);
 }
 
 
 void Game::MainLoop(void){
 
-    // Loop while the user did not close the window
-    while (!glfwWindowShouldClose(mWindow)){
-        // Animate the scene
-        static double last_time = 0;
-        double current_time = glfwGetTime();
-		double deltaTime = current_time - last_time;
-        if ((current_time - last_time) > 0.05){
-            bool dead = mSceneGraph->update(deltaTime);
-            last_time = current_time;
-			skybox_->setPosition(mCamera->getPosition());
-			if (dead) break;
-        }
+	// Publish the initial scene so the first frame has something to draw
+	RenderSnapshot& first = mSnapshots.backBuffer();
+	mSceneGraph->extract(first, WorkerPool::Shared());
+	first.tick = 0;
+	first.time = glfwGetTime();
+	mSnapshots.publish();
+
+	// From here on the scene belongs to the simulation thread; this thread only draws and handles window events
+	mRunning = true;
+	mSimulationThread = std::thread(&Game::SimulationThread, this);
+
+    // Loop while the user did not close the window and the player is still alive
+    while (!glfwWindowShouldClose(mWindow) && mRunning){
+		// Pick up the newest snapshot if the simulation published one
+		if (mSnapshots.update()) {
+			mRenderer->Submit(mSnapshots.frontBuffer());
+		}
 
         // draw the scene
-        mSceneGraph->draw(mCamera);
+        mRenderer->Draw(glfwGetTime());
 
         // Push buffer drawn in the background onto the display
         glfwSwapBuffers(mWindow);
@@ -267,6 +425,145 @@ void Game::MainLoop(void){
         glfwPollEvents();
 
     }
+
+	mRunning = false;
+	mSimulationThread.join();
+	if (mSimulationError) {
+		std::rethrow_exception(mSimulationError);
+	}
+}
+
+
+void Game::SimulationThread(void){
+
+	// An error on this thread stops the game; MainLoop hands it on once the thread has finished
+	try {
+		SimulationLoop();
+	}
+	catch (std::exception& e) {
+		LOG_ERROR("Simulation stopped: %s", e.what());
+		mSimulationError = std::current_exception();
+		mRunning = false;
+	}
+}
+
+
+void Game::SetupFrameGraph(void){
+
+	// Phases that only queue scene changes read ResCommands, since queueing is thread safe; the commit writes it
+	mFrameGraph.addTask("input", ResInput | ResCommands, ResInput | ResCamera | ResPlayer, [this]() {
+		KeyEvent event;
+		while (mKeyEvents.tryPop(event)) {
+			HandleKey(event.key, event.action);
+		}
+	});
+
+	// Node updates run behaviour and movement together. Spawns and deletes are queued for the commit
+	// Behaviours cast rays into the grid, which the rebin after it changes
+	mFrameGraph.addTask("update", ResInput | ResHierarchy | ResGrid | ResCommands, ResCamera | ResPlayer | ResBehaviour | ResTransforms, [this]() {
+		mPlayerDead = mSceneGraph->updateNodes(mTickDelta);
+	});
+
+	mFrameGraph.addTask("rebin", ResTransforms, ResGrid, [this]() {
+		mSceneGraph->rebinGrid();
+	});
+
+	mFrameGraph.addTask("collision", ResGrid | ResHierarchy | ResCommands, ResCamera | ResPlayer | ResTransforms, [this]() {
+		mSceneGraph->resolveCollisions();
+	});
+
+	// Spawn and unload map chunks around the camera. What it creates and deletes goes through the commit, so the
+	// new nodes are its own until then; it only shares the entity tables they register in. It goes by where the
+	// camera was when the tick started, which lets it run alongside collision
+	mFrameGraph.addTask("stream", ResGrid | ResHierarchy | ResCommands, ResBehaviour, [this]() {
+		mMapGenerator->update(mStreamCenter);
+	});
+
+	// Apply everything queued above in one sorted batch, so nothing iterating the scene sees it change
+	// Deleted entities leave the entity tables here
+	mFrameGraph.addTask("commit", ResTransforms, ResCommands | ResHierarchy | ResGrid | ResBehaviour, [this]() {
+		mSceneGraph->commitChanges();
+	});
+
+	mFrameGraph.addTask("skybox", ResCamera, ResSkybox, [this]() {
+		skybox_->setPosition(mCamera->getPosition());
+	});
+
+	// Extraction also turns ground entity headings into orientations
+	mFrameGraph.addTask("extract", ResCamera | ResPlayer | ResHierarchy | ResSkybox | ResBehaviour, ResTransforms | ResRenderList, [this]() {
+		mSceneGraph->extract(mSnapshots.backBuffer(), WorkerPool::Shared());
+	});
+
+	mFrameGraph.compile();
+}
+
+
+void Game::SimulationLoop(void){
+
+	uint64_t tick = 0;
+	double last_time = glfwGetTime();
+	SetupFrameGraph();
+	SceneGraph::setDeferChanges(true);
+
+	while (mRunning){
+		double current_time = glfwGetTime();
+		double deltaTime = current_time - last_time;
+		if (deltaTime < sim_tick_g){
+			// Wait for the next tick
+			std::this_thread::sleep_for(std::chrono::duration<double>(sim_tick_g - deltaTime));
+			continue;
+		}
+		last_time = current_time;
+
+		// Run all phases of the tick: input, animation, collision and snapshot extraction
+		mTickDelta = deltaTime;
+		mStreamCenter = mCamera->getPosition();
+		mFrameGraph.run(WorkerPool::Shared());
+
+		// Publish the result for the renderer
+		RenderSnapshot& snapshot = mSnapshots.backBuffer();
+		snapshot.tick = ++tick;
+		snapshot.time = current_time;
+		mSnapshots.publish();
+
+		// Profiling
+		if (tick % profile_log_ticks_g == 0) {
+			LOG_DEBUG("frame phases: %s", mFrameGraph.summary().c_str());
+		}
+		if (mDumpFrameGraph) {
+			std::ofstream out(frame_graph_file_g);
+			mFrameGraph.writeDot(out);
+			LOG_INFO("Frame graph written to %s", frame_graph_file_g.c_str());
+			mDumpFrameGraph = false;
+		}
+
+		// Between ticks nothing else is touching the scene. What a load changes is committed by the next tick
+		if (mSaveSnapshot || mLoadSnapshot) {
+			try {
+				if (mSaveSnapshot) {
+					WorldSnapshot::Save(quicksave_file_g, mSceneGraph, *mMapGenerator, mSeed, snapshot_compress_g);
+					LOG_INFO("Saved snapshot %s", quicksave_file_g.c_str());
+				}
+				else {
+					WorldSnapshot snapshot;
+					if (snapshot.open(quicksave_file_g)) {
+						snapshot.restore(mSceneGraph, *mMapGenerator);
+						LOG_INFO("Restored snapshot %s", quicksave_file_g.c_str());
+					}
+					else {
+						LOG_WARNING("No snapshot %s to restore", quicksave_file_g.c_str());
+					}
+				}
+			}
+			catch (GameException& e) {
+				LOG_ERROR("%s", e.what());
+			}
+			mSaveSnapshot = false;
+			mLoadSnapshot = false;
+		}
+
+		if (mPlayerDead) mRunning = false;
+	}
 }
 
 
@@ -276,51 +573,61 @@ void Game::KeyCallback(GLFWwindow* window, int key, int scancode, int action, in
     void* ptr = glfwGetWindowUserPointer(window);
     Game *game = (Game *) ptr;
 
-	PlayerNode *playerNode = (PlayerNode*)game->mSceneGraph->getPlayerNode();
+	// The scene is owned by the simulation thread, so only queue the event here
+	KeyEvent event;
+	event.key = key;
+	event.action = action;
+	game->mKeyEvents.tryPush(event);
+}
+
+
+void Game::HandleKey(int key, int action){
+
+	PlayerNode *playerNode = (PlayerNode*)mSceneGraph->getPlayerNode();
 
     // View control
     float rotFactor(glm::pi<float>() * 1  / 180);
     float transFactor = 3.0;
 	float velocityFactor = 0.2f;
     if (key == GLFW_KEY_UP){
-        game->mCamera->Pitch(rotFactor);
+        mCamera->Pitch(rotFactor);
     }
     if (key == GLFW_KEY_DOWN){
-        game->mCamera->Pitch(-rotFactor);
+        mCamera->Pitch(-rotFactor);
     }
     if (key == GLFW_KEY_Q){
-		game->mCamera->Yaw(rotFactor);
+		mCamera->Yaw(rotFactor);
     }
     if (key == GLFW_KEY_E){
-		game->mCamera->Yaw(-rotFactor);
+		mCamera->Yaw(-rotFactor);
     }
     if (key == GLFW_KEY_W){
-		//game->mCamera->setVelocityForward(game->mCamera->getVelocityForward() + velocityFactor);
-		game->mCamera->addVelocity(glm::vec3(0, 0, velocityFactor));
+		//mCamera->setVelocityForward(mCamera->getVelocityForward() + velocityFactor);
+		mCamera->addVelocity(glm::vec3(0, 0, velocityFactor));
     }
     if (key == GLFW_KEY_S){
-		//game->mCamera->setVelocityForward(game->mCamera->getVelocityForward() - velocityFactor);
-		game->mCamera->addVelocity(glm::vec3(0, 0, -velocityFactor));
+		//mCamera->setVelocityForward(mCamera->getVelocityForward() - velocityFactor);
+		mCamera->addVelocity(glm::vec3(0, 0, -velocityFactor));
 
     }
 	if (key == GLFW_KEY_A) {
-		//game->mCamera->setVelocitySide(game->mCamera->getVelocitySide() - velocityFactor / 2);
-		game->mCamera->addVelocity(glm::vec3(-velocityFactor/2, 0, 0));
+		//mCamera->setVelocitySide(mCamera->getVelocitySide() - velocityFactor / 2);
+		mCamera->addVelocity(glm::vec3(-velocityFactor/2, 0, 0));
 
 	}
 	if (key == GLFW_KEY_D) {
-		//game->mCamera->setVelocitySide(game->mCamera->getVelocitySide() + velocityFactor / 2);
-		game->mCamera->addVelocity(glm::vec3(velocityFactor / 2, 0, 0));
+		//mCamera->setVelocitySide(mCamera->getVelocitySide() + velocityFactor / 2);
+		mCamera->addVelocity(glm::vec3(velocityFactor / 2, 0, 0));
 
 	}
 	if (key == GLFW_KEY_LEFT_SHIFT) {
-		//game->mCamera->setVelocityUp(game->mCamera->getVelocityUp() + velocityFactor / 5);
-		game->mCamera->addVelocity(glm::vec3(0, velocityFactor / 5, 0));
+		//mCamera->setVelocityUp(mCamera->getVelocityUp() + velocityFactor / 5);
+		mCamera->addVelocity(glm::vec3(0, velocityFactor / 5, 0));
 
 	}
 	if (key == GLFW_KEY_LEFT_CONTROL) {
-		//game->mCamera->setVelocityUp(game->mCamera->getVelocityUp() - velocityFactor / 5);
-		game->mCamera->addVelocity(glm::vec3(0, -velocityFactor / 5, 0));
+		//mCamera->setVelocityUp(mCamera->getVelocityUp() - velocityFactor / 5);
+		mCamera->addVelocity(glm::vec3(0, -velocityFactor / 5, 0));
 
 	}
 	if (key == GLFW_KEY_SPACE) {
@@ -333,7 +640,7 @@ void Game::KeyCallback(GLFWwindow* window, int key, int scancode, int action, in
 		if (action == GLFW_RELEASE) playerNode->toggleShields(false);
 	}
 	if (key == GLFW_KEY_TAB && action == GLFW_PRESS) {
-		game->mCamera->SwitchCameraPerspective();
+		mCamera->SwitchCameraPerspective();
 	}
 	if (key == GLFW_KEY_Y) {
 		playerNode->rotateForward();
@@ -342,11 +649,20 @@ void Game::KeyCallback(GLFWwindow* window, int key, int scancode, int action, in
 		playerNode->rotateBackward();
 	}
 	if (key == GLFW_KEY_F) {
-		game->mCamera->setVelocity(glm::vec3(0));
+		mCamera->setVelocity(glm::vec3(0));
 	}
 	if (key == GLFW_KEY_R) {
 		playerNode->dropBomb();
 	}
+	if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+		mDumpFrameGraph = true;
+	}
+	if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+		mSaveSnapshot = true;
+	}
+	if (key == GLFW_KEY_F6 && action == GLFW_PRESS) {
+		mLoadSnapshot = true;
+	}
 
 }
 
@@ -357,13 +673,18 @@ void Game::ResizeCallback(GLFWwindow* window, int width, int height){
     glViewport(0, 0, width, height);
     void* ptr = glfwGetWindowUserPointer(window);
     Game *game = (Game *) ptr;
-    game->mCamera->SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+    game->mRenderer->SetProjection(camera_fov_g, camera_near_clip_distance_g, camera_far_clip_distance_g, width, height);
+    if (height > 0) Terrain::setViewVolume(camera_fov_g, (float)width / height, camera_far_clip_distance_g);
 }
 
 
 Game::~Game(){
 
+	delete mSnapshot;
+	delete mMapGenerator;
+
     glfwTerminate();
+	Logger::Shutdown();
 }
 
 } // namespace game
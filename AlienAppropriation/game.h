@@ -3,6 +3,8 @@
 
 #include <exception>
 #include <string>
+#include <thread>
+#include <atomic>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -15,6 +17,12 @@
 #include "player_node.h"
 #include "ui_node.h"
 #include "map_generator.h"
+#include "world_snapshot.h"
+#include "renderer.h"
+#include "render_snapshot.h"
+#include "triple_buffer.h"
+#include "ring_buffer.h"
+#include "task_graph.h"
 
 namespace game {
     // Game application
@@ -24,6 +32,12 @@ namespace game {
             // Constructor and destructor
             Game(void);
             ~Game();
+			// Options, set before Init(). A run with a given seed makes the same world every time. With a map
+			// file the map is loaded from it, or generated and saved to it if it does not exist yet
+			void setSeed(unsigned int seed);
+			void setMapFile(const std::string& path);
+			// Start from a snapshot saved with F5 instead of a fresh world. Its seed replaces any other
+			void setSnapshotFile(const std::string& path);
 			// Call Init() before calling any other method
             void Init(void);
             // Set up resources for the game
@@ -34,6 +48,12 @@ namespace game {
             void MainLoop(void);
 
         private:
+            // A key event, queued by the window thread for the simulation thread
+            struct KeyEvent {
+                int key;
+                int action;
+            };
+
             // GLFW window
             GLFWwindow* mWindow;
 
@@ -44,16 +64,52 @@ namespace game {
             ResourceManager* mResourceManager;
 
 			MapGenerator* mMapGenerator;
+			unsigned int mSeed;
+			bool mHasSeed;
+			std::string mMapFile;
+			bool mMapLoaded;
+			std::string mSnapshotFile;
+			WorldSnapshot* mSnapshot; // Opened by Init, restored by SetupScene
 
             // Camera abstraction
             Camera* mCamera;
 
 			SceneNode *skybox_;
 
+			// Draws the snapshots published by the simulation thread
+			Renderer* mRenderer;
+			TripleBuffer<RenderSnapshot> mSnapshots;
+
+			// Simulation thread and the input it has not consumed yet
+			std::thread mSimulationThread;
+			std::atomic<bool> mRunning;
+			std::exception_ptr mSimulationError; // Rethrown by MainLoop after the join
+			RingBuffer<KeyEvent, 256> mKeyEvents;
+
+			// Phases of one simulation tick
+			TaskGraph mFrameGraph;
+			double mTickDelta;
+			glm::vec3 mStreamCenter; // Camera position at the start of the tick, for the stream phase
+			bool mPlayerDead;
+			bool mDumpFrameGraph;
+			bool mSaveSnapshot; // Quick save and load, done between ticks
+			bool mLoadSnapshot;
+
             // Methods to initialize the game
             void InitWindow(void);
             void InitView(void);
             void InitEventHandlers(void);
+            // Compile a prefab for everything the map spawns, once the resources are loaded
+            void SetupPrefabs(void);
+
+            // Simulation thread: runs SimulationLoop and keeps the error that stopped it, if any
+            void SimulationThread(void);
+            // Updates the scene at a fixed rate and publishes render snapshots
+            void SimulationLoop(void);
+            // Declare the phases of a tick and what each of them touches
+            void SetupFrameGraph(void);
+            // Apply a key event to the scene, on the simulation thread
+            void HandleKey(int key, int action);
 
             // Methods to handle events
             static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -0,0 +1,120 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEADINGS_SSE
+#endif
+
+#include "heading_table.h"
+#include "entity_node.h"
+
+namespace game {
+
+std::vector<EntityNode*> HeadingTable::mNodes;
+std::vector<float> HeadingTable::mHeadings;
+std::vector<float> HeadingTable::mRotW;
+std::vector<float> HeadingTable::mRotY;
+
+// Range reduction: x = k * pi + r with |r| <= pi / 2, pi split in two so k * pi stays exact
+static const float INV_PI = 0.318309886183790671f;
+static const float PI_HI = 3.140625f;
+static const float PI_LO = 9.67653589793e-4f;
+
+// Taylor coefficients, accurate to about 1e-7 on [-pi/2, pi/2]
+static const float S3 = -1.0f / 6.0f, S5 = 1.0f / 120.0f, S7 = -1.0f / 5040.0f, S9 = 1.0f / 362880.0f, S11 = -1.0f / 39916800.0f;
+static const float C2 = -1.0f / 2.0f, C4 = 1.0f / 24.0f, C6 = -1.0f / 720.0f, C8 = 1.0f / 40320.0f, C10 = -1.0f / 3628800.0f, C12 = 1.0f / 479001600.0f;
+
+
+static void HalfAngleScalar(float heading, float& w, float& y)
+{
+	float half = heading * 0.5f;
+	float k = (float)(int)(half * INV_PI + (half >= 0.0f ? 0.5f : -0.5f));
+	float r = (half - k * PI_HI) - k * PI_LO;
+	float r2 = r * r;
+
+	float s = r + r * r2 * (S3 + r2 * (S5 + r2 * (S7 + r2 * (S9 + r2 * S11))));
+	float c = 1.0f + r2 * (C2 + r2 * (C4 + r2 * (C6 + r2 * (C8 + r2 * (C10 + r2 * C12)))));
+
+	// sin and cos change sign every pi
+	float sign = ((int)k & 1) ? -1.0f : 1.0f;
+	w = c * sign;
+	y = s * sign;
+}
+
+
+void HeadingsToQuaternions(const float* headings, size_t count, float* outW, float* outY)
+{
+	size_t i = 0;
+
+#if defined(HEADINGS_SSE)
+	const __m128 halfV = _mm_set1_ps(0.5f);
+	const __m128 invPi = _mm_set1_ps(INV_PI);
+	const __m128 piHi = _mm_set1_ps(PI_HI);
+	const __m128 piLo = _mm_set1_ps(PI_LO);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 half = _mm_mul_ps(_mm_loadu_ps(headings + i), halfV);
+		__m128i ki = _mm_cvtps_epi32(_mm_mul_ps(half, invPi)); // Round to nearest
+		__m128 k = _mm_cvtepi32_ps(ki);
+		__m128 r = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(k, piHi)), _mm_mul_ps(k, piLo));
+		__m128 r2 = _mm_mul_ps(r, r);
+
+		__m128 s = _mm_add_ps(_mm_set1_ps(S9), _mm_mul_ps(r2, _mm_set1_ps(S11)));
+		s = _mm_add_ps(_mm_set1_ps(S7), _mm_mul_ps(r2, s));
+		s = _mm_add_ps(_mm_set1_ps(S5), _mm_mul_ps(r2, s));
+		s = _mm_add_ps(_mm_set1_ps(S3), _mm_mul_ps(r2, s));
+		s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+
+		__m128 c = _mm_add_ps(_mm_set1_ps(C10), _mm_mul_ps(r2, _mm_set1_ps(C12)));
+		c = _mm_add_ps(_mm_set1_ps(C8), _mm_mul_ps(r2, c));
+		c = _mm_add_ps(_mm_set1_ps(C6), _mm_mul_ps(r2, c));
+		c = _mm_add_ps(_mm_set1_ps(C4), _mm_mul_ps(r2, c));
+		c = _mm_add_ps(_mm_set1_ps(C2), _mm_mul_ps(r2, c));
+		c = _mm_add_ps(one, _mm_mul_ps(r2, c));
+
+		// Odd k flips both signs: move its low bit into the float sign bit
+		__m128 sign = _mm_castsi128_ps(_mm_slli_epi32(ki, 31));
+		_mm_storeu_ps(outW + i, _mm_xor_ps(c, sign));
+		_mm_storeu_ps(outY + i, _mm_xor_ps(s, sign));
+	}
+#endif
+
+	for (; i < count; i++) {
+		HalfAngleScalar(headings[i], outW[i], outY[i]);
+	}
+}
+
+
+uint32_t HeadingTable::Register(EntityNode* node, float heading)
+{
+	mNodes.push_back(node);
+	mHeadings.push_back(heading);
+	mRotW.push_back(1.0f);
+	mRotY.push_back(0.0f);
+	return (uint32_t)mNodes.size() - 1;
+}
+
+
+void HeadingTable::Unregister(uint32_t slot)
+{
+	size_t last = mNodes.size() - 1;
+	mNodes[slot] = mNodes[last];
+	mNodes[slot]->mHeadingSlot = slot;
+	mHeadings[slot] = mHeadings[last];
+
+	mNodes.pop_back();
+	mHeadings.pop_back();
+	mRotW.pop_back();
+	mRotY.pop_back();
+}
+
+
+void HeadingTable::apply(void)
+{
+	HeadingsToQuaternions(mHeadings.data(), mHeadings.size(), mRotW.data(), mRotY.data());
+
+	for (size_t i = 0; i < mNodes.size(); i++) {
+		mNodes[i]->mOrientation = glm::quat(mRotW[i], 0.0f, mRotY[i], 0.0f);
+	}
+}
+
+} // namespace game
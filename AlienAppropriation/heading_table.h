@@ -0,0 +1,44 @@
+#ifndef HEADING_TABLE_H_
+#define HEADING_TABLE_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace game {
+
+	class EntityNode;
+
+	// Yaw quaternions (w, 0, y, 0) for count headings, in radians about +Y with 0 facing +Z
+	// sin and cos of the half angles come from a polynomial, four at a time with SSE
+	void HeadingsToQuaternions(const float* headings, size_t count, float* outW, float* outY);
+
+	// class HeadingTable
+	// Orientation of entities that only ever turn about the vertical axis
+	// Behaviours just store an angle each tick; the angles are turned into orientations in one pass
+	// when the scene is extracted for rendering, which is the only time they are needed
+	class HeadingTable {
+
+	public:
+		static const uint32_t NO_SLOT = 0xffffffff;
+
+		// Returns the entity's slot. Slots move when other entities unregister
+		static uint32_t Register(EntityNode* node, float heading);
+		static void Unregister(uint32_t slot);
+
+		inline static void setHeading(uint32_t slot, float heading) { mHeadings[slot] = heading; }
+		inline static float getHeading(uint32_t slot) { return mHeadings[slot]; }
+
+		// Write the orientation of every registered entity. Simulation thread only
+		static void apply(void);
+
+	private:
+		static std::vector<EntityNode*> mNodes;
+		static std::vector<float> mHeadings;
+		static std::vector<float> mRotW, mRotY;
+
+	}; // class HeadingTable
+
+} // namespace game
+
+#endif // HEADING_TABLE_H_
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <float.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KINEMATICS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KINEMATICS_SSE
+#endif
+
+#include "kinematics.h"
+#include "entity_node.h"
+#include "terrain.h"
+
+namespace game {
+
+std::vector<EntityNode*> KinematicsSystem::mNodes;
+std::vector<float> KinematicsSystem::mPosX;
+std::vector<float> KinematicsSystem::mPosY;
+std::vector<float> KinematicsSystem::mPosZ;
+std::vector<float> KinematicsSystem::mVelX;
+std::vector<float> KinematicsSystem::mVelY;
+std::vector<float> KinematicsSystem::mVelZ;
+std::vector<float> KinematicsSystem::mGrounded;
+std::vector<float> KinematicsSystem::mLanded;
+std::vector<float> KinematicsSystem::mFollow;
+std::vector<float> KinematicsSystem::mGroundX;
+std::vector<float> KinematicsSystem::mGroundZ;
+std::vector<float> KinematicsSystem::mGround;
+
+
+// Reference version of the kernel, also used for whatever does not fill a whole vector
+static void IntegrateScalar(const KinematicsBatch& b, size_t first, size_t last, float gravity, float boundsMin, float boundsMax)
+{
+	for (size_t i = first; i < last; i++) {
+		b.landed[i] = 0.0f;
+		if (b.grounded[i] == 0.0f) {
+			if (b.posY[i] > b.ground[i]) {
+				b.velY[i] += gravity;
+				b.velX[i] = 0.0f;
+				b.velZ[i] = 0.0f;
+			}
+			else {
+				b.velY[i] = 0.0f;
+				b.posY[i] = b.ground[i];
+				b.grounded[i] = 1.0f;
+				b.landed[i] = 1.0f;
+			}
+		}
+		else {
+			b.velY[i] = std::max(b.velY[i], 0.0f);
+			if (b.follow[i] != 0.0f) b.posY[i] = b.ground[i];
+		}
+
+		b.posX[i] = std::min(std::max(b.posX[i] + b.velX[i], boundsMin), boundsMax);
+		b.posY[i] = std::min(std::max(b.posY[i] + b.velY[i], boundsMin), boundsMax);
+		b.posZ[i] = std::min(std::max(b.posZ[i] + b.velZ[i], boundsMin), boundsMax);
+	}
+}
+
+
+void IntegrateKinematics(const KinematicsBatch& b, size_t count, float gravity, float boundsMin, float boundsMax)
+{
+	size_t i = 0;
+
+#if defined(KINEMATICS_AVX2)
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 g = _mm256_set1_ps(gravity);
+	const __m256 lo = _mm256_set1_ps(boundsMin);
+	const __m256 hi = _mm256_set1_ps(boundsMax);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(b.posX + i), py = _mm256_loadu_ps(b.posY + i), pz = _mm256_loadu_ps(b.posZ + i);
+		__m256 vx = _mm256_loadu_ps(b.velX + i), vy = _mm256_loadu_ps(b.velY + i), vz = _mm256_loadu_ps(b.velZ + i);
+		__m256 grounded = _mm256_cmp_ps(_mm256_loadu_ps(b.grounded + i), zero, _CMP_NEQ_OQ);
+		__m256 ground = _mm256_loadu_ps(b.ground + i);
+		__m256 follow = _mm256_cmp_ps(_mm256_loadu_ps(b.follow + i), zero, _CMP_NEQ_OQ);
+
+		__m256 above = _mm256_cmp_ps(py, ground, _CMP_GT_OQ);
+		__m256 fall = _mm256_andnot_ps(grounded, above);
+		__m256 land = _mm256_andnot_ps(grounded, _mm256_cmp_ps(py, ground, _CMP_NGT_UQ));
+
+		vy = _mm256_blendv_ps(vy, _mm256_max_ps(vy, zero), grounded);
+		vy = _mm256_blendv_ps(vy, _mm256_add_ps(vy, g), fall);
+		vy = _mm256_andnot_ps(land, vy);
+		vx = _mm256_andnot_ps(fall, vx);
+		vz = _mm256_andnot_ps(fall, vz);
+		py = _mm256_blendv_ps(py, ground, _mm256_or_ps(_mm256_and_ps(grounded, follow), land));
+
+		_mm256_storeu_ps(b.posX + i, _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(px, vx), lo), hi));
+		_mm256_storeu_ps(b.posY + i, _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(py, vy), lo), hi));
+		_mm256_storeu_ps(b.posZ + i, _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(pz, vz), lo), hi));
+		_mm256_storeu_ps(b.velX + i, vx);
+		_mm256_storeu_ps(b.velY + i, vy);
+		_mm256_storeu_ps(b.velZ + i, vz);
+		_mm256_storeu_ps(b.grounded + i, _mm256_and_ps(_mm256_or_ps(grounded, land), one));
+		_mm256_storeu_ps(b.landed + i, _mm256_and_ps(land, one));
+	}
+#elif defined(KINEMATICS_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 g = _mm_set1_ps(gravity);
+	const __m128 lo = _mm_set1_ps(boundsMin);
+	const __m128 hi = _mm_set1_ps(boundsMax);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(b.posX + i), py = _mm_loadu_ps(b.posY + i), pz = _mm_loadu_ps(b.posZ + i);
+		__m128 vx = _mm_loadu_ps(b.velX + i), vy = _mm_loadu_ps(b.velY + i), vz = _mm_loadu_ps(b.velZ + i);
+		__m128 grounded = _mm_cmpneq_ps(_mm_loadu_ps(b.grounded + i), zero);
+		__m128 ground = _mm_loadu_ps(b.ground + i);
+		__m128 follow = _mm_cmpneq_ps(_mm_loadu_ps(b.follow + i), zero);
+
+		__m128 above = _mm_cmpgt_ps(py, ground);
+		__m128 fall = _mm_andnot_ps(grounded, above);
+		__m128 land = _mm_andnot_ps(grounded, _mm_cmpngt_ps(py, ground));
+
+		// No blend in SSE2: select with and/andnot/or
+		vy = _mm_or_ps(_mm_and_ps(grounded, _mm_max_ps(vy, zero)), _mm_andnot_ps(grounded, vy));
+		vy = _mm_or_ps(_mm_and_ps(fall, _mm_add_ps(vy, g)), _mm_andnot_ps(fall, vy));
+		vy = _mm_andnot_ps(land, vy);
+		vx = _mm_andnot_ps(fall, vx);
+		vz = _mm_andnot_ps(fall, vz);
+		__m128 onGround = _mm_or_ps(_mm_and_ps(grounded, follow), land);
+		py = _mm_or_ps(_mm_and_ps(onGround, ground), _mm_andnot_ps(onGround, py));
+
+		_mm_storeu_ps(b.posX + i, _mm_min_ps(_mm_max_ps(_mm_add_ps(px, vx), lo), hi));
+		_mm_storeu_ps(b.posY + i, _mm_min_ps(_mm_max_ps(_mm_add_ps(py, vy), lo), hi));
+		_mm_storeu_ps(b.posZ + i, _mm_min_ps(_mm_max_ps(_mm_add_ps(pz, vz), lo), hi));
+		_mm_storeu_ps(b.velX + i, vx);
+		_mm_storeu_ps(b.velY + i, vy);
+		_mm_storeu_ps(b.velZ + i, vz);
+		_mm_storeu_ps(b.grounded + i, _mm_and_ps(_mm_or_ps(grounded, land), one));
+		_mm_storeu_ps(b.landed + i, _mm_and_ps(land, one));
+	}
+#endif
+
+	IntegrateScalar(b, i, count, gravity, boundsMin, boundsMax);
+}
+
+
+uint32_t KinematicsSystem::Register(EntityNode* node)
+{
+	mNodes.push_back(node);
+	mPosX.push_back(0.0f); mPosY.push_back(0.0f); mPosZ.push_back(0.0f);
+	mVelX.push_back(0.0f); mVelY.push_back(0.0f); mVelZ.push_back(0.0f);
+	mGrounded.push_back(0.0f);
+	mLanded.push_back(0.0f);
+	mFollow.push_back(0.0f);
+	mGroundX.push_back(0.0f); mGroundZ.push_back(0.0f); mGround.push_back(0.0f);
+	return (uint32_t)mNodes.size() - 1;
+}
+
+
+void KinematicsSystem::Unregister(uint32_t slot)
+{
+	// Swap the last entity into the hole; only the node array matters, the rest is refilled every tick
+	EntityNode* last = mNodes.back();
+	mNodes[slot] = last;
+	last->mKinematicSlot = slot;
+
+	mNodes.pop_back();
+	mPosX.pop_back(); mPosY.pop_back(); mPosZ.pop_back();
+	mVelX.pop_back(); mVelY.pop_back(); mVelZ.pop_back();
+	mGrounded.pop_back();
+	mLanded.pop_back();
+	mFollow.pop_back();
+	mGroundX.pop_back(); mGroundZ.pop_back(); mGround.pop_back();
+}
+
+
+void KinematicsSystem::integrate(void)
+{
+	size_t count = mNodes.size();
+
+	for (size_t i = 0; i < count; i++) {
+		EntityNode* node = mNodes[i];
+		mPosX[i] = node->mPosition.x; mPosY[i] = node->mPosition.y; mPosZ[i] = node->mPosition.z;
+		mVelX[i] = node->mVelocity.x; mVelY[i] = node->mVelocity.y; mVelZ[i] = node->mVelocity.z;
+		mGrounded[i] = node->mIsGrounded ? 1.0f : 0.0f;
+		mFollow[i] = node->mFollowsTerrain ? 1.0f : 0.0f;
+
+		// Grounded walkers follow the terrain, so sample it where they are about to be
+		bool walking = node->mIsGrounded && node->mFollowsTerrain;
+		mGroundX[i] = walking ? mPosX[i] + mVelX[i] : mPosX[i];
+		mGroundZ[i] = walking ? mPosZ[i] + mVelZ[i] : mPosZ[i];
+	}
+	Terrain::getHeights(mGroundX.data(), mGroundZ.data(), mGround.data(), count);
+
+	KinematicsBatch batch;
+	batch.posX = mPosX.data(); batch.posY = mPosY.data(); batch.posZ = mPosZ.data();
+	batch.velX = mVelX.data(); batch.velY = mVelY.data(); batch.velZ = mVelZ.data();
+	batch.grounded = mGrounded.data();
+	batch.ground = mGround.data();
+	batch.landed = mLanded.data();
+	batch.follow = mFollow.data();
+	IntegrateKinematics(batch, count, GRAVITY.y, -FLT_MAX, FLT_MAX); // The world has no edge; entities that wander out of the streamed area are unloaded with it
+
+	for (size_t i = 0; i < count; i++) {
+		EntityNode* node = mNodes[i];
+		node->mPosition = glm::vec3(mPosX[i], mPosY[i], mPosZ[i]);
+		node->mVelocity = glm::vec3(mVelX[i], mVelY[i], mVelZ[i]);
+		node->mIsGrounded = mGrounded[i] != 0.0f;
+	}
+
+	// Callbacks only queue scene changes, so the arrays cannot change under us
+	for (size_t i = 0; i < count; i++) {
+		if (mLanded[i] != 0.0f) mNodes[i]->hitGround();
+	}
+}
+
+} // namespace game
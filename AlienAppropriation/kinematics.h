@@ -0,0 +1,64 @@
+#ifndef KINEMATICS_H_
+#define KINEMATICS_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace game {
+
+	class EntityNode;
+
+	// Packed arrays the integration kernel works on, one entry per entity
+	// grounded and landed are 1.0f or 0.0f so the kernel can use them as lane masks
+	struct KinematicsBatch {
+		float* posX;
+		float* posY;
+		float* posZ;
+		float* velX;
+		float* velY;
+		float* velZ;
+		float* grounded;
+		const float* ground; // Terrain height under each entity, see KinematicsSystem::integrate
+		float* landed; // Output: set for entities that touched the ground this tick
+		const float* follow; // Set for entities that walk on the terrain, see EntityNode::followTerrain
+	};
+
+	// One movement step for count entities
+	// Airborne entities above the ground fall (their horizontal velocity is dropped), airborne entities at or
+	// below it land on it; grounded entities cannot move down, and those that follow the terrain are put on it
+	// wherever they go. Then position += velocity, clamped to [boundsMin, boundsMax]
+	// Uses AVX2 or SSE when the build enables them, with a scalar loop for the tail
+	void IntegrateKinematics(const KinematicsBatch& batch, size_t count, float gravity, float boundsMin, float boundsMax);
+
+	// class KinematicsSystem
+	// Moves every EntityNode in one pass per tick instead of one virtual update at a time
+	// Entities register when created and unregister when deleted. Each tick their position, velocity
+	// and grounded flag are gathered into packed arrays, integrated in bulk, and written back.
+	// Entities that landed get their hitGround callback afterwards, in slot order
+	class KinematicsSystem {
+
+	public:
+		static const uint32_t NO_SLOT = 0xffffffff;
+
+		// Returns the entity's slot. Slots move when other entities unregister
+		static uint32_t Register(EntityNode* node);
+		static void Unregister(uint32_t slot);
+
+		// Simulation thread only
+		static void integrate(void);
+
+		inline static size_t getCount(void) { return mNodes.size(); }
+
+	private:
+		static std::vector<EntityNode*> mNodes;
+		static std::vector<float> mPosX, mPosY, mPosZ;
+		static std::vector<float> mVelX, mVelY, mVelZ;
+		static std::vector<float> mGrounded, mLanded, mFollow;
+		static std::vector<float> mGroundX, mGroundZ, mGround; // Where the terrain is sampled, and its height there
+
+	}; // class KinematicsSystem
+
+} // namespace game
+
+#endif // KINEMATICS_H_
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <chrono>
+
+#include "logger.h"
+
+namespace game {
+
+RingBuffer<Logger::Record, Logger::kQueueSize> Logger::mQueue;
+std::atomic<bool> Logger::mRunning(false);
+std::atomic<uint32_t> Logger::mDropped(0);
+std::thread Logger::mWriter;
+
+// Time since the logger was first used, in seconds
+static double LogClock(void)
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+bool LogRateLimiter::allow(int64_t nowMs, uint32_t& suppressed)
+{
+	// Start a new one second window if the current one ran out
+	int64_t window = mWindow.load(std::memory_order_relaxed);
+	if (nowMs - window >= 1000) {
+		if (mWindow.compare_exchange_strong(window, nowMs, std::memory_order_relaxed)) {
+			mCount.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	if (mCount.fetch_add(1, std::memory_order_relaxed) < mLimit) {
+		suppressed = mSuppressed.exchange(0, std::memory_order_relaxed);
+		return true;
+	}
+
+	mSuppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+
+void Logger::Init(void)
+{
+	bool expected = false;
+	if (!mRunning.compare_exchange_strong(expected, true)) return;
+
+	LogClock();
+	mWriter = std::thread(WriterLoop);
+}
+
+
+void Logger::Shutdown(void)
+{
+	if (mRunning.exchange(false) && mWriter.joinable()) {
+		mWriter.join();
+	}
+
+	// Whatever is left gets written by the calling thread
+	Drain();
+	fflush(stdout);
+	fflush(stderr);
+}
+
+
+void Logger::log(LogLevel level, LogRateLimiter& limiter, const char* format, ...)
+{
+	double now = LogClock();
+
+	uint32_t suppressed = 0;
+	if (!limiter.allow((int64_t)(now * 1000.0), suppressed)) return;
+
+	va_list args;
+	va_start(args, format);
+	bool queued = mQueue.tryPushWith([&](Record& record) {
+		record.level = level;
+		record.time = now;
+		record.suppressed = suppressed;
+		vsnprintf(record.text, kMessageSize, format, args);
+	});
+	va_end(args);
+
+	if (!queued) {
+		mDropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+
+void Logger::WriterLoop(void)
+{
+	while (mRunning.load(std::memory_order_acquire)) {
+		if (Drain() == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		else {
+			fflush(stdout);
+		}
+	}
+}
+
+
+size_t Logger::Drain(void)
+{
+	size_t written = 0;
+	while (mQueue.tryPopWith([](Record& record) { Write(record); })) {
+		written++;
+	}
+
+	uint32_t dropped = mDropped.exchange(0, std::memory_order_relaxed);
+	if (dropped > 0) {
+		fprintf(stderr, "[%9.3f] WARN  logger: %u messages dropped, queue was full\n", LogClock(), dropped);
+	}
+	return written;
+}
+
+
+void Logger::Write(const Record& record)
+{
+	static const char* levelNames[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+	FILE* out = (record.level >= LogWarning) ? stderr : stdout;
+	fprintf(out, "[%9.3f] %s %s\n", record.time, levelNames[record.level], record.text);
+	if (record.suppressed > 0) {
+		fprintf(out, "[%9.3f] %s (%u similar messages suppressed)\n", record.time, levelNames[record.level], record.suppressed);
+	}
+}
+
+} // namespace game
@@ -0,0 +1,121 @@
+#ifndef LOGGER_H_
+#define LOGGER_H_
+
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+
+#include "ring_buffer.h"
+
+// Lowest severity that is compiled in. Calls below it disappear entirely at compile time.
+// Override from the build with -DLOG_MIN_LEVEL=<n>
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Default rate limit for every call site: messages per second before the rest get suppressed
+#define LOG_RATE_LIMIT 20
+
+// Every call site gets its own rate limiter
+#define LOG_AT(level, ...) \
+	do { \
+		static game::LogRateLimiter log_limiter_(LOG_RATE_LIMIT); \
+		game::Logger::log(level, log_limiter_, __VA_ARGS__); \
+	} while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(game::LogDebug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(game::LogInfo, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) LOG_AT(game::LogWarning, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_AT(game::LogError, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+namespace game {
+
+	enum LogLevel { LogDebug = LOG_LEVEL_DEBUG, LogInfo = LOG_LEVEL_INFO, LogWarning = LOG_LEVEL_WARNING, LogError = LOG_LEVEL_ERROR };
+
+	// class LogRateLimiter
+	// Lets through at most 'limit' messages per second from one call site and counts the rest
+	class LogRateLimiter {
+
+	public:
+		LogRateLimiter(uint32_t limit) : mLimit(limit), mWindow(0), mCount(0), mSuppressed(0) {}
+
+		// Returns true if the message may be logged. 'suppressed' receives the number of messages
+		// dropped since the last one that got through, so it can be reported once
+		bool allow(int64_t nowMs, uint32_t& suppressed);
+
+	private:
+		uint32_t mLimit;
+		std::atomic<int64_t> mWindow;
+		std::atomic<uint32_t> mCount;
+		std::atomic<uint32_t> mSuppressed;
+	};
+
+	// class Logger
+	// Non-blocking logger. Callers format into a fixed size slot of a lock-free ring buffer and return
+	// immediately; a background thread does the actual console I/O. If the buffer is full the message
+	// is dropped and counted rather than stalling the caller.
+	class Logger {
+
+	public:
+		// Size of one formatted message, including the terminator. Longer messages are truncated
+		static const size_t kMessageSize = 240;
+		// Number of messages that can be waiting for the writer thread
+		static const size_t kQueueSize = 1024;
+
+		// Start and stop the writer thread. Messages logged before Init or after Shutdown are kept
+		// in the buffer and written by the next Shutdown. Shutdown without Init only writes them out
+		static void Init(void);
+		static void Shutdown(void);
+
+		// printf-style logging. Use the LOG_* macros instead so disabled levels compile out
+		static void log(LogLevel level, LogRateLimiter& limiter, const char* format, ...)
+#if defined(__GNUC__)
+			__attribute__((format(printf, 3, 4)))
+#endif
+			;
+
+	private:
+		struct Record {
+			LogLevel level;
+			double time;
+			uint32_t suppressed;
+			char text[kMessageSize];
+		};
+
+		static RingBuffer<Record, kQueueSize> mQueue;
+		static std::atomic<bool> mRunning;
+		static std::atomic<uint32_t> mDropped;
+		static std::thread mWriter;
+
+		static void WriterLoop(void);
+		static size_t Drain(void);
+		static void Write(const Record& record);
+	};
+
+} // namespace game
+
+#endif // LOGGER_H_
@@ -11,17 +11,58 @@
 
 #include <iostream>
 #include <exception>
+#include <string.h>
+#include <stdlib.h>
 #include "game.h"
+#include "logger.h"
 
 
 
 // Macro for printing exceptions
 #define PrintException(exception_object)\
-	std::cerr << exception_object.what() << std::endl
+	LOG_ERROR("%s", exception_object.what())
 
 // Main function that builds and runs the game
-int main(void){
+// Options: --seed N to make the same world every run, --map FILE to load the map from FILE (or save it there),
+// --snapshot FILE to start from a snapshot saved with F5, --benchmark-map to time map planning at a few sizes and exit
+int main(int argc, char* argv[]){
+    unsigned int seed = 0;
+    bool hasSeed = false;
+    const char* mapFile = NULL;
+    const char* snapshotFile = NULL;
+    bool benchmarkMap = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+            hasSeed = true;
+        }
+        else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            mapFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshotFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--benchmark-map") == 0) {
+            benchmarkMap = true;
+        }
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+        }
+    }
+
+    // Needs no window or resources, so it runs without a Game
+    if (benchmarkMap) {
+        game::MapGenerator generator(NULL, seed);
+        generator.Benchmark(std::cout);
+        game::Logger::Shutdown();
+        return 0;
+    }
+
     game::Game app; // Game application
+    if (hasSeed) app.setSeed(seed);
+    if (mapFile) app.setMapFile(mapFile);
+    if (snapshotFile) app.setSnapshotFile(snapshotFile);
 
     try {
         // Initialize game
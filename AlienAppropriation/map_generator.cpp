@@ -1,129 +1,569 @@
+#include <thread>
+#include <fstream>
+#include <iterator>
+#include <string.h>
+#include <limits.h>
+#include <chrono>
+#include <algorithm>
+
 #include "map_generator.h"
+#include "worker_pool.h"
+#include "poisson_sampler.h"
+#include "density_map.h"
+#include "byte_stream.h"
 
 namespace game {
 
+	// Chunk keys are packed like grid cell keys
+	static inline void DecodeKey(uint64_t key, int& x, int& z)
+	{
+		x = (int)(uint32_t)(key >> 32);
+		z = (int)(uint32_t)key;
+	}
+
+
+	// Names of the object types, which are also the names of their prefabs
+	static const char* const OBJECT_NAMES[ObjectTypeCount] = { "none", "origin", "hay", "tree", "barn", "cow", "bull", "farmer", "cannon" };
+
+	// Map files: a header, then for each chunk its coordinates, its object count and the objects.
+	// An object is its position, its ObjectType, its rotation and its scale on top of its prefab's
+	static const char MAP_MAGIC[4] = { 'A', 'A', 'M', 'P' };
+	static const uint32_t MAP_VERSION = 3;
 
 
-	MapGenerator::MapGenerator(SceneGraph* sceneGraph, int initWidth, int initHeight) : cellSize (20)
+	// Closest spacing of placed points, where the density map is full, and the density it is scaled to at its emptiest
+	static const float MIN_SPACING = 14.0f;
+	static const float SPARSEST_DENSITY = 0.35f;
+
+	// What each biome puts on its points: one object, or with some chance the origin of a cluster,
+	// a share of which are farmyards of barns rather than copses of trees
+	struct BiomePlacement {
+		ObjectType single;
+		float clusterChance;
+		float barnShare;
+	};
+	static const BiomePlacement BIOME_PLACEMENT[DensityMap::BiomeCount] = {
+		{ ObjectHay, 0.05f, 0.0f },  // BiomePasture
+		{ ObjectHay, 0.15f, 0.6f },  // BiomeFarm
+		{ ObjectTree, 0.3f, 0.0f }   // BiomeForest
+	};
+
+
+	static void WriteObject(ByteWriter& writer, const Object& o)
 	{
-		scene = sceneGraph;
+		writer.put(o.pos.x);
+		writer.put(o.pos.y);
+		writer.put((uint8_t)o.type);
+		writer.put(o.rotation);
+		writer.put(o.scale.x);
+		writer.put(o.scale.y);
+		writer.put(o.scale.z);
+	}
 
-		// Initialise map variables
-		width = initWidth * 100;
-		height = initHeight * 100;
-		gridWidth = width / cellSize;
-		gridHeight = height / cellSize;
-		difficulty = 1;
 
-		density = 1;
-		cowCount;
-		enemyCount;
-		for (int i = 0; i < gridWidth; i++) {
-			std::vector<std::vector<Object>> column(gridHeight, std::vector<Object>());	
-			grid.push_back(column);
+	// Only objects that are spawned are written. Returns false for any other type
+	static bool ReadObject(ByteReader& reader, Object& o)
+	{
+		uint8_t type;
+		reader.get(o.pos.x);
+		reader.get(o.pos.y);
+		reader.get(type);
+		reader.get(o.rotation);
+		reader.get(o.scale.x);
+		reader.get(o.scale.y);
+		reader.get(o.scale.z);
+		o.type = (ObjectType)type;
+		return type > ObjectOrigin && type < ObjectTypeCount;
+	}
+
+
+	MapGenerator::MapGenerator(SceneGraph* sceneGraph, unsigned int seed)
+		: mSeed(seed)
+		, mDensity(1)
+		, mPendingJobs(0)
+		, mSpawnQueueSorted(true)
+		, mSortedFrom(0.0f)
+	{
+		scene = sceneGraph;
+		for (int type = 0; type < ObjectTypeCount; type++) {
+			mPrefabs[type] = Prefabs::NO_PREFAB;
 		}
 	}
 
 
 	MapGenerator::~MapGenerator()
 	{
+		// Planning jobs write into this generator
+		while (mPendingJobs > 0) {
+			if (!WorkerPool::Shared().runPendingJob()) std::this_thread::yield();
+		}
 	}
 
-	void MapGenerator::GenerateMap()
+	void MapGenerator::GenerateMap(const glm::vec3& center)
 	{
+		//Begin by creating the ground
+		TerrainLodNode* ground = scene->CreateInstance<TerrainLodNode>("Ground", "terrainPatch", "terrainMaterial", "groundTexture");
+		ground->setQuarterPatch(ResourceManager::getResource("terrainQuarterPatch"));
+		scene->setCollisionLayer(ground, LayerNone);
 
-		//Begin by creating a ground plane
-		for (int i = 0; i < width/100; i++) {
-			for (int j = 0; j < height/100; j++) {
-				SceneNode* ground = scene->CreateInstance<SceneNode>("Ground" + std::to_string(i) + std::to_string(j), "GridMesh", "litTextureMaterial", "groundTexture");
-				ground->translate(glm::vec3(i * 100, 0, j * 100));
+		for (int type = ObjectHay; type < ObjectTypeCount; type++) {
+			mPrefabs[type] = Prefabs::find(OBJECT_NAMES[type]);
+			if (mPrefabs[type] == Prefabs::NO_PREFAB) {
+				throw(GameException(std::string("No prefab for map objects \"") + OBJECT_NAMES[type] + std::string("\"")));
 			}
 		}
 
-		// Generate random points
-		const auto Points = PoissonGenerator::generatePoissonPoints((gridWidth+1) * (gridHeight+1) * density, PRNG,50,false, 1/(density * glm::min(gridWidth, gridHeight)));
-		//const auto Points = PoissonGenerator::generatePoissonPoints(1, PRNG, 50, false, 1 / (density * glm::min(gridWidth, gridHeight)));
+		// The first chunks are needed before anything is drawn, so plan them all at once
+		int cx = ChunkCoord(center.x);
+		int cz = ChunkCoord(center.z);
+		std::vector<Chunk> chunks;
+		for (int z = cz - LOAD_RADIUS; z <= cz + LOAD_RADIUS; z++) {
+			for (int x = cx - LOAD_RADIUS; x <= cx + LOAD_RADIUS; x++) {
+				Chunk chunk;
+				chunk.x = x;
+				chunk.z = z;
+				chunks.push_back(chunk);
+			}
+		}
+		WorkerPool::Shared().parallelFor(chunks.size(), [&](size_t i) {
+			PlanChunk(chunks[i].x, chunks[i].z, chunks[i].objects);
+		});
 
-		// Sort the random points into grid cells based off theer position
-		for (auto p : Points) {
-			Object point;
-			point.pos = glm::vec2(p.x * width, p.y * height);
-			point.a = floor(point.pos.x / cellSize); 
-			point.b = floor(point.pos.y / cellSize);
-			point.type = "hay";
-			int r = rand() % 100;
-			if (r < 15) {
-				point.type = "originPoint";
-			}
-			grid.at(point.a).at(point.b).push_back(point);
-		}
-		
-		// Generate tight clusters of objects around certain points 
-		for (int x = 0; x < gridWidth; x++) {
-			for (int y = 0; y < gridHeight; y++) {
-				for (int i = 0; i <grid.at(x).at(y).size(); i++) {
-					if (grid.at(x).at(y).at(i).type == "originPoint") {
-						GenerateCluster(grid.at(x).at(y).at(i));
-					}
+		for (const Chunk& chunk : chunks) {
+			QueueChunk(chunk);
+			mChunks[SceneGraph::CellKey(chunk.x, chunk.z)] = ChunkLoaded;
+		}
+	}
+
+
+	void MapGenerator::SaveMap(const std::string& path, const glm::vec3& center, int radius) const
+	{
+		int cx = ChunkCoord(center.x);
+		int cz = ChunkCoord(center.z);
+		std::vector<Chunk> chunks;
+		for (int z = cz - radius; z <= cz + radius; z++) {
+			for (int x = cx - radius; x <= cx + radius; x++) {
+				Chunk chunk;
+				chunk.x = x;
+				chunk.z = z;
+				chunks.push_back(chunk);
+			}
+		}
+		WorkerPool::Shared().parallelFor(chunks.size(), [&](size_t i) {
+			PlanChunk(chunks[i].x, chunks[i].z, chunks[i].objects);
+		});
+
+		std::vector<char> out;
+		ByteWriter writer(out);
+		writer.putBytes(MAP_MAGIC, sizeof(MAP_MAGIC));
+		writer.put(MAP_VERSION);
+		writer.put((uint32_t)mSeed);
+		writer.put((uint32_t)chunks.size());
+		for (const Chunk& chunk : chunks) {
+			writer.put((int32_t)chunk.x);
+			writer.put((int32_t)chunk.z);
+			writer.put((uint32_t)chunk.objects.size());
+			for (const Object& o : chunk.objects) {
+				WriteObject(writer, o);
+			}
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file.write(out.data(), out.size())) {
+			throw(GameException(std::string("Could not write map file \"") + path + std::string("\"")));
+		}
+	}
+
+
+	bool MapGenerator::LoadMap(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return false;
+		std::vector<char> in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		ByteReader reader(in.data(), in.size(), std::string("Map file \"") + path + std::string("\""));
+		char magic[4];
+		uint32_t version, seed, chunkCount;
+		reader.get(magic);
+		reader.get(version);
+		if (memcmp(magic, MAP_MAGIC, sizeof(magic)) != 0 || version != MAP_VERSION) {
+			throw(GameException(std::string("\"") + path + std::string("\" is not a map file")));
+		}
+		reader.get(seed);
+		reader.get(chunkCount);
+
+		std::unordered_map<uint64_t, std::vector<Object>> saved;
+		for (uint32_t c = 0; c < chunkCount; c++) {
+			int32_t x, z;
+			uint32_t objectCount;
+			reader.get(x);
+			reader.get(z);
+			reader.get(objectCount);
+
+			glm::vec2 corner(x * CHUNK_SIZE, z * CHUNK_SIZE);
+			std::vector<Object>& objects = saved[SceneGraph::CellKey(x, z)];
+			objects.resize(objectCount);
+			for (Object& o : objects) {
+				if (!ReadObject(reader, o)) {
+					throw(GameException(std::string("Unknown object type in map file \"") + path + std::string("\"")));
 				}
+				o.a = glm::clamp((int)floor((o.pos.x - corner.x) / SceneGraph::GRID_CELL_SIZE), 0, CHUNK_CELLS - 1);
+				o.b = glm::clamp((int)floor((o.pos.y - corner.y) / SceneGraph::GRID_CELL_SIZE), 0, CHUNK_CELLS - 1);
 			}
 		}
-		
-		// Create objects at each point
-		for (int x = 0; x < gridWidth; x++) {
-			for (int y = 0; y < gridHeight; y++) {
-				for (auto o : grid.at(x).at(y)) {
-					if (!(o.type == "default" || o.type == "originPoint")) {
-
-						if (o.type == "hay") {
-							EntityNode* obj = scene->CreateInstance<EntityNode>(o.type + std::to_string(x) + std::to_string(y), o.type + "Mesh", "litTextureMaterial", o.type + "Texture");
-							obj->translate(glm::vec3(o.pos.x, 0, o.pos.y));
-							obj->rotate(glm::angleAxis(glm::half_pi<float>(), glm::vec3(0, 0, 1)));
-							//obj->rotate(glm::angleAxis((rand()%360) * (glm::pi<float>() / 180), glm::vec3(-1, 0, 0)));
-							obj->translate(glm::vec3(0, 0.5, 0));
-							obj->addTag("canPickUp");
-							obj->addTag("canCollect");
-
-						}
-						else {
-							SceneNode* obj = scene->CreateInstance<SceneNode>(o.type + std::to_string(x) + std::to_string(y), o.type + "Mesh", "litTextureMaterial", o.type + "Texture");
-							obj->translate(glm::vec3(o.pos.x, 0, o.pos.y));
-							if (o.type == "tree") {
-								obj->scale(glm::vec3(1.25f + rand() % 5 / 10.0f));
-							}
-							if (o.type == "barn") {
-								obj->rotate(glm::angleAxis(glm::radians(o.rotation), glm::vec3(0, 1, 0)));
-								obj->scale(glm::vec3(1.3f + rand() % 80 / 100.0f, 1.3f + rand() % 80 / 100.0f, 1.3f + rand() % 80 / 100.0f));
-							}
-						}
-					}
 
+		mSeed = seed;
+		mSaved.swap(saved);
+		return true;
+	}
+
+
+	void MapGenerator::WriteState(ByteWriter& writer) const
+	{
+		std::vector<uint64_t> loaded;
+		for (const auto& chunk : mChunks) {
+			if (chunk.second == ChunkLoaded) loaded.push_back(chunk.first);
+		}
+		writer.put((uint32_t)loaded.size());
+		for (uint64_t key : loaded) {
+			writer.put(key);
+		}
+
+		writer.put((uint32_t)mSpawnQueue.size());
+		for (const QueuedObject& queued : mSpawnQueue) {
+			WriteObject(writer, queued.object);
+			writer.put((int32_t)queued.chunkX);
+			writer.put((int32_t)queued.chunkZ);
+			writer.put(queued.index);
+		}
+
+		writer.put((uint32_t)mPlaced.size());
+		for (const auto& chunk : mPlaced) {
+			writer.put(chunk.first);
+			writer.put((uint32_t)chunk.second.size());
+			for (size_t i = 0; i < chunk.second.size(); i += 8) {
+				uint8_t bits = 0;
+				for (size_t b = 0; b < 8 && i + b < chunk.second.size(); b++) {
+					if (chunk.second[i + b]) bits |= (uint8_t)(1 << b);
+				}
+				writer.put(bits);
+			}
+		}
+	}
+
+
+	void MapGenerator::ReadState(ByteReader& reader, State& state)
+	{
+		uint32_t loadedCount, queuedCount;
+		reader.get(loadedCount);
+		for (uint32_t i = 0; i < loadedCount; i++) {
+			uint64_t key;
+			reader.get(key);
+			state.chunks[key] = ChunkLoaded;
+		}
+
+		reader.get(queuedCount);
+		for (uint32_t i = 0; i < queuedCount; i++) {
+			QueuedObject queued;
+			int32_t x, z;
+			if (!ReadObject(reader, queued.object)) {
+				throw(GameException(std::string("Unknown object type in snapshot")));
+			}
+			reader.get(x);
+			reader.get(z);
+			reader.get(queued.index);
+			queued.chunkX = x;
+			queued.chunkZ = z;
+			state.spawnQueue.push_back(queued);
+		}
+
+		uint32_t placedCount;
+		reader.get(placedCount);
+		for (uint32_t i = 0; i < placedCount; i++) {
+			uint64_t key;
+			uint32_t objectCount;
+			reader.get(key);
+			reader.get(objectCount);
+			// Read before sizing anything, so a damaged count runs off the end instead of allocating
+			const uint8_t* bits = (const uint8_t*)reader.getBytes(((size_t)objectCount + 7) / 8);
+			std::vector<bool>& objects = state.placed[key];
+			objects.resize(objectCount);
+			for (uint32_t o = 0; o < objectCount; o++) {
+				objects[o] = (bits[o / 8] >> (o % 8)) & 1;
+			}
+		}
+	}
+
+
+	void MapGenerator::setState(State& state)
+	{
+		// Plans still being made land on chunks that are no longer pending, and are dropped
+		mChunks.swap(state.chunks);
+		mSpawnQueue.swap(state.spawnQueue);
+		mSpawnQueueSorted = false;
+		mPlaced.swap(state.placed);
+	}
+
+
+	void MapGenerator::update(const glm::vec3& center)
+	{
+		int cx = ChunkCoord(center.x);
+		int cz = ChunkCoord(center.z);
+
+		// Nearest first, so the chunks the camera reaches first are planned first
+		for (int r = 0; r <= LOAD_RADIUS; r++) {
+			for (int z = -r; z <= r; z++) {
+				for (int x = -r; x <= r; x++) {
+					if (abs(x) == r || abs(z) == r) RequestChunk(cx + x, cz + z);
 				}
 			}
 		}
 
+		{
+			std::lock_guard<std::mutex> lock(mReadyMutex);
+			mTaken.swap(mReady);
+		}
+		for (const Chunk& chunk : mTaken) {
+			// Skip chunks unloaded while they were being planned, or already loaded by an earlier request
+			auto found = mChunks.find(SceneGraph::CellKey(chunk.x, chunk.z));
+			if (found == mChunks.end() || found->second != ChunkPending) continue;
+
+			QueueChunk(chunk);
+			found->second = ChunkLoaded;
+		}
+		mTaken.clear();
 
+		bool unloaded = false;
+		for (auto it = mChunks.begin(); it != mChunks.end();) {
+			int x, z;
+			DecodeKey(it->first, x, z);
+			if (abs(x - cx) > UNLOAD_RADIUS || abs(z - cz) > UNLOAD_RADIUS) {
+				mUnloaded.push_back(it->first);
+				it = mChunks.erase(it);
+				unloaded = true;
+			}
+			else {
+				++it;
+			}
+		}
+		if (unloaded) {
+			// What an unloaded chunk still had queued goes with it
+			mSpawnQueue.erase(std::remove_if(mSpawnQueue.begin(), mSpawnQueue.end(), [&](const QueuedObject& queued) {
+				return abs(queued.chunkX - cx) > UNLOAD_RADIUS || abs(queued.chunkZ - cz) > UNLOAD_RADIUS;
+			}), mSpawnQueue.end());
+		}
 
+		SpawnQueued(center);
+		UnloadFarNodes(cx, cz);
 	}
 
 
+	void MapGenerator::RequestChunk(int x, int z)
+	{
+		uint64_t key = SceneGraph::CellKey(x, z);
+		if (mChunks.find(key) != mChunks.end()) return;
+		mChunks[key] = ChunkPending;
+
+		mPendingJobs++;
+		WorkerPool::Shared().submitBackground([this, x, z]() {
+			Chunk chunk;
+			chunk.x = x;
+			chunk.z = z;
+			PlanChunk(x, z, chunk.objects);
+			{
+				std::lock_guard<std::mutex> lock(mReadyMutex);
+				mReady.push_back(std::move(chunk));
+			}
+			mPendingJobs--;
+		});
+	}
+
 
-	void MapGenerator::GenerateCluster(Object origin)
+	// Delete whatever the map placed in the cells of chunks that just went out of range, and in the ring of chunks
+	// right outside it. Going by the grid rather than by chunk also catches animals that wandered off their own
+	// chunk: one that walks out of range has to cross the ring, which is a chunk wide. Carried nodes are left alone
+	// The objects they came from go back to their home chunks' plans, to be spawned when those load again
+	void MapGenerator::UnloadFarNodes(int x, int z)
 	{
+		const int ring = UNLOAD_RADIUS + 1;
+		for (int cz = z - ring; cz <= z + ring; cz++) {
+			for (int cx = x - ring; cx <= x + ring; cx++) {
+				if (abs(cx - x) == ring || abs(cz - z) == ring) UnloadChunkNodes(cx, cz);
+			}
+		}
+
+		// Only the ones the ring missed: after a jump of the camera they can be anywhere
+		for (uint64_t key : mUnloaded) {
+			int cx, cz;
+			DecodeKey(key, cx, cz);
+			if (abs(cx - x) > ring || abs(cz - z) > ring) UnloadChunkNodes(cx, cz);
+		}
+		mUnloaded.clear();
+	}
+
+
+	void MapGenerator::UnloadChunkNodes(int x, int z)
+	{
+		BaseNode* root = scene->getRootNode();
+		const GridCells& cells = SceneGraph::getGridCells();
+		for (int b = 0; b < CHUNK_CELLS; b++) {
+			for (int a = 0; a < CHUNK_CELLS; a++) {
+				auto cell = cells.find(SceneGraph::CellKey(x * CHUNK_CELLS + a, z * CHUNK_CELLS + b));
+				if (cell == cells.end()) continue;
+
+				for (SceneNode* node : cell->second) {
+					if (node->getParentNode() == root && node->hasTag("streamed")) {
+						SceneGraph::deleteNode(node);
+						Unplace(node);
+					}
+				}
+			}
+		}
+	}
+
+
+	void MapGenerator::Unplace(const SceneNode* node)
+	{
+		auto placed = mPlaced.find(node->getHomeChunk());
+		if (placed == mPlaced.end() || node->getPlanIndex() >= placed->second.size()) return;
+
+		placed->second[node->getPlanIndex()] = false;
+		// A chunk with nothing out any more is planned afresh when it loads, so it needs no entry
+		if (std::find(placed->second.begin(), placed->second.end(), true) == placed->second.end()) {
+			mPlaced.erase(placed);
+		}
+	}
+
+
+	uint32_t MapGenerator::ChunkSeed(int x, int z) const
+	{
+		uint32_t h = mSeed * 0x9e3779b9u ^ (uint32_t)x * 0x85ebca6bu ^ (uint32_t)z * 0xc2b2ae35u;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+
+	void MapGenerator::PlanChunk(int x, int z, std::vector<Object>& objects) const
+	{
+		auto found = mSaved.find(SceneGraph::CellKey(x, z));
+		if (found != mSaved.end()) {
+			objects = found->second;
+		}
+		else {
+			GenerateChunk(x, z, objects);
+		}
+	}
+
+
+	void MapGenerator::GenerateChunk(int x, int z, std::vector<Object>& objects) const
+	{
+		PoissonGenerator::DefaultPRNG prng(ChunkSeed(x, z));
+		glm::vec2 corner(x * CHUNK_SIZE, z * CHUNK_SIZE);
+
+		DensityMap density(mSeed, corner, CHUNK_SIZE);
+
+		// Generate random points, further apart where the density map is low
+		const int rasterCount = DensityMap::RASTER_SIZE * DensityMap::RASTER_SIZE;
+		float spacing[rasterCount];
+		for (int i = 0; i < rasterCount; i++) {
+			spacing[i] = 1.0f / (SPARSEST_DENSITY + (1.0f - SPARSEST_DENSITY) * density.getDensities()[i]);
+		}
+		std::vector<glm::vec2> Points;
+		PoissonSampler::Sample(CHUNK_SIZE, CHUNK_SIZE, MIN_SPACING / mDensity, (uint32_t)prng.randomInt(INT_MAX), WorkerPool::Shared(),
+			Points, 50, false, spacing, DensityMap::RASTER_SIZE);
+
+		// What a point becomes, and whether it starts a cluster, is up to the biome it is in
+		std::vector<Object> placed(Points.size());
+		std::vector<Object> origins;
+		std::vector<bool> barnClusters;
+		int next[CHUNK_CELLS * CHUNK_CELLS] = { 0 };
+		for (size_t i = 0; i < Points.size(); i++) {
+			const glm::vec2& p = Points[i];
+			const BiomePlacement& biome = BIOME_PLACEMENT[density.getBiome(p)];
+			Object& point = placed[i];
+			point.pos = corner + p;
+			point.a = glm::clamp((int)floor(p.x / SceneGraph::GRID_CELL_SIZE), 0, CHUNK_CELLS - 1);
+			point.b = glm::clamp((int)floor(p.y / SceneGraph::GRID_CELL_SIZE), 0, CHUNK_CELLS - 1);
+			point.type = biome.single;
+			if (point.type == ObjectTree) {
+				point.scale = glm::vec3(1.25f + prng.randomInt(4) / 10.0f);
+			}
+			if (prng.randomFloat() < biome.clusterChance) {
+				point.type = ObjectOrigin;
+				origins.push_back(point);
+				barnClusters.push_back(prng.randomFloat() < biome.barnShare);
+			}
+			next[point.b * CHUNK_CELLS + point.a]++;
+		}
+
+		// Sort the points into grid cells by counting them first
+		CellGrid grid;
+		grid.cellStart[0] = 0;
+		for (int c = 0; c < CHUNK_CELLS * CHUNK_CELLS; c++) {
+			grid.cellStart[c + 1] = grid.cellStart[c] + next[c];
+			next[c] = grid.cellStart[c];
+		}
+		grid.objects.resize(placed.size());
+		for (const Object& point : placed) {
+			grid.objects[next[point.b * CHUNK_CELLS + point.a]++] = point;
+		}
+
+		// Generate tight clusters of objects around certain points
+		std::vector<Object> cluster;
+		for (size_t i = 0; i < origins.size(); i++) {
+			GenerateCluster(origins[i], barnClusters[i], corner, grid, prng, cluster);
+		}
+
+		for (const Object& o : grid.objects) {
+			if (o.type != ObjectNone && o.type != ObjectOrigin) {
+				objects.push_back(o);
+			}
+		}
+		objects.insert(objects.end(), cluster.begin(), cluster.end());
+
+		// Animals, farmers and the odd cannon, about as many per chunk as the old fixed map had
+		auto scatter = [&](ObjectType type, int count, const glm::vec3& scale) {
+			for (int i = 0; i < count; i++) {
+				Object entity;
+				entity.type = type;
+				entity.pos.x = corner.x + prng.randomFloat() * CHUNK_SIZE;
+				entity.pos.y = corner.y + prng.randomFloat() * CHUNK_SIZE;
+				entity.scale = scale;
+				objects.push_back(entity);
+			}
+		};
+		scatter(ObjectCow, 3 + prng.randomInt(2), glm::vec3(1.0f));
+		scatter(ObjectBull, 1 + prng.randomInt(2), glm::vec3(1.0f));
+		scatter(ObjectFarmer, 1 + prng.randomInt(2), glm::vec3(1.0f));
+		scatter(ObjectCannon, (prng.randomFloat() < 0.55f) ? 1 : 0, glm::vec3(1.0f));
+	}
+
+
+
+	void MapGenerator::GenerateCluster(const Object& origin, bool isBarnCluster, const glm::vec2& corner, CellGrid& grid, PoissonGenerator::DefaultPRNG& prng, std::vector<Object>& cluster) const
+	{
+		const float cellSize = SceneGraph::GRID_CELL_SIZE;
+
 		// Generate a tight cluster of objects around an origin point
-		bool isBarnCluster = (rand() % 100) < 20;
 		// The objects we generate are either trees or houses/barns
 
 		//erase any points in adjacent cells to avoid overlap
-		float radius = (isBarnCluster) ? cellSize : (1 + (rand() % 5) / 5.0f) * cellSize;
-		for (int x = -1; x < 1; x++) {
-			for (int y = -1; y < 1; y++) {
-				// if the origin is on the border of the map, do not look for points outside the map
-				if (origin.a + x < 0 || origin.a + x > gridWidth - 1 || origin.b + y < 0 || origin.b + y > gridHeight - 1) continue;
-				// look in adjacent grid cells and ignore points within radius
-				for (auto point : grid.at(origin.a + x).at(origin.b + y)) {
-					if (glm::distance(origin.pos, point.pos) < radius) {
-						point.type = "default";
+		float radius = (isBarnCluster) ? cellSize : (1 + prng.randomInt(4) / 5.0f) * cellSize;
+		for (int y = -1; y <= 1; y++) {
+			for (int x = -1; x <= 1; x++) {
+				// if the origin is on the border of the chunk, do not look for points outside it
+				if (origin.a + x < 0 || origin.a + x > CHUNK_CELLS - 1 || origin.b + y < 0 || origin.b + y > CHUNK_CELLS - 1) continue;
+				// look in adjacent grid cells and clear points within radius
+				int c = (origin.b + y) * CHUNK_CELLS + origin.a + x;
+				for (int i = grid.cellStart[c]; i < grid.cellStart[c + 1]; i++) {
+					Object& point = grid.objects[i];
+					glm::vec2 d = point.pos - origin.pos;
+					if (point.type != ObjectOrigin && d.x * d.x + d.y * d.y < radius * radius) {
+						point.type = ObjectNone;
 					}
 				}
 			}
@@ -131,28 +571,140 @@ namespace game {
 
 		// Now that we've cleared some space, generate the cluster of objects
 		int n;
-		n = (isBarnCluster) ? rand() % 6 + 1 : rand() % 30 + 10;
-		const auto Points = PoissonGenerator::generatePoissonPoints(n, PRNG, 70);
+		n = (isBarnCluster) ? prng.randomInt(5) + 1 : prng.randomInt(29) + 10;
+		std::vector<glm::vec2> Points;
+		PoissonSampler::Sample(radius, radius, radius * sqrtf((float)n) / n, (uint32_t)prng.randomInt(INT_MAX), WorkerPool::Shared(), Points, 70, true);
+		Points.resize(glm::min(Points.size(), (size_t)n));
 		for (auto p : Points) {
 			Object point;
-			point.pos = origin.pos +  glm::vec2(p.x * radius, p.y * radius) - radius/2.0f; //position the randomly generated point around the origin
-			point.a = floor(point.pos.x / cellSize);
-			point.b = floor(point.pos.y / cellSize);
-			if (point.a > gridWidth - 1 || point.a < 0 || point.b > gridHeight - 1 || point.b < 0) continue;
+			point.pos = origin.pos + p - radius/2.0f; //position the randomly generated point around the origin
+			point.a = (int)floor((point.pos.x - corner.x) / cellSize);
+			point.b = (int)floor((point.pos.y - corner.y) / cellSize);
+			// The neighbouring chunk is planned on its own, so what would spill into it is dropped
+			if (point.a > CHUNK_CELLS - 1 || point.a < 0 || point.b > CHUNK_CELLS - 1 || point.b < 0) continue;
 
 			if (isBarnCluster) {
-				point.type = "barn";
-				switch (rand() % 3) {
+				point.type = ObjectBarn;
+				switch (prng.randomInt(2)) {
 				case 0: point.rotation = 0;  break;
 				case 1: point.rotation = 90;  break;
 				case 2: point.rotation = glm::orientedAngle(glm::normalize(origin.pos), glm::normalize(point.pos - origin.pos));  break;
 				}
+				point.scale.x = 1.3f + prng.randomInt(79) / 100.0f;
+				point.scale.y = 1.3f + prng.randomInt(79) / 100.0f;
+				point.scale.z = 1.3f + prng.randomInt(79) / 100.0f;
 			}
 			else {
-				point.type = "tree";
+				point.type = ObjectTree;
+				point.scale = glm::vec3(1.25f + prng.randomInt(4) / 10.0f);
 			}
-			grid.at(point.a).at(point.b).push_back(point);
+			cluster.push_back(point);
+		}
+
+	}
+
+
+	void MapGenerator::Benchmark(std::ostream& out) const
+	{
+		// Radii in chunks; the largest map is over a thousand times the smallest
+		static const int RADII[] = { 1, 2, 4, 8, 16, 32 };
+		static const int RUNS = 3;
+
+		out << "Map planning, " << WorkerPool::Shared().getThreadCount() + 1 << " threads, best of " << RUNS << " runs" << std::endl;
+		out << "chunks\tobjects\tms\tus per chunk" << std::endl;
+		for (int radius : RADII) {
+			int side = 2 * radius + 1;
+			std::vector<std::vector<Object>> chunks((size_t)side * side);
+
+			double best = 1.0e30;
+			for (int run = 0; run < RUNS; run++) {
+				auto start = std::chrono::steady_clock::now();
+				WorkerPool::Shared().parallelFor(chunks.size(), [&](size_t i) {
+					chunks[i].clear();
+					GenerateChunk((int)(i % side) - radius, (int)(i / side) - radius, chunks[i]);
+				});
+				best = glm::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+
+			size_t objects = 0;
+			for (const std::vector<Object>& chunk : chunks) objects += chunk.size();
+			out << chunks.size() << "\t" << objects << "\t" << best << "\t" << best * 1000.0 / chunks.size() << std::endl;
 		}
-		
 	}
-}
\ No newline at end of file
+
+
+	void MapGenerator::QueueChunk(const Chunk& chunk)
+	{
+		auto placed = mPlaced.find(SceneGraph::CellKey(chunk.x, chunk.z));
+		for (size_t i = 0; i < chunk.objects.size(); i++) {
+			if (placed != mPlaced.end() && i < placed->second.size() && placed->second[i]) continue;
+
+			QueuedObject queued;
+			queued.object = chunk.objects[i];
+			queued.chunkX = chunk.x;
+			queued.chunkZ = chunk.z;
+			queued.index = (uint32_t)i;
+			mSpawnQueue.push_back(queued);
+		}
+		if (!chunk.objects.empty()) mSpawnQueueSorted = false;
+	}
+
+
+	void MapGenerator::SpawnQueued(const glm::vec3& center)
+	{
+		if (mSpawnQueue.empty()) return;
+
+		glm::vec2 from(center.x, center.z);
+		glm::vec2 moved = from - mSortedFrom;
+		if (!mSpawnQueueSorted || moved.x * moved.x + moved.y * moved.y > RESORT_DISTANCE * RESORT_DISTANCE) {
+			std::sort(mSpawnQueue.begin(), mSpawnQueue.end(), [&](const QueuedObject& a, const QueuedObject& b) {
+				glm::vec2 da = a.object.pos - from, db = b.object.pos - from;
+				return da.x * da.x + da.y * da.y > db.x * db.x + db.y * db.y;
+			});
+			mSpawnQueueSorted = true;
+			mSortedFrom = from;
+		}
+
+		// At least one batch a tick, so a slow machine still fills in
+		auto start = std::chrono::steady_clock::now();
+		do {
+			mBatch.clear();
+			mBatchObjects.clear();
+			while (!mSpawnQueue.empty() && mBatch.size() < (size_t)SPAWN_BATCH) {
+				BatchObject(mSpawnQueue.back());
+				mSpawnQueue.pop_back();
+			}
+			mBatchNodes.clear();
+			scene->SpawnBatch(mBatch.data(), mBatch.size(), &mBatchNodes);
+
+			// Only what the map placed is unloaded with its chunk
+			for (size_t i = 0; i < mBatchNodes.size(); i++) {
+				const QueuedObject& queued = mBatchObjects[i];
+				uint64_t home = SceneGraph::CellKey(queued.chunkX, queued.chunkZ);
+				mBatchNodes[i]->addTag("streamed");
+				mBatchNodes[i]->setHome(home, queued.index);
+
+				std::vector<bool>& placed = mPlaced[home];
+				if (placed.size() <= queued.index) placed.resize(queued.index + 1, false);
+				placed[queued.index] = true;
+			}
+		} while (!mSpawnQueue.empty() &&
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < SPAWN_BUDGET_MS);
+	}
+
+
+	void MapGenerator::BatchObject(const QueuedObject& queued)
+	{
+		const Object& o = queued.object;
+		if (mPrefabs[o.type] == Prefabs::NO_PREFAB) return;
+
+		PrefabInstance instance;
+		instance.prefab = mPrefabs[o.type];
+		instance.name = std::string(OBJECT_NAMES[o.type]) + "_" + std::to_string(queued.chunkX) + "_" + std::to_string(queued.chunkZ) + "_" + std::to_string(queued.index);
+		instance.position = glm::vec3(o.pos.x, Terrain::getHeight(o.pos.x, o.pos.y), o.pos.y);
+		instance.orientation = glm::angleAxis(glm::radians(o.rotation), glm::vec3(0, 1, 0));
+		instance.scale = o.scale;
+		mBatch.push_back(std::move(instance));
+		mBatchObjects.push_back(queued);
+	}
+}
@@ -5,62 +5,196 @@
 
 #include <exception>
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <ostream>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include <glm/gtx/vector_angle.hpp>
 
-#define POISSON_PROGRESS_INDICATOR 1
+// Chunks are generated on worker threads, which must not write to the console
+#define POISSON_PROGRESS_INDICATOR 0
 #include "PoissonGenerator.h"
 
 
 #include "scene_graph.h"
 #include "resource_manager.h"
 #include "entity_node.h"
+#include "terrain.h"
 
 
 namespace game {
 
+	class ByteWriter;
+	class ByteReader;
+
+	// What an object on the map is. None and Origin only exist while a chunk is planned
+	enum ObjectType : uint8_t {
+		ObjectNone,   // Cleared to make room
+		ObjectOrigin, // Centre of a cluster
+		ObjectHay,
+		ObjectTree,
+		ObjectBarn,
+		ObjectCow,
+		ObjectBull,
+		ObjectFarmer,
+		ObjectCannon,
+		ObjectTypeCount
+	};
+
 	// struct Object
 	// An object on the map. Purely abstract - does not exist in the scene
 	struct Object {
 		glm::vec2 pos;
-		int a = 0, b = 0;
-		std::string type = "default";
+		int a = 0, b = 0; // Grid cell inside its chunk
+		ObjectType type = ObjectNone;
 		float rotation = 0;
+		glm::vec3 scale = glm::vec3(1.0f);
 	};
 
 	// class MapGenerator
-	// Handles map generation
+	// Streams the map in chunks around the camera
+	// A chunk is planned on a worker thread (density map, Poisson placement, clusters, entities) from a seed derived from
+	// its coordinates, so the same chunk comes back the same when it is revisited. The simulation thread queues
+	// the planned objects and turns them into nodes nearest the camera first, for a fixed time each tick, so
+	// the world fills in around the camera without a stall. Whatever has fallen too far behind is unloaded.
+	// Chunks load within LOAD_RADIUS and unload past UNLOAD_RADIUS, so hovering on a border does not churn
+	// Each node remembers the chunk and plan object it came from. A chunk that loads again leaves out the objects
+	// whose nodes are still about, or were collected or destroyed; only what was unloaded comes back
 	class MapGenerator
 	{
 	public:
-		MapGenerator(SceneGraph* sceneGraph, int initWidth = 3, int initHeight = 3);
+		// A chunk is CHUNK_CELLS by CHUNK_CELLS cells of the scene grid
+		static const int CHUNK_CELLS = 5;
+		static constexpr float CHUNK_SIZE = CHUNK_CELLS * SceneGraph::GRID_CELL_SIZE;
+		// In chunks, measured as the larger of the x and z distance from the camera's chunk
+		static const int LOAD_RADIUS = 3;
+		static const int UNLOAD_RADIUS = 4;
+		// Time a tick may spend turning queued objects into nodes
+		static constexpr double SPAWN_BUDGET_MS = 2.0;
+		// Queued objects are spawned this many to a batch, checking the time in between
+		static const int SPAWN_BATCH = 32;
+		// The queue is put back in order of distance when the camera has moved this far
+		static constexpr float RESORT_DISTANCE = 10.0f;
+
+		// The same seed plans the same map
+		MapGenerator(SceneGraph* sceneGraph, unsigned int seed);
 		~MapGenerator();
-		void GenerateMap();
+
+		// Create the ground and plan the chunks around center before the first tick. They are spawned by update
+		void GenerateMap(const glm::vec3& center);
+
+		// Write the plans of the chunks out to radius around center, for LoadMap
+		void SaveMap(const std::string& path, const glm::vec3& center, int radius) const;
+		// Use the chunks saved by SaveMap instead of planning them, and the seed they were planned with for the rest
+		// Returns false if the file does not exist, throws if it is not a map
+		bool LoadMap(const std::string& path);
+		inline unsigned int getSeed(void) const { return mSeed; }
+
+		// Plan square maps of a few sizes, using every worker, and write how long each took
+		// Needs no scene, terrain or window
+		void Benchmark(std::ostream& out) const;
+
+		// Once per tick, before the commit: request, spawn and unload chunks around center
+		void update(const glm::vec3& center);
+
+		// Which chunks are loaded, the objects still waiting for their nodes and the ones that have a node or had
+		// one, for WorldSnapshot. ReadState only parses them, so a snapshot can check all of itself before anything
+		// changes; setState then replaces all three. Chunks that were still being planned are asked for again by
+		// the next update
+		struct State;
+		void WriteState(ByteWriter& writer) const;
+		static void ReadState(ByteReader& reader, State& state);
+		void setState(State& state);
 
 	private:
 		// Scene graph containing all nodes to render
 		SceneGraph* scene;
 
-		PoissonGenerator::DefaultPRNG PRNG;
-		void GenerateCluster(Object origin);
-
-		//Generate points
-		int gridWidth;
-		int gridHeight;
-		const int cellSize;
-		int width;
-		int height;
-		int difficulty;
+		enum ChunkState { ChunkPending, ChunkLoaded };
+
+		struct Chunk {
+			int x, z;
+			std::vector<Object> objects;
+		};
+
+		// A chunk's objects sorted by grid cell: cell c = b * CHUNK_CELLS + a holds objects cellStart[c]
+		// up to cellStart[c + 1]
+		struct CellGrid {
+			std::vector<Object> objects;
+			int cellStart[CHUNK_CELLS * CHUNK_CELLS + 1];
+		};
+
+		unsigned int mSeed;
+		float mDensity;
+		// Prefab of each ObjectType, found by GenerateMap. NO_PREFAB for types that are never spawned
+		PrefabId mPrefabs[ObjectTypeCount];
+
+		// Simulation thread only
+		std::unordered_map<uint64_t, ChunkState> mChunks;
+		// Chunks read by LoadMap
+		std::unordered_map<uint64_t, std::vector<Object>> mSaved;
+
+		// Planned by the workers, waiting to be spawned
+		std::mutex mReadyMutex;
+		std::vector<Chunk> mReady;
+		std::vector<Chunk> mTaken;
+		std::atomic<int> mPendingJobs;
+
+		// Planned objects of loaded chunks waiting for their nodes, nearest the camera last
+		struct QueuedObject {
+			Object object;
+			int chunkX, chunkZ;
+			uint32_t index; // In its chunk, for its name
+		};
+		std::vector<QueuedObject> mSpawnQueue;
+		bool mSpawnQueueSorted;
+		glm::vec2 mSortedFrom;
+		// The batch being spawned and the objects it is made from, kept to reuse their storage
+		std::vector<PrefabInstance> mBatch;
+		std::vector<QueuedObject> mBatchObjects;
+		std::vector<SceneNode*> mBatchNodes;
+		// By chunk key, the plan objects that were given a node which has not been unloaded since: it is still in
+		// the scene, or it was collected or destroyed. QueueChunk leaves them out, UnloadFarNodes hands them back
+		// A chunk is dropped once all of its objects are handed back, so only chunks that still have a node out,
+		// or lost one to the player, stay in here
+		std::unordered_map<uint64_t, std::vector<bool>> mPlaced;
+		// Chunks the last update took out of mChunks, for UnloadFarNodes
+		std::vector<uint64_t> mUnloaded;
+
+		static inline int ChunkCoord(float position) { return (int)floor(position / CHUNK_SIZE); }
+		uint32_t ChunkSeed(int x, int z) const;
+
+		// Plan a chunk: a density map of the chunk decides how crowded each part is and what goes there
+		// Touches nothing but its arguments, so any thread can run it
+		void GenerateChunk(int x, int z, std::vector<Object>& objects) const;
+		// The saved plan if there is one, otherwise GenerateChunk
+		void PlanChunk(int x, int z, std::vector<Object>& objects) const;
+		// Clears the grid's objects around the origin and adds the cluster's to cluster
+		void GenerateCluster(const Object& origin, bool isBarnCluster, const glm::vec2& corner, CellGrid& grid, PoissonGenerator::DefaultPRNG& prng, std::vector<Object>& cluster) const;
+		void QueueChunk(const Chunk& chunk);
+		void SpawnQueued(const glm::vec3& center);
+		// Add the instance of a queued object to mBatch
+		void BatchObject(const QueuedObject& queued);
+		void RequestChunk(int x, int z);
+		void UnloadFarNodes(int x, int z);
+		// Delete the streamed nodes in the cells of one chunk
+		void UnloadChunkNodes(int x, int z);
+		// Hand a deleted node's object back to its home chunk's plan
+		void Unplace(const SceneNode* node);
 
-		float density;
-		int cowCount;
-		int enemyCount;
-
-		std::vector<std::vector<std::vector<Object>>> grid;
+	};
 
+	// struct MapGenerator::State
+	// What MapGenerator::ReadState read
+	struct MapGenerator::State {
+		std::unordered_map<uint64_t, ChunkState> chunks;
+		std::vector<QueuedObject> spawnQueue;
+		std::unordered_map<uint64_t, std::vector<bool>> placed;
 	};
 
 }
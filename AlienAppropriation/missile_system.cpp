@@ -0,0 +1,203 @@
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MISSILES_SSE
+#endif
+
+#include "missile_system.h"
+#include "projectile_node.h"
+#include "scene_graph.h"
+
+namespace game {
+
+std::vector<HeatMissileNode*> MissileSystem::mMissiles;
+std::vector<float> MissileSystem::mPosX;
+std::vector<float> MissileSystem::mPosY;
+std::vector<float> MissileSystem::mPosZ;
+std::vector<float> MissileSystem::mVelX;
+std::vector<float> MissileSystem::mVelY;
+std::vector<float> MissileSystem::mVelZ;
+std::vector<float> MissileSystem::mMaxSpeed;
+std::vector<float> MissileSystem::mLife;
+std::vector<float> MissileSystem::mRotW;
+std::vector<float> MissileSystem::mRotX;
+std::vector<float> MissileSystem::mRotY;
+std::vector<float> MissileSystem::mRotZ;
+
+// How hard a missile turns towards its target each tick
+static const float STEERING = 0.2f;
+
+// Smaller squared distances keep the previous orientation, there is no meaningful direction
+static const float MIN_AIM_DISTANCE2 = 0.0001f;
+
+
+// Reference version of the kernel, also used for whatever does not fill a whole vector
+// The orientation is yaw about Y followed by pitch about X, each built from its half angle:
+// cos(a/2) = sqrt((1 + cos a) / 2) and |sin(a/2)| = sqrt((1 - cos a) / 2), so no trigonometry is needed
+static void GuideScalar(const MissileBatch& b, size_t first, size_t last, const glm::vec3& target, float deltaTime)
+{
+	for (size_t i = first; i < last; i++) {
+		float dx = target.x - b.posX[i];
+		float dy = target.y - b.posY[i];
+		float dz = target.z - b.posZ[i];
+
+		float vx = b.velX[i] + STEERING * dx;
+		float vy = b.velY[i] + STEERING * dy;
+		float vz = b.velZ[i] + STEERING * dz;
+		float speed2 = vx * vx + vy * vy + vz * vz;
+		float scale = (speed2 > 1e-12f) ? b.maxSpeed[i] / sqrtf(speed2) : 1.0f;
+		b.velX[i] = vx * scale;
+		b.velY[i] = vy * scale;
+		b.velZ[i] = vz * scale;
+
+		b.life[i] -= deltaTime;
+
+		float flat2 = dx * dx + dz * dz;
+		float dist2 = flat2 + dy * dy;
+		if (dist2 < MIN_AIM_DISTANCE2) continue;
+
+		float flat = sqrtf(flat2);
+		float cosYaw = (flat2 > 1e-12f) ? dz / flat : 1.0f;
+		float cosPitch = flat / sqrtf(dist2);
+
+		float cy = sqrtf(fmaxf(0.0f, (1.0f + cosYaw) * 0.5f));
+		float sy = copysignf(sqrtf(fmaxf(0.0f, (1.0f - cosYaw) * 0.5f)), dx);
+		float cp = sqrtf(fmaxf(0.0f, (1.0f + cosPitch) * 0.5f));
+		float sp = copysignf(sqrtf(fmaxf(0.0f, (1.0f - cosPitch) * 0.5f)), -dy);
+
+		b.rotW[i] = cy * cp;
+		b.rotX[i] = cy * sp;
+		b.rotY[i] = sy * cp;
+		b.rotZ[i] = -sy * sp;
+	}
+}
+
+
+void GuideMissiles(const MissileBatch& b, size_t count, const glm::vec3& target, float deltaTime)
+{
+	size_t i = 0;
+
+#if defined(MISSILES_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 tiny = _mm_set1_ps(1e-12f);
+	const __m128 minAim = _mm_set1_ps(MIN_AIM_DISTANCE2);
+	const __m128 steering = _mm_set1_ps(STEERING);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 dt = _mm_set1_ps(deltaTime);
+	const __m128 tx = _mm_set1_ps(target.x), ty = _mm_set1_ps(target.y), tz = _mm_set1_ps(target.z);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 dx = _mm_sub_ps(tx, _mm_loadu_ps(b.posX + i));
+		__m128 dy = _mm_sub_ps(ty, _mm_loadu_ps(b.posY + i));
+		__m128 dz = _mm_sub_ps(tz, _mm_loadu_ps(b.posZ + i));
+
+		// Steer and keep the speed
+		__m128 vx = _mm_add_ps(_mm_loadu_ps(b.velX + i), _mm_mul_ps(steering, dx));
+		__m128 vy = _mm_add_ps(_mm_loadu_ps(b.velY + i), _mm_mul_ps(steering, dy));
+		__m128 vz = _mm_add_ps(_mm_loadu_ps(b.velZ + i), _mm_mul_ps(steering, dz));
+		__m128 speed2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		__m128 moving = _mm_cmpgt_ps(speed2, tiny);
+		__m128 scale = _mm_div_ps(_mm_loadu_ps(b.maxSpeed + i), _mm_sqrt_ps(_mm_max_ps(speed2, tiny)));
+		scale = _mm_or_ps(_mm_and_ps(moving, scale), _mm_andnot_ps(moving, one));
+		_mm_storeu_ps(b.velX + i, _mm_mul_ps(vx, scale));
+		_mm_storeu_ps(b.velY + i, _mm_mul_ps(vy, scale));
+		_mm_storeu_ps(b.velZ + i, _mm_mul_ps(vz, scale));
+
+		_mm_storeu_ps(b.life + i, _mm_sub_ps(_mm_loadu_ps(b.life + i), dt));
+
+		// Face the target
+		__m128 flat2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+		__m128 dist2 = _mm_add_ps(flat2, _mm_mul_ps(dy, dy));
+		__m128 aim = _mm_cmpge_ps(dist2, minAim);
+		__m128 hasYaw = _mm_cmpgt_ps(flat2, tiny);
+
+		__m128 flat = _mm_sqrt_ps(flat2);
+		__m128 cosYaw = _mm_div_ps(dz, _mm_max_ps(flat, tiny));
+		cosYaw = _mm_or_ps(_mm_and_ps(hasYaw, cosYaw), _mm_andnot_ps(hasYaw, one));
+		__m128 cosPitch = _mm_div_ps(flat, _mm_sqrt_ps(_mm_max_ps(dist2, tiny)));
+
+		__m128 cy = _mm_sqrt_ps(_mm_max_ps(zero, _mm_mul_ps(_mm_add_ps(one, cosYaw), half)));
+		__m128 sy = _mm_sqrt_ps(_mm_max_ps(zero, _mm_mul_ps(_mm_sub_ps(one, cosYaw), half)));
+		sy = _mm_or_ps(sy, _mm_and_ps(dx, signMask));
+		__m128 cp = _mm_sqrt_ps(_mm_max_ps(zero, _mm_mul_ps(_mm_add_ps(one, cosPitch), half)));
+		__m128 sp = _mm_sqrt_ps(_mm_max_ps(zero, _mm_mul_ps(_mm_sub_ps(one, cosPitch), half)));
+		sp = _mm_or_ps(sp, _mm_andnot_ps(dy, signMask));
+
+		__m128 w = _mm_mul_ps(cy, cp);
+		__m128 x = _mm_mul_ps(cy, sp);
+		__m128 y = _mm_mul_ps(sy, cp);
+		__m128 z = _mm_xor_ps(_mm_mul_ps(sy, sp), signMask);
+		_mm_storeu_ps(b.rotW + i, _mm_or_ps(_mm_and_ps(aim, w), _mm_andnot_ps(aim, _mm_loadu_ps(b.rotW + i))));
+		_mm_storeu_ps(b.rotX + i, _mm_or_ps(_mm_and_ps(aim, x), _mm_andnot_ps(aim, _mm_loadu_ps(b.rotX + i))));
+		_mm_storeu_ps(b.rotY + i, _mm_or_ps(_mm_and_ps(aim, y), _mm_andnot_ps(aim, _mm_loadu_ps(b.rotY + i))));
+		_mm_storeu_ps(b.rotZ + i, _mm_or_ps(_mm_and_ps(aim, z), _mm_andnot_ps(aim, _mm_loadu_ps(b.rotZ + i))));
+	}
+#endif
+
+	GuideScalar(b, i, count, target, deltaTime);
+}
+
+
+uint32_t MissileSystem::Register(HeatMissileNode* missile, float maxSpeed, float lifespan)
+{
+	mMissiles.push_back(missile);
+	mPosX.push_back(0.0f); mPosY.push_back(0.0f); mPosZ.push_back(0.0f);
+	mVelX.push_back(0.0f); mVelY.push_back(0.0f); mVelZ.push_back(0.0f);
+	mMaxSpeed.push_back(maxSpeed);
+	mLife.push_back(lifespan);
+	mRotW.push_back(1.0f); mRotX.push_back(0.0f); mRotY.push_back(0.0f); mRotZ.push_back(0.0f);
+	return (uint32_t)mMissiles.size() - 1;
+}
+
+
+void MissileSystem::Unregister(uint32_t slot)
+{
+	// Swap the last missile into the hole. Position and velocity are gathered every tick, the rest has to move
+	size_t last = mMissiles.size() - 1;
+	mMissiles[slot] = mMissiles[last];
+	mMissiles[slot]->mMissileSlot = slot;
+	mMaxSpeed[slot] = mMaxSpeed[last];
+	mLife[slot] = mLife[last];
+	mRotW[slot] = mRotW[last]; mRotX[slot] = mRotX[last]; mRotY[slot] = mRotY[last]; mRotZ[slot] = mRotZ[last];
+
+	mMissiles.pop_back();
+	mPosX.pop_back(); mPosY.pop_back(); mPosZ.pop_back();
+	mVelX.pop_back(); mVelY.pop_back(); mVelZ.pop_back();
+	mMaxSpeed.pop_back();
+	mLife.pop_back();
+	mRotW.pop_back(); mRotX.pop_back(); mRotY.pop_back(); mRotZ.pop_back();
+}
+
+
+void MissileSystem::update(double deltaTime, const glm::vec3& target)
+{
+	size_t count = mMissiles.size();
+
+	for (size_t i = 0; i < count; i++) {
+		HeatMissileNode* missile = mMissiles[i];
+		mPosX[i] = missile->mPosition.x; mPosY[i] = missile->mPosition.y; mPosZ[i] = missile->mPosition.z;
+		mVelX[i] = missile->mVelocity.x; mVelY[i] = missile->mVelocity.y; mVelZ[i] = missile->mVelocity.z;
+	}
+
+	MissileBatch batch;
+	batch.posX = mPosX.data(); batch.posY = mPosY.data(); batch.posZ = mPosZ.data();
+	batch.velX = mVelX.data(); batch.velY = mVelY.data(); batch.velZ = mVelZ.data();
+	batch.maxSpeed = mMaxSpeed.data();
+	batch.life = mLife.data();
+	batch.rotW = mRotW.data(); batch.rotX = mRotX.data(); batch.rotY = mRotY.data(); batch.rotZ = mRotZ.data();
+	GuideMissiles(batch, count, target, (float)deltaTime);
+
+	for (size_t i = 0; i < count; i++) {
+		HeatMissileNode* missile = mMissiles[i];
+		missile->mVelocity = glm::vec3(mVelX[i], mVelY[i], mVelZ[i]);
+		missile->mOrientation = glm::quat(mRotW[i], mRotX[i], mRotY[i], mRotZ[i]);
+
+		// Deletion is queued, so the arrays stay as they are until the tick commits
+		if (mLife[i] <= 0.0f) SceneGraph::deleteNode(missile);
+	}
+}
+
+} // namespace game
@@ -0,0 +1,64 @@
+#ifndef MISSILE_SYSTEM_H_
+#define MISSILE_SYSTEM_H_
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+namespace game {
+
+	class HeatMissileNode;
+
+	// Packed missile state for the guidance kernel
+	struct MissileBatch {
+		const float* posX;
+		const float* posY;
+		const float* posZ;
+		float* velX;
+		float* velY;
+		float* velZ;
+		const float* maxSpeed;
+		float* life;
+		float* rotW; // Output: orientation facing the target, yaw then pitch, no roll
+		float* rotX;
+		float* rotY;
+		float* rotZ;
+	};
+
+	// One guidance step for count missiles chasing target
+	// Velocity turns towards the target and is rescaled to the missile's speed; the orientation points the
+	// missile's +Z at the target. Uses SSE when available, with a scalar loop for the tail
+	void GuideMissiles(const MissileBatch& batch, size_t count, const glm::vec3& target, float deltaTime);
+
+	// class MissileSystem
+	// Steers every live heat seeking missile in one pass per tick
+	// The target is sampled once per tick, lifespans count down on the simulation clock, and missiles
+	// whose life runs out are deleted. Runs before the kinematics pass moves them
+	class MissileSystem {
+
+	public:
+		static const uint32_t NO_SLOT = 0xffffffff;
+
+		static uint32_t Register(HeatMissileNode* missile, float maxSpeed, float lifespan);
+		static void Unregister(uint32_t slot);
+
+		// Simulation thread only
+		static void update(double deltaTime, const glm::vec3& target);
+
+		inline static size_t getCount(void) { return mMissiles.size(); }
+		inline static float getLife(uint32_t slot) { return mLife[slot]; }
+
+	private:
+		static std::vector<HeatMissileNode*> mMissiles;
+		static std::vector<float> mPosX, mPosY, mPosZ;
+		static std::vector<float> mVelX, mVelY, mVelZ;
+		static std::vector<float> mMaxSpeed, mLife;
+		static std::vector<float> mRotW, mRotX, mRotY, mRotZ;
+
+	}; // class MissileSystem
+
+} // namespace game
+
+#endif // MISSILE_SYSTEM_H_
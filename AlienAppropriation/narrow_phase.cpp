@@ -0,0 +1,136 @@
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NARROW_PHASE_SSE
+#endif
+
+#include "narrow_phase.h"
+
+namespace game {
+
+void ShapeBounds(const CollisionShape& shape, glm::vec3& min, glm::vec3& max)
+{
+	glm::vec3 half(shape.radius);
+	for (int k = 0; k < 3; k++) {
+		half += glm::abs(shape.axis[k]) * shape.extent[k];
+	}
+	min = shape.center - half;
+	max = shape.center + half;
+}
+
+
+// The closest point of the box to the sphere's centre is found in the box's frame: along each axis the
+// centre is outside by max(|offset| - extent, 0). The rounding radius then just adds to the sphere's
+float SphereSeparation(const glm::vec3& center, float radius, const CollisionShape& shape)
+{
+	glm::vec3 offset = center - shape.center;
+	glm::vec3 outside;
+	for (int k = 0; k < 3; k++) {
+		outside[k] = fmaxf(fabsf(glm::dot(offset, shape.axis[k])) - shape.extent[k], 0.0f);
+	}
+	return sqrtf(glm::dot(outside, outside)) - (radius + shape.radius);
+}
+
+
+// Conservative advancement: the sphere can move as far as its separation without touching the shape,
+// so step by that much until the gap closes or the move runs out. Converges in a few steps unless the
+// sphere only grazes the shape
+static const int SWEEP_ITERATIONS = 32;
+static const float SWEEP_TOLERANCE = 0.001f;
+
+float SweepSphere(const glm::vec3& start, const glm::vec3& end, float radius, const CollisionShape& shape)
+{
+	glm::vec3 move = end - start;
+	float length = sqrtf(glm::dot(move, move));
+
+	float t = 0.0f;
+	for (int i = 0; i < SWEEP_ITERATIONS; i++) {
+		float separation = SphereSeparation(start + move * t, radius, shape);
+		if (separation < SWEEP_TOLERANCE) return t;
+		if (length < SWEEP_TOLERANCE) break;
+
+		t += separation / length;
+		if (t > 1.0f) break;
+	}
+	return 2.0f;
+}
+
+
+void ShapeBatch::clear(void)
+{
+	for (int c = 0; c < 3; c++) {
+		mCenter[c].clear();
+		mExtent[c].clear();
+	}
+	for (int c = 0; c < 9; c++) {
+		mAxis[c].clear();
+	}
+	mRadius.clear();
+}
+
+
+void ShapeBatch::add(const CollisionShape& shape)
+{
+	for (int c = 0; c < 3; c++) {
+		mCenter[c].push_back(shape.center[c]);
+		mExtent[c].push_back(shape.extent[c]);
+	}
+	for (int k = 0; k < 3; k++) {
+		for (int c = 0; c < 3; c++) {
+			mAxis[k * 3 + c].push_back(shape.axis[k][c]);
+		}
+	}
+	mRadius.push_back(shape.radius);
+}
+
+
+void ShapeBatch::testSphere(const glm::vec3& center, float radius, float* separation) const
+{
+	size_t count = size();
+	size_t i = 0;
+
+#ifdef NARROW_PHASE_SSE
+	const __m128 px = _mm_set1_ps(center.x);
+	const __m128 py = _mm_set1_ps(center.y);
+	const __m128 pz = _mm_set1_ps(center.z);
+	const __m128 pr = _mm_set1_ps(radius);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 dx = _mm_sub_ps(px, _mm_loadu_ps(&mCenter[0][i]));
+		__m128 dy = _mm_sub_ps(py, _mm_loadu_ps(&mCenter[1][i]));
+		__m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(&mCenter[2][i]));
+
+		__m128 dist2 = zero;
+		for (int k = 0; k < 3; k++) {
+			__m128 local = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(dx, _mm_loadu_ps(&mAxis[k * 3 + 0][i])),
+				_mm_mul_ps(dy, _mm_loadu_ps(&mAxis[k * 3 + 1][i]))),
+				_mm_mul_ps(dz, _mm_loadu_ps(&mAxis[k * 3 + 2][i])));
+			__m128 outside = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(signBit, local), _mm_loadu_ps(&mExtent[k][i])), zero);
+			dist2 = _mm_add_ps(dist2, _mm_mul_ps(outside, outside));
+		}
+
+		__m128 reach = _mm_add_ps(pr, _mm_loadu_ps(&mRadius[i]));
+		_mm_storeu_ps(separation + i, _mm_sub_ps(_mm_sqrt_ps(dist2), reach));
+	}
+#endif
+
+	for (; i < count; i++) {
+		float dx = center.x - mCenter[0][i];
+		float dy = center.y - mCenter[1][i];
+		float dz = center.z - mCenter[2][i];
+
+		float dist2 = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			float local = dx * mAxis[k * 3 + 0][i] + dy * mAxis[k * 3 + 1][i] + dz * mAxis[k * 3 + 2][i];
+			float outside = fmaxf(fabsf(local) - mExtent[k][i], 0.0f);
+			dist2 += outside * outside;
+		}
+		separation[i] = sqrtf(dist2) - (radius + mRadius[i]);
+	}
+}
+
+} // namespace game
@@ -0,0 +1,57 @@
+#ifndef NARROW_PHASE_H_
+#define NARROW_PHASE_H_
+
+#include <vector>
+#include <stddef.h>
+
+#include <glm/glm.hpp>
+
+namespace game {
+
+	// A collision volume in world space: the box around center with the given axes and half extents,
+	// grown by radius in every direction. Each CollisionType is one of these:
+	//   Point        no extent, just a radius (a sphere)
+	//   Capsule      extent along its long axis only, plus a radius
+	//   AlignedBox   world axes, no radius
+	//   OrientedBox  the node's own axes, no radius
+	struct CollisionShape {
+		glm::vec3 center;
+		glm::vec3 axis[3]; // Unit length and orthogonal
+		glm::vec3 extent;  // Half size along each axis
+		float radius;
+	};
+
+	// World space box around a shape
+	void ShapeBounds(const CollisionShape& shape, glm::vec3& min, glm::vec3& max);
+
+	// Distance between the surfaces of a sphere and a shape, negative when they overlap
+	float SphereSeparation(const glm::vec3& center, float radius, const CollisionShape& shape);
+
+	// Continuous test for a sphere moving from start to end against a shape that stays put
+	// Returns the fraction of the move at which they first touch, or more than 1 if they never do
+	float SweepSphere(const glm::vec3& start, const glm::vec3& end, float radius, const CollisionShape& shape);
+
+	// class ShapeBatch
+	// Candidate shapes packed one array per component, so one shape can be tested against all of them at once
+	class ShapeBatch {
+
+	public:
+		void clear(void);
+		void add(const CollisionShape& shape);
+		inline size_t size(void) const { return mRadius.size(); }
+
+		// Separation between a sphere and every shape in the batch, as SphereSeparation
+		// Uses SSE when available, with a scalar loop for the tail
+		void testSphere(const glm::vec3& center, float radius, float* separation) const;
+
+	private:
+		std::vector<float> mCenter[3];
+		std::vector<float> mAxis[9]; // Axis k component c is mAxis[k * 3 + c]
+		std::vector<float> mExtent[3];
+		std::vector<float> mRadius;
+
+	}; // class ShapeBatch
+
+} // namespace game
+
+#endif // NARROW_PHASE_H_
@@ -0,0 +1,75 @@
+#include <new>
+
+#include "node_pool.h"
+
+namespace game {
+
+std::mutex NodePool::mMutex;
+NodePool::FreeSlot* NodePool::mFree[NodePool::CLASS_COUNT];
+size_t NodePool::mFreeCount[NodePool::CLASS_COUNT];
+std::vector<char*> NodePool::mSlabs;
+
+
+void* NodePool::Allocate(size_t size)
+{
+	if (size > MAX_SIZE) return ::operator new(size);
+
+	size_t sizeClass = SizeClass(size);
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mFree[sizeClass]) {
+		AddSlab(sizeClass, SLAB_SLOTS);
+	}
+	FreeSlot* slot = mFree[sizeClass];
+	mFree[sizeClass] = slot->next;
+	mFreeCount[sizeClass]--;
+	return slot;
+}
+
+
+void NodePool::Free(void* slot, size_t size)
+{
+	if (!slot) return;
+	if (size > MAX_SIZE) {
+		::operator delete(slot);
+		return;
+	}
+
+	size_t sizeClass = SizeClass(size);
+	std::lock_guard<std::mutex> lock(mMutex);
+	FreeSlot* freed = static_cast<FreeSlot*>(slot);
+	freed->next = mFree[sizeClass];
+	mFree[sizeClass] = freed;
+	mFreeCount[sizeClass]++;
+}
+
+
+void NodePool::Reserve(size_t size, size_t count)
+{
+	if (size > MAX_SIZE) return;
+
+	size_t sizeClass = SizeClass(size);
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mFreeCount[sizeClass] < count) {
+		AddSlab(sizeClass, count - mFreeCount[sizeClass]);
+	}
+}
+
+
+// Called with the lock held
+void NodePool::AddSlab(size_t sizeClass, size_t slots)
+{
+	size_t slotSize = (sizeClass + 1) * GRANULE;
+	// operator new aligns for any type, and slots are a multiple of GRANULE apart
+	char* slab = static_cast<char*>(::operator new(slotSize * slots));
+	mSlabs.push_back(slab);
+
+	// Thread the slots so they are handed out in address order
+	for (size_t i = slots; i-- > 0; ) {
+		FreeSlot* slot = reinterpret_cast<FreeSlot*>(slab + i * slotSize);
+		slot->next = mFree[sizeClass];
+		mFree[sizeClass] = slot;
+	}
+	mFreeCount[sizeClass] += slots;
+}
+
+} // namespace game
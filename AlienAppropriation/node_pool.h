@@ -0,0 +1,50 @@
+#ifndef NODE_POOL_H_
+#define NODE_POOL_H_
+
+#include <vector>
+#include <mutex>
+#include <stddef.h>
+
+namespace game {
+
+	// class NodePool
+	// Storage every node is made in, see BaseNode's operator new. Nodes are sorted by size into classes of
+	// GRANULE bytes, each a free list of slots carved out of slabs, so creating and deleting nodes all game long
+	// reuses the same memory instead of going to the heap each time. Slabs are never given back
+	// Anything larger than MAX_SIZE goes to the heap as usual
+	class NodePool {
+
+	public:
+		static const size_t GRANULE = 16;
+		static const size_t MAX_SIZE = 2048;
+		// Slots added to a class when it runs dry
+		static const size_t SLAB_SLOTS = 64;
+
+		static void* Allocate(size_t size);
+		static void Free(void* slot, size_t size);
+
+		// Make sure count nodes of size can be made without adding a slab, before spawning many at once
+		static void Reserve(size_t size, size_t count);
+
+	private:
+		struct FreeSlot {
+			FreeSlot* next;
+		};
+
+		static const size_t CLASS_COUNT = MAX_SIZE / GRANULE;
+
+		// Nodes are made on the main thread during setup and the simulation thread after, but the lock costs
+		// next to nothing when nobody else holds it
+		static std::mutex mMutex;
+		static FreeSlot* mFree[CLASS_COUNT];
+		static size_t mFreeCount[CLASS_COUNT];
+		static std::vector<char*> mSlabs;
+
+		static inline size_t SizeClass(size_t size) { return (size + GRANULE - 1) / GRANULE - 1; }
+		static void AddSlab(size_t sizeClass, size_t slots);
+
+	}; // class NodePool
+
+} // namespace game
+
+#endif // NODE_POOL_H_
@@ -29,7 +29,7 @@ namespace game
 
 		void rotateByCamera();
 
-		virtual void draw(SceneNode* camera, glm::mat4 parentTransf = glm::mat4(1.0));
+		virtual void extract(RenderSnapshot& snapshot, const NodeTransform& parent);
 		virtual void update(double deltaTime);
 
 		void setPlayerPosition();
@@ -47,6 +47,14 @@ namespace game
 		void takeDamage(DamageType);
 		void dropBomb();
 		void addCollected(std::string type);
+		// Drop everything collected, orbiting nodes and counts
+		void clearCollected();
+		// Replace what was collected with cows and hay, orbiting in turn as if they had been collected one by one,
+		// without a log line for each. For snapshots
+		void restoreCollected(int cows, int hay);
+		inline float* getEnergy() { return energy; }
+		inline int getCowsCollected() const { return cowsCollected; }
+		inline int getHayCollected() const { return hayCollected; }
 
 		inline void addEnergy(float f) { *energy += f; }
 		inline void addHealth(float f) { *hull_strength += f; }
@@ -67,7 +75,8 @@ namespace game
 
 		int bombCounter = 0;
 
-		void SetupShader(GLuint program, glm::mat4& parentTransf = glm::mat4(1.0));
+		// Count one more of type and add its node, orbiting at slot
+		void AddOrbiting(const std::string& type, float slot);
 
 		
 		std::vector<SceneNode*> weapons;		
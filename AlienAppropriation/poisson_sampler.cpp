@@ -0,0 +1,243 @@
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "poisson_sampler.h"
+
+namespace game {
+
+// A tile's own random sequence (xorshift), started from the seed and the tile
+class TileRandom {
+
+public:
+	TileRandom(uint32_t seed, int x, int z)
+	{
+		uint32_t h = seed * 0x9e3779b9u ^ (uint32_t)x * 0x85ebca6bu ^ (uint32_t)z * 0xc2b2ae35u;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		mState = h ? h : 1;
+	}
+
+	// In [0, 1)
+	inline float next(void)
+	{
+		mState ^= mState << 13;
+		mState ^= mState >> 17;
+		mState ^= mState << 5;
+		return (mState >> 8) * (1.0f / 16777216.0f);
+	}
+
+	inline size_t nextIndex(size_t count) { return std::min((size_t)(next() * count), count - 1); }
+
+private:
+	uint32_t mState;
+
+}; // class TileRandom
+
+
+// One point per cell at most, since a cell's diagonal is the smallest minDist
+struct SampleGrid {
+	int width;
+	int height;
+	float cellSize;
+	int reach; // Cells out to the largest minDist
+	bool fixedMinDist; // No spacing raster: every point wants the base minDist
+	std::vector<glm::vec2> points;
+	std::vector<char> filled;
+
+	inline int cellX(float x) const { return std::min((int)(x / cellSize), width - 1); }
+	inline int cellZ(float z) const { return std::min((int)(z / cellSize), height - 1); }
+
+	bool fits(const glm::vec2& p, float minDist2) const
+	{
+		int cx = cellX(p.x), cz = cellZ(p.y);
+		if (filled[cz * width + cx]) return false;
+
+		for (int z = std::max(cz - reach, 0); z <= std::min(cz + reach, height - 1); z++) {
+			for (int x = std::max(cx - reach, 0); x <= std::min(cx + reach, width - 1); x++) {
+				// With a fixed minDist, anything in a corner cell is at least a cell's diagonal, minDist, away
+				// A spacing raster can ask for more than that while reach is still 2, so then they are checked too
+				if (fixedMinDist && reach == 2 && abs(x - cx) == 2 && abs(z - cz) == 2) continue;
+				int cell = z * width + x;
+				if (!filled[cell]) continue;
+				glm::vec2 d = points[cell] - p;
+				if (d.x * d.x + d.y * d.y < minDist2) return false;
+			}
+		}
+		return true;
+	}
+
+	inline void insert(const glm::vec2& p)
+	{
+		int cell = cellZ(p.y) * width + cellX(p.x);
+		points[cell] = p;
+		filled[cell] = 1;
+	}
+};
+
+
+struct SampleArea {
+	float width;
+	float height;
+	float minDist;
+	int attempts;
+	bool inCircle;
+	glm::vec2 center;
+	float radius2;
+	const float* spacing;
+	int spacingSize;
+	int tileCells;
+	int seamCells;
+
+	inline bool contains(const glm::vec2& p) const
+	{
+		if (!inCircle) return true;
+		glm::vec2 d = p - center;
+		return d.x * d.x + d.y * d.y < radius2;
+	}
+
+	// minDist where p is
+	inline float minDistAt(const glm::vec2& p) const
+	{
+		if (!spacing) return minDist;
+		int x = std::min(std::max((int)(p.x / width * spacingSize), 0), spacingSize - 1);
+		int z = std::min(std::max((int)(p.y / height * spacingSize), 0), spacingSize - 1);
+		return minDist * spacing[z * spacingSize + x];
+	}
+};
+
+
+static void FillTile(SampleGrid& grid, const SampleArea& area, uint32_t seed, int tx, int tz, std::vector<glm::vec2>& out)
+{
+	int x0 = tx * area.tileCells;
+	int z0 = tz * area.tileCells;
+	int x1 = std::min(x0 + area.tileCells, grid.width);
+	int z1 = std::min(z0 + area.tileCells, grid.height);
+	float minX = x0 * grid.cellSize, maxX = std::min(x1 * grid.cellSize, area.width);
+	float minZ = z0 * grid.cellSize, maxZ = std::min(z1 * grid.cellSize, area.height);
+
+	TileRandom random(seed, tx, tz);
+	std::vector<glm::vec2> active;
+
+	// Carry on from what the neighbours made near the border
+	for (int z = std::max(z0 - area.seamCells, 0); z < std::min(z1 + area.seamCells, grid.height); z++) {
+		for (int x = std::max(x0 - area.seamCells, 0); x < std::min(x1 + area.seamCells, grid.width); x++) {
+			bool inside = x >= x0 && x < x1 && z >= z0 && z < z1;
+			if (!inside && grid.filled[z * grid.width + x]) {
+				active.push_back(grid.points[z * grid.width + x]);
+			}
+		}
+	}
+
+	if (active.empty()) {
+		for (int i = 0; i < area.attempts; i++) {
+			glm::vec2 p(minX + random.next() * (maxX - minX), minZ + random.next() * (maxZ - minZ));
+			float minDist = area.minDistAt(p);
+			if (area.contains(p) && grid.fits(p, minDist * minDist)) {
+				grid.insert(p);
+				out.push_back(p);
+				active.push_back(p);
+				break;
+			}
+		}
+	}
+
+	while (!active.empty()) {
+		size_t i = random.nextIndex(active.size());
+		glm::vec2 p = active[i];
+		float reach = area.minDistAt(p);
+
+		bool placed = false;
+		for (int k = 0; k < area.attempts && !placed; k++) {
+			// Between p's minDist and twice that from p
+			float angle = random.next() * glm::two_pi<float>();
+			float distance = reach * (1.0f + random.next());
+			glm::vec2 q = p + distance * glm::vec2(cosf(angle), sinf(angle));
+
+			if (q.x < minX || q.x >= maxX || q.y < minZ || q.y >= maxZ) continue;
+			// q keeps the spacing wanted where it is
+			float minDist = area.minDistAt(q);
+			if (!area.contains(q) || !grid.fits(q, minDist * minDist)) continue;
+
+			grid.insert(q);
+			out.push_back(q);
+			active.push_back(q);
+			placed = true;
+		}
+
+		if (!placed) {
+			active[i] = active.back();
+			active.pop_back();
+		}
+	}
+}
+
+
+void PoissonSampler::Sample(float width, float height, float minDist, uint32_t seed, WorkerPool& pool,
+	std::vector<glm::vec2>& points, int attempts, bool inCircle, const float* spacing, int spacingSize)
+{
+	points.clear();
+	if (width <= 0.0f || height <= 0.0f || minDist <= 0.0f) return;
+
+	float largest = 1.0f;
+	if (spacing) {
+		largest = std::max(*std::max_element(spacing, spacing + spacingSize * spacingSize), 1.0f);
+	}
+
+	SampleGrid grid;
+	grid.cellSize = minDist / sqrtf(2.0f);
+	grid.width = std::max((int)ceilf(width / grid.cellSize), 1);
+	grid.height = std::max((int)ceilf(height / grid.cellSize), 1);
+	grid.reach = (int)ceilf(largest * sqrtf(2.0f) - 0.001f);
+	grid.reach = std::max(grid.reach, 2);
+	grid.fixedMinDist = spacing == NULL;
+	grid.points.resize((size_t)grid.width * grid.height);
+	grid.filled.assign((size_t)grid.width * grid.height, 0);
+
+	SampleArea area;
+	area.width = width;
+	area.height = height;
+	area.minDist = minDist;
+	area.attempts = attempts;
+	area.inCircle = inCircle;
+	area.center = glm::vec2(width, height) * 0.5f;
+	area.radius2 = 0.25f * std::min(width, height) * std::min(width, height);
+	area.spacing = spacing;
+	area.spacingSize = spacingSize;
+	// Neighbours' points are carried on from out to twice the largest minDist. Tiles grow past that, so
+	// same-phase tiles still never see each other's points
+	area.seamCells = 2 * grid.reach;
+	area.tileCells = std::max(TILE_CELLS, area.seamCells + grid.reach + 1);
+
+	int tilesX = (grid.width + area.tileCells - 1) / area.tileCells;
+	int tilesZ = (grid.height + area.tileCells - 1) / area.tileCells;
+	std::vector<std::vector<glm::vec2>> tilePoints((size_t)tilesX * tilesZ);
+
+	if (tilesX * tilesZ == 1) {
+		FillTile(grid, area, seed, 0, 0, points);
+		return;
+	}
+
+	std::vector<int> phase;
+	for (int p = 0; p < 4; p++) {
+		phase.clear();
+		for (int tz = p >> 1; tz < tilesZ; tz += 2) {
+			for (int tx = p & 1; tx < tilesX; tx += 2) {
+				phase.push_back(tz * tilesX + tx);
+			}
+		}
+		pool.parallelFor(phase.size(), [&](size_t i) {
+			int tile = phase[i];
+			FillTile(grid, area, seed, tile % tilesX, tile / tilesX, tilePoints[tile]);
+		});
+	}
+
+	for (const std::vector<glm::vec2>& tile : tilePoints) {
+		points.insert(points.end(), tile.begin(), tile.end());
+	}
+}
+
+} // namespace game
@@ -0,0 +1,42 @@
+#ifndef POISSON_SAMPLER_H_
+#define POISSON_SAMPLER_H_
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "worker_pool.h"
+
+namespace game {
+
+	// class PoissonSampler
+	// Poisson disk sampling (Bridson's dart throwing) split into square tiles that are filled in parallel
+	// Tiles are filled in four phases by the parity of their coordinates, so two tiles that touch never run at
+	// the same time: a tile only reads points its neighbours made in earlier phases, and carries on from the
+	// ones near its border so there are no seams. Every tile has its own random sequence from the seed, so the
+	// result does not depend on how many threads there are
+	class PoissonSampler {
+
+	public:
+		// Side of a tile, in grid cells of minDist / sqrt(2). Neighbour checks reach two cells and seams
+		// four, so same-phase tiles, a whole tile apart, never see each other's points. Tiles are made larger
+		// when a spacing raster stretches those reaches
+		static const int TILE_CELLS = 16;
+
+		// Fill [0, width) x [0, height) with points no closer than minDist, until attempts tries around every
+		// point have failed. With inCircle, only the disc inscribed in the area is filled
+		// spacing, if given, is a spacingSize by spacingSize raster over the area, one row of x per z, that
+		// scales minDist where it is wanted sparser. Its values are at least 1
+		// Points come out tile by tile in a fixed order
+		static void Sample(float width, float height, float minDist, uint32_t seed, WorkerPool& pool,
+			std::vector<glm::vec2>& points, int attempts = 30, bool inCircle = false,
+			const float* spacing = NULL, int spacingSize = 0);
+
+	}; // class PoissonSampler
+
+} // namespace game
+
+#endif // POISSON_SAMPLER_H_
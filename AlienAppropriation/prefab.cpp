@@ -0,0 +1,66 @@
+#include "prefab.h"
+#include "resource_manager.h"
+#include "scene_graph.h"
+
+namespace game {
+
+std::vector<Prefab> Prefabs::mPrefabs;
+std::vector<std::string> Prefabs::mNames;
+std::vector<std::string> Prefabs::mTags;
+
+
+static const Resource* FindResource(const std::string& prefab, const std::string& name)
+{
+	Resource* resource = ResourceManager::getResource(name);
+	if (!resource) {
+		throw(GameException(std::string("Could not find resource \"") + name + std::string("\" for prefab \"") + prefab + std::string("\"")));
+	}
+	return resource;
+}
+
+
+PrefabId Prefabs::Compile(const PrefabDef& def, SceneNode* (*construct)(const std::string&, const Prefab&), size_t nodeSize)
+{
+	if (find(def.name) != NO_PREFAB) {
+		throw(GameException(std::string("Prefab \"") + def.name + std::string("\" is defined twice")));
+	}
+	if (mPrefabs.size() >= NO_PREFAB) {
+		throw(GameException(std::string("Too many prefabs")));
+	}
+
+	Prefab prefab;
+	prefab.construct = construct;
+	prefab.nodeSize = nodeSize;
+	prefab.geometry = FindResource(def.name, def.mesh);
+	prefab.material = FindResource(def.name, def.material);
+	prefab.texture = def.texture.empty() ? NULL : FindResource(def.name, def.texture);
+	prefab.scale = def.scale;
+	prefab.orientation = def.orientation;
+	prefab.offset = def.offset;
+	prefab.layer = def.layer;
+	prefab.shape = def.shape;
+	prefab.firstTag = (uint32_t)mTags.size();
+	prefab.tagCount = (uint32_t)def.tags.size();
+	mTags.insert(mTags.end(), def.tags.begin(), def.tags.end());
+
+	mPrefabs.push_back(prefab);
+	mNames.push_back(def.name);
+	return (PrefabId)(mPrefabs.size() - 1);
+}
+
+
+PrefabId Prefabs::find(const std::string& name)
+{
+	for (size_t i = 0; i < mNames.size(); i++) {
+		if (mNames[i] == name) return (PrefabId)i;
+	}
+	return NO_PREFAB;
+}
+
+
+void Prefabs::Reserve(PrefabId id, size_t count)
+{
+	NodePool::Reserve(mPrefabs[id].nodeSize, count);
+}
+
+} // namespace game
@@ -0,0 +1,102 @@
+#ifndef PREFAB_H_
+#define PREFAB_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+#include "scene_node.h"
+#include "node_pool.h"
+
+namespace game {
+
+	// struct PrefabDef
+	// One kind of node as it is written down: its resources by name and how it starts out
+	struct PrefabDef {
+		std::string name;
+		std::string mesh;
+		std::string material;
+		std::string texture; // Empty for none
+		std::vector<std::string> tags;
+		glm::vec3 scale = glm::vec3(1.0f);
+		glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); // Turned by the spawn's own orientation
+		glm::vec3 offset = glm::vec3(0.0f); // Added to the spawn position, in world space
+		CollisionLayer layer = LayerScenery;
+		CollisionType shape = Point;
+	};
+
+	// struct Prefab
+	// A PrefabDef compiled: the resources found once, and the tags in the Prefabs tag table
+	struct Prefab {
+		SceneNode* (*construct)(const std::string& name, const Prefab& prefab);
+		size_t nodeSize; // Of the node type, for NodePool::Reserve
+		const Resource* geometry;
+		const Resource* material;
+		const Resource* texture;
+		glm::vec3 scale;
+		glm::quat orientation;
+		glm::vec3 offset;
+		CollisionLayer layer;
+		CollisionType shape;
+		uint32_t firstTag;
+		uint32_t tagCount;
+	};
+
+	// struct PrefabInstance
+	// One node to make from a prefab, see SceneGraph::SpawnBatch
+	struct PrefabInstance {
+		PrefabId prefab;
+		std::string name;
+		glm::vec3 position;
+		glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); // On top of the prefab's
+		glm::vec3 scale = glm::vec3(1.0f); // Times the prefab's
+	};
+
+	// class Prefabs
+	// Every prefab there is, by PrefabId. Define them all once the resources are loaded and before the
+	// simulation starts; from then on they are only read, so any thread may look them up
+	// Spawn nodes from them with SceneGraph::Spawn or SceneGraph::SpawnBatch
+	class Prefabs {
+
+	public:
+		static const PrefabId NO_PREFAB = 0xffff;
+
+		// Compile def into a prefab that makes a T. Throws if a resource is missing or the name is taken
+		template<class T> static PrefabId Define(const PrefabDef& def)
+		{
+			return Compile(def, &Construct<T>, sizeof(T));
+		}
+
+		// NO_PREFAB if there is none of that name
+		static PrefabId find(const std::string& name);
+
+		inline static const Prefab& get(PrefabId id) { return mPrefabs[id]; }
+		inline static size_t getCount(void) { return mPrefabs.size(); }
+		inline static const std::string& getName(PrefabId id) { return mNames[id]; }
+		inline static const std::string& getTag(uint32_t index) { return mTags[index]; }
+
+		// Make room for count more nodes of the prefab up front, so spawning them never adds to the pool
+		static void Reserve(PrefabId id, size_t count);
+
+	private:
+		static std::vector<Prefab> mPrefabs;
+		static std::vector<std::string> mNames;
+		static std::vector<std::string> mTags;
+
+		template<class T> static SceneNode* Construct(const std::string& name, const Prefab& prefab)
+		{
+			return new T(name, prefab.geometry, prefab.material, prefab.texture);
+		}
+
+		static PrefabId Compile(const PrefabDef& def, SceneNode* (*construct)(const std::string&, const Prefab&), size_t nodeSize);
+
+	}; // class Prefabs
+
+} // namespace game
+
+#endif // PREFAB_H_
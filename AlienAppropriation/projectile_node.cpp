@@ -3,6 +3,7 @@
 #include "projectile_node.h"
 #include "player_node.h"
 #include "scene_graph.h"
+#include "missile_system.h"
 
 
 #include <typeinfo>
@@ -15,7 +16,7 @@ namespace game
 ProjectileNode::ProjectileNode(std::string name, const Resource *geometry, const Resource *material, float lifespan, glm::vec3 initialPos, glm::vec3 initialVelocityVec, const Resource *texture /*= NULL*/)
 	: EntityNode(name, geometry, material, texture)
 	, mRemainingLife(lifespan)
-	, mLastTime(glfwGetTime())
+	, mLastPosition(initialPos)
 {
 	addTag("projectile");
 }
@@ -29,28 +30,33 @@ ProjectileNode::~ProjectileNode()
 
 void ProjectileNode::update(double deltaTime)
 {
+	mLastPosition = mPosition;
 	EntityNode::update(deltaTime);
 
 	// Check to see if the projectile is still alive, if not destroy it
-	double currentTime = glfwGetTime();
-	if ((currentTime - mLastTime) > 0.05) 
-	{
-		mRemainingLife -= (currentTime - mLastTime);
-		mLastTime = currentTime;
-	}
+	mRemainingLife -= deltaTime;
 
 	if (mRemainingLife <= 0.0f)
 	{
-		addTag("delete");
+		SceneGraph::deleteNode(this);
 	}
 }
 
+void ProjectileNode::getCollisionBounds(glm::vec3& min, glm::vec3& max)
+{
+	SceneNode::getCollisionBounds(min, max);
+	glm::vec3 back = mLastPosition - getPosition();
+	min = glm::min(min, min + back);
+	max = glm::max(max, max + back);
+}
+
 HeatMissileNode::HeatMissileNode(std::string name, const Resource *geometry, const Resource *material, float lifespan, glm::vec3 initialPos, glm::vec3 initialVelocityVec, const Resource *texture /*= NULL*/)
 	:ProjectileNode(name, geometry, material, lifespan, initialPos, initialVelocityVec, texture)
 {
 	mPosition = initialPos;
 	mVelocity = initialVelocityVec;
 	mMaxVelocity = glm::length(initialVelocityVec);
+	mMissileSlot = MissileSystem::Register(this, mMaxVelocity, lifespan);
 }
 
 HeatMissileNode::~HeatMissileNode()
@@ -60,16 +66,23 @@ HeatMissileNode::~HeatMissileNode()
 
 void HeatMissileNode::update(double deltaTime)
 {
-	ProjectileNode::update(deltaTime);
-
-	// Get the player pos
-	glm::vec3 playerPos = SceneGraph::getPlayerNode()->getPosition();
+	// Skip the projectile lifespan, the missile system counts it down
+	mLastPosition = mPosition;
+	EntityNode::update(deltaTime);
+}
 
-	glm::vec3 dirPlayer = playerPos - mPosition;
-	rotate(dirPlayer);
+float HeatMissileNode::getRemainingLife(void) const
+{
+	return (mMissileSlot != MissileSystem::NO_SLOT) ? MissileSystem::getLife(mMissileSlot) : 0.0f;
+}
 
-	mVelocity += 0.2f * dirPlayer;
-	mVelocity = mMaxVelocity * glm::normalize(mVelocity);
+void HeatMissileNode::onDeleted(void)
+{
+	if (mMissileSlot != MissileSystem::NO_SLOT) {
+		MissileSystem::Unregister(mMissileSlot);
+		mMissileSlot = MissileSystem::NO_SLOT;
+	}
+	ProjectileNode::onDeleted();
 }
 
 }
\ No newline at end of file
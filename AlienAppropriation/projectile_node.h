@@ -16,25 +16,38 @@ namespace game
 		~ProjectileNode();
 
 		virtual void update(double deltaTime);
+
+		// Where the projectile was before this tick's move
+		inline glm::vec3 getLastPosition(void) const { return mLastPosition; }
+
+		// Covers the whole of the last move, so the broad phase finds anything the projectile passed through
+		virtual void getCollisionBounds(glm::vec3& min, glm::vec3& max);
 	
 	protected:
 		float mRemainingLife;
-		float mLastTime;
+		glm::vec3 mLastPosition;
 
 	};
 
 
+	// Homes in on the player. Steering and lifespan are handled for all missiles at once by the MissileSystem
 	class HeatMissileNode : public ProjectileNode
 	{
+		friend class MissileSystem;
+
 	public:
 		HeatMissileNode(std::string name, const Resource *geometry, const Resource *material, float lifespan, glm::vec3 initialPos, glm::vec3 initialVelocityVec, const Resource *texture = nullptr);
 		~HeatMissileNode();
 
 		virtual void update(double deltaTime);
+		virtual void onDeleted(void);
+		// Seconds until it runs out
+		float getRemainingLife(void) const;
 	private:
 
 
 		float mMaxVelocity;
+		uint32_t mMissileSlot;
 	};
 
 
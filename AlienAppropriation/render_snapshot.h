@@ -0,0 +1,68 @@
+#ifndef RENDER_SNAPSHOT_H_
+#define RENDER_SNAPSHOT_H_
+
+#include <vector>
+#include <stdint.h>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+
+namespace game {
+
+	// struct NodeTransform
+	// World space frame handed from a node to its children while a snapshot is extracted
+	// Scale is not part of it since scaling only ever applies to the node itself
+	struct NodeTransform {
+		glm::vec3 position;
+		glm::quat orientation;
+	};
+
+	// struct RenderItem
+	// Everything needed to draw one node, copied out of the scene graph at the end of a tick
+	struct RenderItem {
+		uint32_t id; // Node id, used to find the same node in the previous snapshot
+
+		// World transform
+		glm::vec3 position;
+		glm::quat orientation;
+		glm::vec3 scale;
+
+		// Material keys and geometry
+		GLenum mode;
+		GLuint arrayBuffer;
+		GLuint elementArrayBuffer;
+		GLsizei size;
+		GLuint material;
+		GLuint texture;
+		GLuint envmap;
+	};
+
+	// struct RenderView
+	// Camera state at the end of a tick
+	struct RenderView {
+		glm::vec3 position;
+		glm::quat orientation;
+		glm::vec3 forward; // Initial forward and side vectors set by Camera::SetView
+		glm::vec3 side;
+		glm::vec3 playerOffset; // Player position relative to the camera
+		bool thirdPerson;
+	};
+
+	// struct RenderSnapshot
+	// Immutable picture of the scene produced by the simulation thread once per tick
+	// Only visible nodes are listed, in draw order
+	struct RenderSnapshot {
+		uint64_t tick;
+		double time; // Simulation time the snapshot was taken at
+		glm::vec3 background;
+		RenderView view;
+		std::vector<RenderItem> items;
+
+		RenderSnapshot() : tick(0), time(0.0) {}
+	};
+
+} // namespace game
+
+#endif // RENDER_SNAPSHOT_H_
@@ -0,0 +1,202 @@
+#include <algorithm>
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "renderer.h"
+#include "camera.h"
+#include "terrain.h"
+
+namespace game {
+
+Renderer::Renderer(void)
+	: mProjectionMatrix(1.0)
+	, mTerrainHeightMap(0)
+	, mTerrainCellSize(1.0f)
+{
+}
+
+
+Renderer::~Renderer()
+{
+}
+
+
+void Renderer::SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h){
+
+    // Set projection based on field-of-view
+    float top = tan((fov/2.0)*(glm::pi<float>()/180.0))*near;
+    float right = top * w/h;
+    mProjectionMatrix = glm::frustum(-right, right, -top, top, near, far);
+}
+
+
+void Renderer::SetTerrain(GLuint heightMap, float cellSize)
+{
+	mTerrainHeightMap = heightMap;
+	mTerrainCellSize = cellSize;
+}
+
+
+void Renderer::Submit(const RenderSnapshot& snapshot)
+{
+	// The current snapshot becomes the previous one, reusing the storage of the old previous
+	std::swap(mPrevious, mCurrent);
+	mCurrent = snapshot;
+
+	mPreviousIndex.clear();
+	for (uint32_t i = 0; i < mPrevious.items.size(); i++) {
+		mPreviousIndex.push_back(std::make_pair(mPrevious.items[i].id, i));
+	}
+	std::sort(mPreviousIndex.begin(), mPreviousIndex.end());
+}
+
+
+const RenderItem* Renderer::FindPrevious(uint32_t id) const
+{
+	auto it = std::lower_bound(mPreviousIndex.begin(), mPreviousIndex.end(), std::make_pair(id, (uint32_t)0));
+	if (it == mPreviousIndex.end() || it->first != id) return nullptr;
+	return &mPrevious.items[it->second];
+}
+
+
+void Renderer::Draw(double now)
+{
+	// Clear background
+	glClearColor(mCurrent.background[0],
+	             mCurrent.background[1],
+	             mCurrent.background[2], 0.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Render one tick behind the simulation: alpha runs from the previous snapshot (0) to the current one (1)
+	float alpha = 1.0f;
+	double tickLength = mCurrent.time - mPrevious.time;
+	if (mCurrent.tick > mPrevious.tick && tickLength > 0.0) {
+		alpha = glm::clamp((float)((now - mCurrent.time) / tickLength), 0.0f, 1.0f);
+	}
+
+	RenderView view = mCurrent.view;
+	if (alpha < 1.0f) {
+		view.position = glm::mix(mPrevious.view.position, mCurrent.view.position, alpha);
+		view.orientation = glm::slerp(mPrevious.view.orientation, mCurrent.view.orientation, alpha);
+		view.playerOffset = glm::mix(mPrevious.view.playerOffset, mCurrent.view.playerOffset, alpha);
+	}
+	glm::mat4 viewMatrix = Camera::ComputeViewMatrix(view);
+
+	for (const RenderItem& item : mCurrent.items) {
+		const RenderItem* previous = (alpha < 1.0f) ? FindPrevious(item.id) : nullptr;
+		if (previous) {
+			DrawItem(item, glm::mix(previous->position, item.position, alpha), glm::slerp(previous->orientation, item.orientation, alpha), viewMatrix);
+		}
+		else {
+			DrawItem(item, item.position, item.orientation, viewMatrix);
+		}
+	}
+}
+
+
+void Renderer::DrawItem(const RenderItem& item, const glm::vec3& position, const glm::quat& orientation, const glm::mat4& view)
+{
+	GLuint program = item.material;
+
+	// Select proper material (shader program)
+	glUseProgram(program);
+
+	// Set geometry to draw
+	glBindBuffer(GL_ARRAY_BUFFER, item.arrayBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, item.elementArrayBuffer);
+
+	// Set globals for camera
+	GLint view_mat = glGetUniformLocation(program, "view_mat");
+	glUniformMatrix4fv(view_mat, 1, GL_FALSE, glm::value_ptr(view));
+	GLint projection_mat = glGetUniformLocation(program, "projection_mat");
+	glUniformMatrix4fv(projection_mat, 1, GL_FALSE, glm::value_ptr(mProjectionMatrix));
+
+	// Set attributes for shaders
+	GLint vertex_att = glGetAttribLocation(program, "vertex");
+	glVertexAttribPointer(vertex_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), 0);
+	glEnableVertexAttribArray(vertex_att);
+
+	GLint normal_att = glGetAttribLocation(program, "normal");
+	glVertexAttribPointer(normal_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (3*sizeof(GLfloat)));
+	glEnableVertexAttribArray(normal_att);
+
+	GLint color_att = glGetAttribLocation(program, "color");
+	glVertexAttribPointer(color_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (6*sizeof(GLfloat)));
+	glEnableVertexAttribArray(color_att);
+
+	GLint tex_att = glGetAttribLocation(program, "uv");
+	glVertexAttribPointer(tex_att, 2, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (9*sizeof(GLfloat)));
+	glEnableVertexAttribArray(tex_att);
+
+	// World matrix; scaling is done only on the object itself
+	glm::mat4 transf = glm::translate(glm::mat4(1.0), position) * glm::mat4_cast(orientation);
+
+	GLint world_mat = glGetUniformLocation(program, "world_mat");
+	glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(glm::scale(transf, item.scale)));
+
+	// Normal matrix
+	glm::mat4 normal_matrix = glm::transpose(glm::inverse(transf));
+	GLint normal_mat = glGetUniformLocation(program, "normal_mat");
+	glUniformMatrix4fv(normal_mat, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+
+	// Texture
+	if (item.texture) {
+		GLint tex = glGetUniformLocation(program, "texture_map");
+		glUniform1i(tex, 0); // Assign the first texture to the map
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, item.texture); // First texture we bind
+		// Define texture interpolation
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	}
+
+	// Environment map
+	GLint useEnv = glGetUniformLocation(program, "useEnvMap");
+	if (item.envmap) {
+		glUniform1i(useEnv, true);
+		GLint tex = glGetUniformLocation(program, "env_map");
+		glUniform1i(tex, 1); // Assign the second texture to the map
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, item.envmap);
+		// Define texture interpolation
+		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else {
+		glUniform1i(useEnv, false);
+	}
+
+	// Terrain: heights come from the height map, and the level of detail is centred where the patches
+	// were selected, which is the camera of the current snapshot
+	GLint height_map = glGetUniformLocation(program, "height_map");
+	if (height_map != -1) {
+		glUniform1i(height_map, 2); // Assign the third texture to the map
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, mTerrainHeightMap);
+		glUniform1f(glGetUniformLocation(program, "terrain_cell_size"), mTerrainCellSize);
+		glUniform3fv(glGetUniformLocation(program, "lod_center"), 1, glm::value_ptr(mCurrent.view.position));
+		glUniform1f(glGetUniformLocation(program, "lod_range_ratio"), TerrainLodNode::LOD_RANGE_RATIO);
+		glUniform1f(glGetUniformLocation(program, "lod_patch_cells"), (float)TerrainLodNode::PATCH_CELLS);
+	}
+
+	// Timer
+	GLint timer_var = glGetUniformLocation(program, "timer");
+	double current_time = glfwGetTime();
+	glUniform1f(timer_var, (float) current_time);
+
+	// draw geometry
+	if (item.mode == GL_POINTS) {
+		glDrawArrays(item.mode, 0, item.size);
+	}
+	else {
+		glDrawElements(item.mode, item.size, GL_UNSIGNED_INT, 0);
+	}
+}
+
+} // namespace game
@@ -0,0 +1,55 @@
+#ifndef RENDERER_H_
+#define RENDERER_H_
+
+#include <vector>
+#include <utility>
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "render_snapshot.h"
+
+namespace game {
+
+	// class Renderer
+	// Draws render snapshots on the thread that owns the OpenGL context
+	// It keeps the last two snapshots it was given and interpolates between them, so motion stays smooth
+	// even though the simulation only ticks a few times per frame
+	class Renderer {
+
+	public:
+		Renderer(void);
+		~Renderer();
+
+		// Set projection from frustum parameters: field-of-view,
+		// near and far planes, and width and height of viewport
+		void SetProjection(GLfloat fov, GLfloat near, GLfloat far, GLfloat w, GLfloat h);
+
+		// Height map texture and cell size for the terrain material, see TerrainLodNode
+		void SetTerrain(GLuint heightMap, float cellSize);
+
+		// Hand a freshly published snapshot to the renderer
+		void Submit(const RenderSnapshot& snapshot);
+
+		// Draw the scene as it was at time 'now', interpolating between the last two snapshots
+		void Draw(double now);
+
+	private:
+		glm::mat4 mProjectionMatrix;
+		GLuint mTerrainHeightMap;
+		float mTerrainCellSize;
+
+		// Previous and current snapshot, and the previous one's items sorted by node id
+		RenderSnapshot mPrevious;
+		RenderSnapshot mCurrent;
+		std::vector<std::pair<uint32_t, uint32_t>> mPreviousIndex;
+
+		const RenderItem* FindPrevious(uint32_t id) const;
+		void DrawItem(const RenderItem& item, const glm::vec3& position, const glm::quat& orientation, const glm::mat4& view);
+
+	}; // class Renderer
+
+} // namespace game
+
+#endif // RENDERER_H_
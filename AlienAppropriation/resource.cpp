@@ -9,6 +9,7 @@ Resource::Resource(ResourceType type, std::string name, GLuint resource, GLsizei
     mName = name;
     mResource = resource;
     mSize = size;
+    mHasBounds = false;
 }
 
 
@@ -18,6 +19,7 @@ Resource::Resource(ResourceType type, std::string name, GLuint array_buffer, GLu
     mArrayBuffer = array_buffer;
     mElementArrayBuffer = element_array_buffer;
     mSize = size;
+    mHasBounds = false;
 }
 
 
@@ -61,4 +63,12 @@ GLsizei Resource::getSize(void) const {
     return mSize;
 }
 
+
+void Resource::setBounds(const glm::vec3& min, const glm::vec3& max){
+
+    mBoundsMin = min;
+    mBoundsMax = max;
+    mHasBounds = true;
+}
+
 } // namespace game
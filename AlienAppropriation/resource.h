@@ -5,6 +5,7 @@
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 
 namespace game {
 
@@ -27,6 +28,9 @@ namespace game {
                 };
             };
             GLsizei mSize; // Number of primitives in geometry
+            glm::vec3 mBoundsMin; // Box around the vertices of a mesh, in model space
+            glm::vec3 mBoundsMax;
+            bool mHasBounds;
 
         public:
             Resource(ResourceType type, std::string name, GLuint resource, GLsizei size);
@@ -38,6 +42,10 @@ namespace game {
             GLuint getArrayBuffer(void) const;
             GLuint getElementArrayBuffer(void) const;
             GLsizei getSize(void) const;
+            inline bool hasBounds(void) const { return mHasBounds; }
+            inline glm::vec3 getBoundsMin(void) const { return mBoundsMin; }
+            inline glm::vec3 getBoundsMax(void) const { return mBoundsMax; }
+            void setBounds(const glm::vec3& min, const glm::vec3& max);
 
     }; // class Resource
 
@@ -9,6 +9,7 @@
 
 #include "resource_manager.h"
 #include "model_loader.h"
+#include "terrain.h"
 
 namespace game {
 
@@ -42,6 +43,22 @@ void ResourceManager::AddResource(ResourceType type, const std::string name, GLu
 }
 
 
+// Record the box around a mesh's vertices, which start with their position
+void ResourceManager::FitBounds(const std::string name, const GLfloat *vertex, int vertex_num, int vertex_att){
+
+	if (vertex_num <= 0) return;
+
+	glm::vec3 boundsMin(vertex[0], vertex[1], vertex[2]);
+	glm::vec3 boundsMax = boundsMin;
+	for (int i = 1; i < vertex_num; i++) {
+		glm::vec3 position(vertex[i*vertex_att + 0], vertex[i*vertex_att + 1], vertex[i*vertex_att + 2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+	getResource(name)->setBounds(boundsMin, boundsMax);
+}
+
+
 void ResourceManager::LoadResource(ResourceType type, const std::string name, const char *filename){
 
     // Call appropriate method depending on type of resource
@@ -293,12 +310,13 @@ void ResourceManager::CreateTorus(std::string object_name, float loop_radius, fl
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
 
-    // Free data buffers
-    delete [] vertex;
-    delete [] face;
-
     // Create resource
     AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+    FitBounds(object_name, vertex, vertex_num, vertex_att);
+
+    // Free data buffers
+    delete[] vertex;
+    delete[] face;
 }
 
 
@@ -395,12 +413,13 @@ void ResourceManager::CreateSphere(std::string object_name, float radius, int nu
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
 
-    // Free data buffers
-    delete [] vertex;
-    delete [] face;
-
     // Create resource
     AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+    FitBounds(object_name, vertex, vertex_num, vertex_att);
+
+    // Free data buffers
+    delete[] vertex;
+    delete[] face;
 }
 
 void ResourceManager::LoadTexture(const std::string name, const char *filename) {
@@ -679,6 +698,17 @@ void ResourceManager::LoadMesh(const std::string name, const char *filename) {
 	// Create resource
 	AddResource(Mesh, name, vbo, ebo, mesh.face.size() * face_att);
 
+	// Collision shapes are fitted to these
+	glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+	if (!mesh.position.empty()) {
+		boundsMin = boundsMax = mesh.position[0];
+		for (const glm::vec3& position : mesh.position) {
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+	}
+	getResource(name)->setBounds(boundsMin, boundsMax);
+
 }
 
 void ResourceManager::CreateCylinder(std::string object_name, float radius, int resolution, glm::vec3 color) {
@@ -805,12 +835,13 @@ void ResourceManager::CreateCylinder(std::string object_name, float radius, int
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
 
+	// Create resource
+	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+	FitBounds(object_name, vertex, vertex_num, vertex_att);
+
 	// Free data buffers
 	delete[] vertex;
 	delete[] face;
-
-	// Create resource
-	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
 }
 
 void ResourceManager::CreateCone(std::string object_name, float radius, int resolution) {
@@ -941,12 +972,13 @@ void ResourceManager::CreateCone(std::string object_name, float radius, int reso
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
 
+	// Create resource
+	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+	FitBounds(object_name, vertex, vertex_num, vertex_att);
+
 	// Free data buffers
 	delete[] vertex;
 	delete[] face;
-
-	// Create resource
-	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
 }
 
 void ResourceManager::CreateSquare(std::string object_name, float width, glm::vec3 color /*= 1.0*/)
@@ -995,6 +1027,7 @@ void ResourceManager::CreateSquare(std::string object_name, float width, glm::ve
 
 	// Create resource
 	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+	FitBounds(object_name, vertex, vertex_num, vertex_att);
 }
 
 void ResourceManager::CreateGrid(std::string object_name, float heightVariance, int width, int height, float tileSize)
@@ -1106,12 +1139,117 @@ void ResourceManager::CreateGrid(std::string object_name, float heightVariance,
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
 
+		// Create resource
+		AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+		FitBounds(object_name, vertex, vertex_num, vertex_att);
+
 		// Free data buffers
 		delete[] vertex;
 		delete[] face;
+}
 
-		// Create resource
-		AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+void ResourceManager::CreateTerrainPatch(std::string object_name, int cells)
+{
+	// Create a flat grid for TerrainLodNode, in grid steps: vertex (x, 0, z) is the x-th step along and the
+	// z-th across. The vertex shader scales it and takes heights and normals from the height map
+
+	// Number of vertices and faces to be created
+	const int columns = cells + 1;
+	const GLuint vertex_num = columns * columns;
+	const GLuint face_num = cells * cells * 2;
+
+	// Number of attributes for vertices and faces
+	const int vertex_att = 11;  // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
+	const int face_att = 3; // Vertex indices (3)
+
+	GLfloat *vertex = NULL;
+	GLuint *face = NULL;
+
+	// Allocate memory for buffers
+	try {
+		vertex = new GLfloat[vertex_num * vertex_att];
+		face = new GLuint[face_num * face_att];
+	}
+	catch (std::exception &e) {
+		throw e;
+	}
+
+	// Create vertices
+	glm::vec3 vertex_position;
+	glm::vec3 vertex_normal(0.0f, 1.0f, 0.0f);
+	glm::vec3 vertex_color(1.0f);
+	glm::vec2 vertex_coord;
+
+	for (int z = 0; z < columns; z++) {
+		for (int x = 0; x < columns; x++) {
+			vertex_position = glm::vec3(x, 0.0f, z);
+			vertex_coord = glm::vec2(x, z) / (float)cells;
+
+			int v = z * columns + x;
+			for (int k = 0; k < 3; k++) {
+				vertex[v*vertex_att + k] = vertex_position[k];
+				vertex[v*vertex_att + k + 3] = vertex_normal[k];
+				vertex[v*vertex_att + k + 6] = vertex_color[k];
+			}
+			vertex[v*vertex_att + 9] = vertex_coord[0];
+			vertex[v*vertex_att + 10] = vertex_coord[1];
+		}
+	}
+
+	// Create triangles, two per cell, wound counter-clockwise seen from above
+	for (int z = 0; z < cells; z++) {
+		for (int x = 0; x < cells; x++) {
+			GLuint v = z * columns + x;
+			GLuint t1[3] = { v, v + columns, v + 1 };
+			GLuint t2[3] = { v + 1, v + columns, v + columns + 1 };
+			int f = (z * cells + x) * 2;
+			for (int k = 0; k < 3; k++) {
+				face[f*face_att + k] = t1[k];
+				face[(f + 1)*face_att + k] = t2[k];
+			}
+		}
+	}
+
+	// Create model
+	// Create OpenGL buffer for vertices
+	GLuint vbo, ebo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
+
+	// Create OpenGL buffer for faces
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+
+	// Create resource
+	AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+	FitBounds(object_name, vertex, vertex_num, vertex_att);
+
+	// Free data buffers
+	delete[] vertex;
+	delete[] face;
+}
+
+
+void ResourceManager::CreateHeightMap(std::string object_name)
+{
+	// Upload one tile of Terrain's samples as a one channel float texture, one texel per sample
+	// Linear filtering makes a lookup at a texel centre bilinear, like Terrain::getHeight, and repeating
+	// the texture tiles it the same way. The repeated last row and column are left out
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, Terrain::getSampleCountX());
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, Terrain::getSampleCountX() - 1, Terrain::getSampleCountZ() - 1, 0, GL_RED, GL_FLOAT, Terrain::getSamples());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	// Create resource
+	AddResource(Texture, object_name, texture, 0);
 }
 
 void ResourceManager::CreateSphereParticles(std::string object_name, int num_particles) {
@@ -1596,6 +1734,7 @@ void ResourceManager::CreateCube(std::string object_name) {
 
 	// Create resource
 	AddResource(Mesh, object_name, vbo, ebo, sizeof(face) / sizeof(GLfloat));
+	FitBounds(object_name, vertex, sizeof(vertex) / sizeof(GLfloat) / 11, 11);
 }
 
 
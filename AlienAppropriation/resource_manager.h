@@ -46,6 +46,10 @@ namespace game {
 			void CreateSquare(std::string object_name, float width = 1.0, glm::vec3 color = glm::vec3(1.0f));
 			// Create the geometry of a plane using a grid
 			void CreateGrid(std::string object_name, float heightVariance= 0, int width = 11, int height = 11, float tileSize = 10.0);
+			// Create a flat grid of cells by cells steps for drawing the terrain, see TerrainLodNode
+			void CreateTerrainPatch(std::string object_name, int cells);
+			// Create a texture holding the height map generated by Terrain::Generate
+			void CreateHeightMap(std::string object_name);
 			// Create particles distributed over a sphere
 			void CreateSphereParticles(std::string object_name, int num_particles = 20000);
 			void CreateParticles_Point(std::string object_name, int num_particles = 3000);
@@ -68,6 +72,8 @@ namespace game {
 			// Loads a mesh in obj format
 			void LoadMesh(const std::string name, const char *filename);
 			void LoadCubeMap(const std::string name, const char *filename);
+			// Give a mesh resource the box around its vertices
+			void FitBounds(const std::string name, const GLfloat *vertex, int vertex_num, int vertex_att);
 
     }; // class ResourceManager
 
@@ -0,0 +1,106 @@
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace game {
+
+	// class RingBuffer
+	// A fixed capacity, lock-free queue that any number of threads may push into and pop from.
+	// Storage is allocated once inside the object, so pushing and popping never allocate.
+	// Based on Dmitry Vyukov's bounded MPMC queue: every slot carries a sequence number that tells
+	// producers and consumers whether it is free, full, or still being written by another thread.
+	// Capacity must be a power of two.
+	template<class T, size_t Capacity>
+	class RingBuffer {
+
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+	public:
+		RingBuffer()
+			: mEnqueuePos(0)
+			, mDequeuePos(0)
+		{
+			for (size_t i = 0; i < Capacity; i++) {
+				mSlots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		// Claim a slot and let 'fill' write the element in place
+		// Returns false without blocking when the buffer is full
+		template<class F> bool tryPushWith(F&& fill)
+		{
+			Slot* slot;
+			size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+			for (;;) {
+				slot = &mSlots[pos & (Capacity - 1)];
+				size_t seq = slot->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+				if (diff == 0) {
+					if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0) {
+					return false; // full
+				}
+				else {
+					pos = mEnqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			fill(slot->value);
+			slot->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		inline bool tryPush(const T& value) { return tryPushWith([&value](T& slot) { slot = value; }); }
+
+		// Take the oldest element and hand it to 'consume' while it is still in its slot
+		// Returns false when the buffer is empty
+		template<class F> bool tryPopWith(F&& consume)
+		{
+			Slot* slot;
+			size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+			for (;;) {
+				slot = &mSlots[pos & (Capacity - 1)];
+				size_t seq = slot->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+				if (diff == 0) {
+					if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0) {
+					return false; // empty
+				}
+				else {
+					pos = mDequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			consume(slot->value);
+			slot->sequence.store(pos + Capacity, std::memory_order_release);
+			return true;
+		}
+
+		inline bool tryPop(T& out) { return tryPopWith([&out](T& slot) { out = slot; }); }
+
+		inline size_t capacity() const { return Capacity; }
+
+	private:
+		struct Slot {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		// Keep the two cursors on separate cache lines so producers and the consumer do not fight over them
+		alignas(64) std::atomic<size_t> mEnqueuePos;
+		alignas(64) std::atomic<size_t> mDequeuePos;
+		alignas(64) Slot mSlots[Capacity];
+
+	}; // class RingBuffer
+
+} // namespace game
+
+#endif // RING_BUFFER_H_
@@ -1,6 +1,8 @@
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <float.h>
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -9,21 +11,39 @@
 #include "scene_graph.h"
 
 #include "scene_node.h"
+#include "behaviour.h"
+#include "kinematics.h"
+#include "missile_system.h"
+#include "heading_table.h"
+#include "terrain.h"
 
 namespace game {
 
 BaseNode* SceneGraph::mRootNode = nullptr;
 PlayerNode* SceneGraph::mPlayerNode = nullptr;
-std::vector<std::vector<std::vector<SceneNode*>>> SceneGraph::nodes(15, std::vector<std::vector<SceneNode*>>(15, std::vector<SceneNode*>()));
+GridCells SceneGraph::mCells;
+std::vector<BaseNode*> SceneGraph::mRemovedNodes;
+std::vector<BaseNode*> SceneGraph::mReclaimNodes;
+std::mutex SceneGraph::mBatchMutex;
+std::vector<std::vector<SceneNode*>> SceneGraph::mSpawnBatches;
+CommandBuffer SceneGraph::mCommands;
+bool SceneGraph::mDeferChanges = false;
+BroadPhase SceneGraph::mBroadPhase;
+uint32_t SceneGraph::mBeamProxy = BroadPhase::NO_PROXY;
+ContactCache SceneGraph::mContacts;
 
 SceneGraph::SceneGraph(Camera* camera) {
 
     mBackgroundColor = glm::vec3(0.0, 0.0, 0.0);
 
 	mRootNode = new BaseNode("ROOT");
+	mPlayerLastPosition = glm::vec3(0.0f);
+	camera->setCollisionLayer(LayerNone);
 	addNode(camera);
 	mCameraNode = camera;
 
+	RegisterContactHandlers();
+
 
 }
 
@@ -47,43 +67,303 @@ glm::vec3 SceneGraph::GetBackgroundColor(void) const {
 }
 
 
+void SceneGraph::setPlayerNode(PlayerNode* player)
+{
+	mPlayerNode = player;
+
+	player->setCollisionLayer(LayerPlayer);
+	player->setProxy(mBroadPhase.add(player, LayerPlayer));
+	mBeamProxy = mBroadPhase.add(player, LayerTractorBeam, false);
+}
+
+
 void SceneGraph::deleteNode(BaseNode * node)
 {
-	node->getParentNode()->removeChildNode(node);
-	for (BaseNode* child : node->getChildNodes()) {
-		child->setParentNode(nullptr);
-		child->addTag("delete");
-	}
+	ChangeScene(CmdDelete, node, nullptr);
 }
 
 void SceneGraph::deleteNode(std::string name)
 {
-	for (std::vector<std::vector<SceneNode*>> column : nodes) {
-		for (std::vector<SceneNode*> cell : column) {
-			for (BaseNode* n : cell)
+	for (const auto& cell : mCells) {
+		for (BaseNode* n : cell.second)
+		{
+			if (name.compare(n->getName()) == 0)
 			{
-				if (name.compare(n->getName()) == 0)
-				{
-					deleteNode(n);
-					return;
-				}
+				deleteNode(n);
+				return;
 			}
 		}
 	}
 
 }
 
+void SceneGraph::reparentNode(BaseNode * node, BaseNode * parent)
+{
+	ChangeScene(CmdReparent, node, parent);
+}
+
+void SceneGraph::tagNode(BaseNode * node, std::string tag)
+{
+	ChangeScene(CmdAddTag, node, nullptr, tag);
+}
+
+void SceneGraph::untagNode(BaseNode * node, std::string tag)
+{
+	ChangeScene(CmdRemoveTag, node, nullptr, tag);
+}
+
+
+void SceneGraph::setCollisionLayer(SceneNode * node, CollisionLayer layer)
+{
+	node->setCollisionLayer(layer);
+	if (node->getProxy() != BroadPhase::NO_PROXY) {
+		mBroadPhase.setLayer(node->getProxy(), layer);
+	}
+}
+
+
+SceneNode* SceneGraph::Spawn(PrefabId prefab, const std::string& node_name, const glm::vec3& position, const glm::quat& orientation, const glm::vec3& scale, BaseNode* parent)
+{
+	SceneNode* node = Instantiate(prefab, node_name, position, orientation, scale);
+	ChangeScene(CmdSpawn, node, parent);
+	return node;
+}
+
+
+void SceneGraph::SpawnBatch(const PrefabInstance* instances, size_t count, std::vector<SceneNode*>* nodes)
+{
+	if (count == 0) return;
+
+	std::vector<size_t> perPrefab(Prefabs::getCount(), 0);
+	for (size_t i = 0; i < count; i++) {
+		perPrefab[instances[i].prefab]++;
+	}
+	for (size_t prefab = 0; prefab < perPrefab.size(); prefab++) {
+		if (perPrefab[prefab]) Prefabs::Reserve((PrefabId)prefab, perPrefab[prefab]);
+	}
+
+	std::vector<SceneNode*> batch(count);
+	for (size_t i = 0; i < count; i++) {
+		const PrefabInstance& instance = instances[i];
+		batch[i] = Instantiate(instance.prefab, instance.name, instance.position, instance.orientation, instance.scale);
+	}
+	if (nodes) {
+		nodes->insert(nodes->end(), batch.begin(), batch.end());
+	}
+
+	if (mDeferChanges) {
+		std::lock_guard<std::mutex> lock(mBatchMutex);
+		mSpawnBatches.push_back(std::move(batch));
+	}
+	else {
+		AddNodes(batch.data(), batch.size());
+	}
+}
+
+
+SceneNode* SceneGraph::Instantiate(PrefabId prefab, const std::string& node_name, const glm::vec3& position, const glm::quat& orientation, const glm::vec3& scale)
+{
+	const Prefab& record = Prefabs::get(prefab);
+	SceneNode* node = record.construct(node_name, record);
+	node->setPrefab(prefab);
+
+	node->setPosition(position + record.offset);
+	node->setOrientation(orientation * record.orientation);
+	node->setScale(record.scale * scale);
+	node->setCollisionType(record.shape);
+	// Not in the broad phase yet, so the layer goes straight on the node
+	node->setCollisionLayer(record.layer);
+	for (uint32_t i = 0; i < record.tagCount; i++) {
+		node->addTag(Prefabs::getTag(record.firstTag + i));
+	}
+	return node;
+}
+
+
+void SceneGraph::AddNodes(SceneNode* const* nodes, size_t count)
+{
+	mRootNode->addChildNodes(nodes, count);
+
+	// Counting sort by grid cell: number the cells the batch touches, count the nodes in each,
+	// then lay the nodes out cell after cell
+	std::unordered_map<uint64_t, uint32_t> cellIndex;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> cellOf(count);
+	std::vector<uint32_t> cellStart;
+	for (size_t i = 0; i < count; i++) {
+		SceneNode* node = nodes[i];
+		node->setParentNode(mRootNode);
+		int x = CellCoord(node->getPosition().x);
+		int z = CellCoord(node->getPosition().z);
+		node->setGridPosition(x, z);
+
+		auto found = cellIndex.emplace(CellKey(x, z), (uint32_t)keys.size());
+		if (found.second) {
+			keys.push_back(found.first->first);
+			cellStart.push_back(0);
+		}
+		cellOf[i] = found.first->second;
+		cellStart[cellOf[i]]++;
+	}
+
+	uint32_t total = 0;
+	for (uint32_t& start : cellStart) {
+		uint32_t cellCount = start;
+		start = total;
+		total += cellCount;
+	}
+	cellStart.push_back(total);
+
+	std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+	std::vector<SceneNode*> sorted(count);
+	for (size_t i = 0; i < count; i++) {
+		sorted[next[cellOf[i]]++] = nodes[i];
+	}
+	for (size_t c = 0; c < keys.size(); c++) {
+		std::vector<SceneNode*>& cell = mCells[keys[c]];
+		cell.insert(cell.end(), sorted.begin() + cellStart[c], sorted.begin() + cellStart[c + 1]);
+	}
+
+	mBroadPhase.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		nodes[i]->setProxy(mBroadPhase.add(nodes[i], nodes[i]->getCollisionLayer()));
+	}
+}
+
+
+void SceneGraph::ChangeScene(SceneCommandType type, BaseNode * node, BaseNode * parent, const std::string& tag)
+{
+	if (mDeferChanges) {
+		mCommands.push(type, node, parent, tag);
+		return;
+	}
+
+	SceneCommand command;
+	command.type = type;
+	command.node = node;
+	command.parent = parent;
+	command.tag = tag;
+	command.sequence = 0;
+	ApplyChange(command);
+}
+
+
+void SceneGraph::ApplyChange(const SceneCommand& command)
+{
+	BaseNode* node = command.node;
+
+	switch (command.type) {
+	case CmdSpawn:
+		addNode(dynamic_cast<SceneNode*>(node), command.parent);
+		break;
+
+	case CmdReparent: {
+		BaseNode* parent = command.parent ? command.parent : mRootNode;
+		if (node->getParentNode()) {
+			node->getParentNode()->removeChildNode(node);
+		}
+		node->setParentNode(parent);
+		parent->addChildNode(node);
+
+		SceneNode* sceneNode = dynamic_cast<SceneNode*>(node);
+		if (sceneNode && parent == mRootNode && sceneNode->getProxy() == BroadPhase::NO_PROXY) {
+			sceneNode->setProxy(mBroadPhase.add(sceneNode, sceneNode->getCollisionLayer()));
+		}
+		else if (sceneNode && parent != mRootNode && sceneNode->getProxy() != BroadPhase::NO_PROXY) {
+			mContacts.forgetProxy(sceneNode->getProxy());
+			mBroadPhase.remove(sceneNode->getProxy());
+			sceneNode->setProxy(BroadPhase::NO_PROXY);
+		}
+		break;
+	}
+
+	case CmdAddTag:
+		if (!node->hasTag(command.tag)) node->addTag(command.tag);
+		break;
+
+	case CmdRemoveTag:
+		node->removeTag(command.tag);
+		break;
+
+	case CmdDelete:
+		RemoveFromScene(node);
+		break;
+	}
+}
+
+
+// Unlink a node and its whole subtree from the hierarchy and the grid
+// Deleting a node twice in one tick is harmless: the second time it is found nowhere
+void SceneGraph::RemoveFromScene(BaseNode * node)
+{
+	BaseNode* parent = node->getParentNode();
+	if (parent) {
+		parent->removeChildNode(node);
+		mRemovedNodes.push_back(node);
+	}
+	node->onDeleted();
+
+	SceneNode* sceneNode = dynamic_cast<SceneNode*>(node);
+	if (sceneNode && sceneNode->getProxy() != BroadPhase::NO_PROXY) {
+		mContacts.forgetProxy(sceneNode->getProxy());
+		mBroadPhase.remove(sceneNode->getProxy());
+		sceneNode->setProxy(BroadPhase::NO_PROXY);
+	}
+	if (sceneNode) {
+		glm::vec2 gridPos = sceneNode->getGridPosition();
+		auto found = mCells.find(CellKey((int)gridPos.x, (int)gridPos.y));
+		std::vector<SceneNode*>::iterator it;
+		if (found != mCells.end() && (it = std::find(found->second.begin(), found->second.end(), sceneNode)) != found->second.end()) {
+			found->second.erase(it);
+		}
+		else if (parent) {
+			// Nodes outside the rebinning (the player) do not keep their grid position in sync
+			for (auto& other : mCells) {
+				other.second.erase(std::remove(other.second.begin(), other.second.end(), sceneNode), other.second.end());
+			}
+		}
+	}
+
+	for (BaseNode* child : node->getChildNodes()) {
+		RemoveFromScene(child);
+	}
+}
+
+
+void SceneGraph::commitChanges(void)
+{
+	// Nothing can reach what the last commit removed any more
+	for (BaseNode* node : mReclaimNodes) {
+		delete node;
+	}
+	mReclaimNodes.swap(mRemovedNodes);
+	mRemovedNodes.clear();
+
+	// Batches are spawns, so they go in before any other change
+	{
+		std::lock_guard<std::mutex> lock(mBatchMutex);
+		mCommitBatches.swap(mSpawnBatches);
+	}
+	for (const std::vector<SceneNode*>& batch : mCommitBatches) {
+		AddNodes(batch.data(), batch.size());
+	}
+	mCommitBatches.clear();
+
+	mCommands.take(mCommitList);
+	for (const SceneCommand& command : mCommitList) {
+		ApplyChange(command);
+	}
+}
+
 
 game::BaseNode* SceneGraph::getNode(std::string node_name) 
 {
-	for (std::vector<std::vector<SceneNode*>> column : nodes) {
-		for (std::vector<SceneNode*> cell : column) {
-			for (BaseNode* n : cell)
+	for (const auto& cell : mCells) {
+		for (BaseNode* n : cell.second)
+		{
+			if (node_name.compare(n->getName()) == 0)
 			{
-				if (node_name.compare(n->getName()) == 0)
-				{
-					return n;
-				}
+				return n;
 			}
 		}
 	}
@@ -93,152 +373,405 @@ game::BaseNode* SceneGraph::getNode(std::string node_name)
 
 
 
-void SceneGraph::draw(Camera *camera)
+// Copy everything the renderer needs out of the scene
+// Called by the simulation thread at the end of a tick; the snapshot's storage is reused between ticks
+// Top level subtrees are independent, so they are extracted in parallel and appended in order
+void SceneGraph::extract(RenderSnapshot& snapshot, WorkerPool& pool)
 {
-    // Clear background
-    glClearColor(mBackgroundColor[0], 
-                 mBackgroundColor[1],
-                 mBackgroundColor[2], 0.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	HeadingTable::apply();
 
-	for (BaseNode* bn : mRootNode->getChildNodes())
-	{
-		dynamic_cast<SceneNode*>(bn)->draw(camera);
+	snapshot.items.clear();
+	snapshot.background = mBackgroundColor;
+	mCameraNode->extractView(snapshot.view);
+	Terrain::setViewer(snapshot.view);
+
+	NodeTransform world;
+	world.position = glm::vec3(0.0f);
+	world.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+	std::vector<BaseNode*> roots = mRootNode->getChildNodes();
+	size_t partCount = std::min(pool.getThreadCount() + 1, roots.size());
+	if (mExtractParts.size() < partCount) {
+		mExtractParts.resize(partCount);
+	}
+
+	pool.parallelFor(partCount, [&](size_t part) {
+		RenderSnapshot& out = mExtractParts[part];
+		out.items.clear();
+		size_t first = roots.size() * part / partCount;
+		size_t last = roots.size() * (part + 1) / partCount;
+		for (size_t i = first; i < last; i++) {
+			dynamic_cast<SceneNode*>(roots[i])->extract(out, world);
+		}
+	});
+
+	for (size_t part = 0; part < partCount; part++) {
+		snapshot.items.insert(snapshot.items.end(), mExtractParts[part].items.begin(), mExtractParts[part].items.end());
 	}
 }
 
 // Check for collision
 // If return true, then the object will be deleted (used for projectiles, cows)
-bool SceneGraph::checkCollisionWithPlayer(SceneNode * object)
+bool SceneGraph::checkCollisionWithPlayer(SceneNode * object, CollisionLayer layer)
 {
-
-	// Check if any objects below the player can be sucked up
-	if (object->hasTag("canPickUp")) {
-		if (mPlayerNode->isTractorBeamActive()) {
-			float dist = glm::distance(glm::vec2(mPlayerNode->getPosition().x, mPlayerNode->getPosition().z), glm::vec2(object->getPosition().x, object->getPosition().z));
-			float height = mPlayerNode->getPosition().y - object->getPosition().y;
-
-			if (height > 0) {
-				if (dist < height / 4 + 0.25) {
-					dynamic_cast<EntityNode*>(object)->rise(glm::normalize(mPlayerNode->getPosition() - object->getPosition()));
-				}
-			}
-
+	// Check if any objects can be collected
+	bool collectable = layer == LayerCow || layer == LayerBull || layer == LayerHay;
+	if (collectable && mPlayerNode->isTractorBeamActive()) {
+		deleteNode(object);
+		if (layer == LayerBull) {
+			mPlayerNode->takeDamage(BULL);
+		}
+		else if (layer == LayerCow) {
+			mPlayerNode->addHealth(5);
 		}
+		mPlayerNode->addCollected(layer == LayerCow ? "cow" : "hay");
+		return true;
 	}
 
-	// Check for any other collision
-	if (object->getCollisionType() == Point) {
-		if ((glm::distance(object->getPosition(), mPlayerNode->getPosition())) < object->getRadius() + mPlayerNode->getRadius()) {
-			
-			
-			// Check if any objects can be collected
-			if (object->hasTag("canCollect")) {
-				if (mPlayerNode->isTractorBeamActive() && (glm::distance(object->getPosition(), mPlayerNode->getPosition())) < object->getRadius() + mPlayerNode->getRadius()) {
-					object->addTag("delete");
-					if (object->hasTag("bull")) {
-						mPlayerNode->takeDamage(BULL);
-					}
-					else if (object->hasTag("cow")) {
-						mPlayerNode->addHealth(5);
-					}
-					mPlayerNode->addCollected( object->hasTag("cow") ? "cow" : "hay" );
-					return true;
-				}
-			}
-			
-			
-			
-			ProjectileNode* proj = dynamic_cast<ProjectileNode*> (object);
-			if (proj) {
-				proj->addTag("delete");
-				if (!mPlayerNode->isShieldActive()) {
-					mPlayerNode->takeDamage(MISSILE);
-				}
-				else {
-					mPlayerNode->addEnergy(-25.0f);
-				}
-				return true;
-			}
-			else {
-				mCameraNode->setVelocity(glm::vec3(0));
-			}
-
+	if (layer == LayerProjectile) {
+		deleteNode(object);
+		if (!mPlayerNode->isShieldActive()) {
+			mPlayerNode->takeDamage(MISSILE);
 		}
+		else {
+			mPlayerNode->addEnergy(-25.0f);
+		}
+		return true;
+	}
+	else {
+		mCameraNode->setVelocity(glm::vec3(0));
 	}
 
 	return false;
 }
 
+// Lift an object inside the cone under the player
+void SceneGraph::checkTractorBeam(SceneNode * object)
+{
+	dynamic_cast<EntityNode*>(object)->rise(glm::normalize(mPlayerNode->getPosition() - object->getPosition()));
+}
+
 bool SceneGraph::checkCollisionBetweenObjs(SceneNode * bomb, SceneNode * target)
 {
-	if ((glm::distance(bomb->getPosition(), target->getPosition())) < bomb->getRadius() + target->getRadius()) {
-		target->addTag("delete");
-	}
+	deleteNode(target);
 	return false;
 }
 
 
-bool SceneGraph::update(double deltaTime)
+bool SceneGraph::updateNodes(double deltaTime)
 {
-	//We iterate through all the nodes twice
-	// Once to update them
+	mPlayerLastPosition = mPlayerNode->getPosition();
+	BehaviourScheduler::update(deltaTime);
 	mRootNode->update(deltaTime);
+	MissileSystem::update(deltaTime, mPlayerNode->getPosition());
+	KinematicsSystem::integrate();
 	if (*(mPlayerNode->getHullStrength()) <= 0) { 
 		return true; 
 	}
 	mPlayerNode->setGridPosition(mPlayerNode->getPosition());
+	return false;
+}
 
-	// Twice to delete any nodes, plus check collision
-	for (int x = 0; x < nodes.size(); x++) {
-		for (int y = 0; y < nodes.at(x).size(); y++) {
-			std::vector<SceneNode*>& cell = nodes.at(x).at(y);
-			for (int i = 0; i < cell.size(); i++) {
-				SceneNode* currentNode = cell.at(i);
-
-				// delete nodes
-				if (currentNode->hasTag("delete")) {
-					deleteNode(currentNode);
-					cell.erase(cell.begin() + i);
-					i--;
-					continue;
-				}
 
-				// ignore player/camera nodes
-				if (currentNode->getName() == "camera" || currentNode->getName() == "player" || currentNode->hasTag("ignore")) continue;
-
-				// update grid location
-				int newX = floor(currentNode->getPosition().x / 20);
-				int newY = floor(currentNode->getPosition().z / 20);
-				newX = glm::clamp(newX, 0, 14);
-				newY = glm::clamp(newY, 0, 14);
-
-				if (newX != x || newY != y) {
-					cell.erase(cell.begin() + i);
-					i--;
-					nodes.at(newX).at(newY).push_back(currentNode);
-					currentNode->setGridPosition(newX, newY);
-					continue;
-				}
+void SceneGraph::rebinGrid(void)
+{
+	mMovedNodes.clear();
+
+	for (auto cellIt = mCells.begin(); cellIt != mCells.end(); ) {
+		int x = (int)(int32_t)(cellIt->first >> 32);
+		int y = (int)(int32_t)(uint32_t)cellIt->first;
+		std::vector<SceneNode*>& cell = cellIt->second;
+		for (int i = 0; i < cell.size(); i++) {
+			SceneNode* currentNode = cell.at(i);
+
+			// ignore player/camera nodes
+			if (currentNode->getName() == "camera" || currentNode->getName() == "player" || currentNode->hasTag("ignore")) continue;
+
+			// update grid location
+			int newX = CellCoord(currentNode->getPosition().x);
+			int newY = CellCoord(currentNode->getPosition().z);
+
+			// Hold on to moved nodes until the scan is done, pushing into a cell we have not reached yet would visit them twice
+			if (newX != x || newY != y) {
+				cell.erase(cell.begin() + i);
+				i--;
+				currentNode->setGridPosition(newX, newY);
+				mMovedNodes.push_back(currentNode);
+			}
+		}
 
+		// Drop cells that emptied, so the grid only grows with what is in the world
+		if (cell.empty()) {
+			cellIt = mCells.erase(cellIt);
+		}
+		else {
+			++cellIt;
+		}
+	}
 
-				// check for collision with the player if the player is in the same grid OR the node is a projectile
-				if (mPlayerNode->getGridPosition() == glm::vec2(x,y) || currentNode->hasTag("projectile")) {
-					checkCollisionWithPlayer(currentNode);
-				}
+	for (SceneNode* node : mMovedNodes) {
+		glm::vec2 gridPos = node->getGridPosition();
+		mCells[CellKey((int)gridPos.x, (int)gridPos.y)].push_back(node);
+	}
+}
+
+
+// The beam is a cone from the player down to the ground, widening by a quarter of the height
+static bool InsideTractorBeam(SceneNode * player, SceneNode * object)
+{
+	float dist = glm::distance(glm::vec2(player->getPosition().x, player->getPosition().z), glm::vec2(object->getPosition().x, object->getPosition().z));
+	float height = player->getPosition().y - object->getPosition().y;
+
+	return height > 0 && dist < height / 4 + 0.25;
+}
+
+
+// Gameplay reactions to contacts, run once the collision pass has found them all
+void SceneGraph::RegisterContactHandlers(void)
+{
+	// The player stops against anything solid, and takes what it collects while the beam is on
+	ContactHandler bump = [this](ContactEvent event, SceneNode* player, SceneNode* other) {
+		if (event != ContactExit) checkCollisionWithPlayer(other, other->getCollisionLayer());
+	};
+	mContacts.setHandler(LayerPlayer, LayerScenery, bump);
+	mContacts.setHandler(LayerPlayer, LayerCow, bump);
+	mContacts.setHandler(LayerPlayer, LayerBull, bump);
+	mContacts.setHandler(LayerPlayer, LayerHay, bump);
+	mContacts.setHandler(LayerPlayer, LayerFarmer, bump);
+	mContacts.setHandler(LayerPlayer, LayerBombable, bump);
+
+	// Hits only count once
+	mContacts.setHandler(LayerPlayer, LayerProjectile, [this](ContactEvent event, SceneNode* player, SceneNode* missile) {
+		if (event == ContactEnter) checkCollisionWithPlayer(missile, LayerProjectile);
+	});
+
+	ContactHandler lift = [this](ContactEvent event, SceneNode* beam, SceneNode* other) {
+		if (event != ContactExit) checkTractorBeam(other);
+	};
+	mContacts.setHandler(LayerTractorBeam, LayerCow, lift);
+	mContacts.setHandler(LayerTractorBeam, LayerBull, lift);
+	mContacts.setHandler(LayerTractorBeam, LayerHay, lift);
+	mContacts.setHandler(LayerTractorBeam, LayerFarmer, lift);
+
+	mContacts.setHandler(LayerBomb, LayerBombable, [this](ContactEvent event, SceneNode* bomb, SceneNode* target) {
+		if (event == ContactEnter) checkCollisionBetweenObjs(bomb, target);
+	});
+
+	// Missiles blow up on trees and barns
+	mContacts.setHandler(LayerScenery, LayerProjectile, [](ContactEvent event, SceneNode* scenery, SceneNode* missile) {
+		if (event == ContactEnter) deleteNode(missile);
+	});
+}
+
+
+// Projectiles can cross a whole target in one tick, so test their move instead of where they ended up
+// targetMove is how far the target moved over the same tick
+static bool SweepProjectile(ProjectileNode * projectile, const CollisionShape & target, const glm::vec3 & targetMove)
+{
+	CollisionShape shape = projectile->getCollisionShape();
+	return SweepSphere(projectile->getLastPosition() + targetMove, shape.center, shape.radius, target) <= 1.0f;
+}
+
+
+void SceneGraph::resolveCollisions(void)
+{
+	// The beam covers a cone from the player down to the ground, widening by a quarter of the height
+	if (mPlayerNode->isTractorBeamActive() && mPlayerNode->getPosition().y > 0.0f) {
+		glm::vec3 apex = mPlayerNode->getPosition();
+		float spread = apex.y / 4 + 0.25f;
+		mBroadPhase.setBounds(mBeamProxy, glm::vec3(apex.x - spread, 0.0f, apex.z - spread), glm::vec3(apex.x + spread, apex.y, apex.z + spread));
+	}
+	else {
+		mBroadPhase.clearBounds(mBeamProxy);
+	}
+
+	mBroadPhase.update();
 
-				// check collision between hay bombs and cannons
-				// this is where the grid cells structure saves us time
+	mPlayerCandidates.clear();
+	mPlayerShapes.clear();
 
-				if (currentNode->hasTag("bomb")) {
-					for (SceneNode* object : cell) {
-						if (object->hasTag("bombable")) {
-							checkCollisionBetweenObjs(currentNode, object);
-						}
-					}
+	// Narrow phase: only find out which pairs touch, reactions come from the contact events
+	for (const CollisionPair& pair : mBroadPhase.getPairs()) {
+		// The lower layer is the one that reacts, see CollisionLayer
+		bool swap = pair.layerB < pair.layerA;
+		SceneNode* actor = swap ? pair.b : pair.a;
+		SceneNode* other = swap ? pair.a : pair.b;
+		CollisionLayer actorLayer = swap ? pair.layerB : pair.layerA;
+		CollisionLayer otherLayer = swap ? pair.layerA : pair.layerB;
+		uint64_t key = ContactCache::PairKey(pair.proxyA, pair.proxyB);
+
+		if (other->getCollisionType() == None) continue;
+
+		bool touching = false;
+		if (actorLayer == LayerPlayer && otherLayer == LayerProjectile) {
+			// Swept in the player's frame, since the player moves as well
+			glm::vec3 playerMove = mPlayerNode->getPosition() - mPlayerLastPosition;
+			touching = SweepProjectile(static_cast<ProjectileNode*>(other), mPlayerNode->getCollisionShape(), playerMove);
+		}
+		else if (actorLayer == LayerPlayer) {
+			if (!mContacts.stillApart(key, actor, other)) {
+				mPlayerCandidates.push_back(pair);
+				mPlayerShapes.add(other->getCollisionShape());
+			}
+		}
+		else if (actorLayer == LayerTractorBeam) {
+			touching = InsideTractorBeam(mPlayerNode, other);
+		}
+		else if (actorLayer == LayerBomb) {
+			// Bombs are spheres
+			CollisionShape bomb = actor->getCollisionShape();
+			touching = SphereSeparation(bomb.center, bomb.radius, other->getCollisionShape()) < 0.0f;
+		}
+		else if (otherLayer == LayerProjectile) {
+			touching = SweepProjectile(static_cast<ProjectileNode*>(other), actor->getCollisionShape(), glm::vec3(0.0f));
+		}
+
+		if (touching) {
+			mContacts.touch(key, actor, other, actorLayer, otherLayer);
+		}
+	}
+
+	// The player is a sphere, tested against everything it might touch in one go
+	if (!mPlayerCandidates.empty()) {
+		CollisionShape player = mPlayerNode->getCollisionShape();
+		mSeparations.resize(mPlayerShapes.size());
+		mPlayerShapes.testSphere(player.center, player.radius, mSeparations.data());
+		for (size_t i = 0; i < mPlayerCandidates.size(); i++) {
+			const CollisionPair& pair = mPlayerCandidates[i];
+			bool swap = pair.layerB < pair.layerA;
+			SceneNode* other = swap ? pair.a : pair.b;
+			uint64_t key = ContactCache::PairKey(pair.proxyA, pair.proxyB);
+
+			mContacts.recordSeparation(key, mPlayerNode, other, mSeparations[i]);
+			if (mSeparations[i] < 0.0f) {
+				mContacts.touch(key, mPlayerNode, other, LayerPlayer, swap ? pair.layerA : pair.layerB);
+			}
+		}
+	}
+
+	mContacts.update();
+}
+
+
+bool SceneGraph::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit, uint32_t layerMask, const SceneNode* ignore)
+{
+	return sphereCast(origin, direction, 0.0f, maxDistance, hit, layerMask, ignore);
+}
+
+
+bool SceneGraph::segmentCast(const glm::vec3& start, const glm::vec3& end, RayHit& hit, uint32_t layerMask, const SceneNode* ignore)
+{
+	return sphereCast(start, end - start, 0.0f, glm::length(end - start), hit, layerMask, ignore);
+}
+
+
+bool SceneGraph::sphereCast(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, RayHit& hit, uint32_t layerMask, const SceneNode* ignore)
+{
+	RayQuery query;
+	query.origin = origin;
+	query.direction = direction;
+	query.maxDistance = maxDistance;
+	query.radius = radius;
+	query.layerMask = layerMask;
+	query.ignore = ignore;
+	return Cast(query, hit);
+}
+
+
+void SceneGraph::castBatch(const RayQuery* queries, RayHit* hits, size_t count, WorkerPool* pool)
+{
+	if (pool) {
+		pool->parallelFor(count, [queries, hits](size_t i) { Cast(queries[i], hits[i]); });
+	}
+	else {
+		for (size_t i = 0; i < count; i++) {
+			Cast(queries[i], hits[i]);
+		}
+	}
+}
+
+
+void SceneGraph::CastAgainst(SceneNode * node, const RayQuery& query, const glm::vec3& end, RayHit& hit)
+{
+	if (node == query.ignore || node->getProxy() == BroadPhase::NO_PROXY || node->getCollisionType() == None) return;
+	if (!(query.layerMask & LayerBit(node->getCollisionLayer()))) return;
+
+	float t = SweepSphere(query.origin, end, query.radius, node->getCollisionShape());
+	if (t <= 1.0f && t * query.maxDistance < hit.distance) {
+		hit.node = node;
+		hit.distance = t * query.maxDistance;
+	}
+}
+
+
+// A 2D DDA over the x/z grid: step from cell to cell in the order the ray enters them. Colliders are binned by
+// their centre, so each cell is tested together with the cells within reach of it: anything the swept sphere
+// touches from this cell is binned there. Once the closest hit lies before the cell being entered, nothing in
+// cells not yet tested can be closer
+bool SceneGraph::Cast(const RayQuery& query, RayHit& hit)
+{
+	hit.node = nullptr;
+	hit.distance = query.maxDistance;
+
+	float length = glm::length(query.direction);
+	if (length <= 0.0f || query.maxDistance <= 0.0f) return false;
+	glm::vec3 direction = query.direction / length;
+	glm::vec3 end = query.origin + direction * query.maxDistance;
+
+	// The player is not kept in the cell it is in, see rebinGrid
+	if (mPlayerNode) {
+		CastAgainst(mPlayerNode, query, end, hit);
+	}
+
+	int cellX = CellCoord(query.origin.x);
+	int cellZ = CellCoord(query.origin.z);
+	int stepX = direction.x > 0.0f ? 1 : -1;
+	int stepZ = direction.z > 0.0f ? 1 : -1;
+	float nextX = direction.x != 0.0f ? ((cellX + (stepX > 0 ? 1 : 0)) * GRID_CELL_SIZE - query.origin.x) / direction.x : FLT_MAX;
+	float nextZ = direction.z != 0.0f ? ((cellZ + (stepZ > 0 ? 1 : 0)) * GRID_CELL_SIZE - query.origin.z) / direction.z : FLT_MAX;
+	float deltaX = direction.x != 0.0f ? GRID_CELL_SIZE / fabsf(direction.x) : FLT_MAX;
+	float deltaZ = direction.z != 0.0f ? GRID_CELL_SIZE / fabsf(direction.z) : FLT_MAX;
+
+	// The first cell brings its whole neighbourhood. After that a step only adds the column or row on its leading
+	// side: the path never turns back, so the cells behind were tested already and none is tested twice
+	int reach = (int)ceilf((query.radius + MAX_COLLIDER_EXTENT) / GRID_CELL_SIZE);
+	int fromX = cellX - reach, toX = cellX + reach;
+	int fromZ = cellZ - reach, toZ = cellZ + reach;
+
+	float entry = 0.0f;
+	while (entry <= hit.distance) {
+		for (int x = fromX; x <= toX; x++) {
+			for (int z = fromZ; z <= toZ; z++) {
+				auto found = mCells.find(CellKey(x, z));
+				if (found == mCells.end()) continue;
+				for (SceneNode* node : found->second) {
+					if (node != mPlayerNode) CastAgainst(node, query, end, hit);
 				}
 			}
 		}
+
+		if (nextX < nextZ) {
+			entry = nextX;
+			nextX += deltaX;
+			cellX += stepX;
+			fromX = toX = cellX + stepX * reach;
+			fromZ = cellZ - reach;
+			toZ = cellZ + reach;
+		}
+		else {
+			entry = nextZ;
+			nextZ += deltaZ;
+			cellZ += stepZ;
+			fromZ = toZ = cellZ + stepZ * reach;
+			fromX = cellX - reach;
+			toX = cellX + reach;
+		}
+		if (entry == FLT_MAX) break;
+	}
+
+	if (hit.node) {
+		hit.point = query.origin + direction * hit.distance;
+		return true;
 	}
 	return false;
 }
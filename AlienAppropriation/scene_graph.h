@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -18,6 +20,13 @@
 #include "resource_manager.h"
 #include "projectile_node.h"
 #include "entity_node.h"
+#include "render_snapshot.h"
+#include "worker_pool.h"
+#include "command_buffer.h"
+#include "broad_phase.h"
+#include "narrow_phase.h"
+#include "contact_cache.h"
+#include "prefab.h"
 
 namespace game {
 
@@ -32,6 +41,26 @@ namespace game {
 		virtual ~GameException() throw() {};
 	};
 
+	// A ray or sphere cast into the world
+	struct RayQuery {
+		glm::vec3 origin;
+		glm::vec3 direction; // Need not be normalized
+		float maxDistance;
+		float radius; // 0 for a ray
+		uint32_t layerMask; // LayerBit of every layer that can be hit
+		const SceneNode* ignore; // Usually whoever is asking
+	};
+
+	// Nodes in each occupied grid cell, see SceneGraph::CellKey
+	typedef std::unordered_map<uint64_t, std::vector<SceneNode*>> GridCells;
+
+	// Closest thing a query hit
+	struct RayHit {
+		SceneNode* node; // nullptr if nothing was hit
+		float distance;  // Along the ray
+		glm::vec3 point; // Centre of the cast sphere when it touched, the hit point itself for a ray
+	};
+
     // class SceneGraph
 	// The Scene Graph contains all nodes within the scene.
 	// It is responsible for managing nodes: creating, updating, and deleting
@@ -50,12 +79,54 @@ namespace game {
 			static PlayerNode* mPlayerNode;
 			Camera* mCameraNode;
 
-			static std::vector<std::vector<std::vector<SceneNode*>>> nodes;
+			// Spatial grid over x/z, keyed by CellKey. Only cells with something in them exist, so the world
+			// can be any size
+			static GridCells mCells;
+
+			// Structural changes made while a tick is running are queued here and applied by commitChanges
+			static CommandBuffer mCommands;
+			static bool mDeferChanges;
+			std::vector<SceneCommand> mCommitList;
+
+			// Collision: every collider in the world has a broad phase proxy, the player has two (hull and tractor beam)
+			static BroadPhase mBroadPhase;
+			static uint32_t mBeamProxy;
+			static ContactCache mContacts; // Turns contacts into enter, stay and exit events for the gameplay handlers
+
+			// Narrow phase: the player's broad phase candidates, tested against its sphere in one batch
+			std::vector<CollisionPair> mPlayerCandidates;
+			ShapeBatch mPlayerShapes;
+			std::vector<float> mSeparations;
+			glm::vec3 mPlayerLastPosition; // Where the player was before this tick, projectiles are swept relative to it
+
+			// Nodes that changed cell during rebinGrid, added to their new cell once every cell has been scanned
+			std::vector<SceneNode*> mMovedNodes;
+
+			// Nodes removed by the last commit are freed by the next one, in case a stale pointer is still
+			// queued in between
+			static std::vector<BaseNode*> mRemovedNodes;
+			static std::vector<BaseNode*> mReclaimNodes;
 
+			// Batches from SpawnBatch waiting for the commit, which adds each in one go
+			static std::mutex mBatchMutex;
+			static std::vector<std::vector<SceneNode*>> mSpawnBatches;
+			std::vector<std::vector<SceneNode*>> mCommitBatches;
+
+			// Per-worker item lists used while extracting in parallel
+			std::vector<RenderSnapshot> mExtractParts;
 
 
 
         public:
+			// Size of the grid cells on x and z
+			static constexpr float GRID_CELL_SIZE = 20.0f;
+			// How far on x/z a collider may reach from the position it is binned by: every collider must fit
+			// inside a cell. The world queries look this far, plus their own radius, around the cells they cross
+			static constexpr float MAX_COLLIDER_EXTENT = 0.5f * GRID_CELL_SIZE;
+
+			static inline uint64_t CellKey(int x, int z) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z; }
+			static inline int CellCoord(float position) { return (int)floor(position / GRID_CELL_SIZE); }
+
             // Constructor and destructor
             SceneGraph(Camera* camera);
             ~SceneGraph();
@@ -65,18 +136,40 @@ namespace game {
             glm::vec3 GetBackgroundColor(void) const;
             
 			// Basic functionality
-			void draw(Camera *camera);
-			bool update(double deltaTime);
-			bool checkCollisionWithPlayer(SceneNode *object);
+			// The update is split into the phases of a tick, run in this order by the frame task graph
+			bool updateNodes(double deltaTime); // Behaviour and movement of every node. Returns true if the player died
+			void rebinGrid(void); // Move nodes to the grid cell they are now in
+			void resolveCollisions(void);
+			void commitChanges(void); // Apply every spawn, delete, reparent and tag change queued during the tick
+			void extract(RenderSnapshot& snapshot, WorkerPool& pool);
+			// Reactions to contacts, called by the contact handlers
+			bool checkCollisionWithPlayer(SceneNode *object, CollisionLayer layer);
 			bool checkCollisionBetweenObjs(SceneNode *bomb, SceneNode *target);
+			void checkTractorBeam(SceneNode *object);
+
+			// World queries, returning the closest hit. They walk the grid cells along the ray and test what is
+			// in them with the narrow phase, along with every cell within radius + MAX_COLLIDER_EXTENT of them.
+			// A wide sphere cast therefore tests more cells per step.
+			// They do not allocate and only read the scene, so a batch can run in parallel. Use them from the
+			// update or collision phases, not while the grid is being rebinned or changes are committed
+			static bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit, uint32_t layerMask = ALL_LAYERS, const SceneNode* ignore = nullptr);
+			static bool segmentCast(const glm::vec3& start, const glm::vec3& end, RayHit& hit, uint32_t layerMask = ALL_LAYERS, const SceneNode* ignore = nullptr);
+			static bool sphereCast(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, RayHit& hit, uint32_t layerMask = ALL_LAYERS, const SceneNode* ignore = nullptr);
+			static void castBatch(const RayQuery* queries, RayHit* hits, size_t count, WorkerPool* pool = nullptr);
 
 			// Getters
 			inline static BaseNode* getRootNode() { return mRootNode; }
 			inline static PlayerNode* getPlayerNode() { return mPlayerNode; }
 			inline Camera* getCameraNode() { return mCameraNode; }
+			// Read the grid in the same phases as the world queries
+			inline static const GridCells& getGridCells() { return mCells; }
 
 			// Setters
-			inline void setPlayerNode(PlayerNode* player) { mPlayerNode = player; }
+			void setPlayerNode(PlayerNode* player);
+
+			// While set, hierarchy changes are queued instead of applied. Set by the simulation loop for the
+			// whole time it runs ticks; scene setup before that changes the scene directly
+			inline static void setDeferChanges(bool defer) { mDeferChanges = defer; }
 
 			// Hierarchy Management
 			static void addNode(SceneNode *node, BaseNode *parent = nullptr) 
@@ -89,17 +182,28 @@ namespace game {
 					node->setParentNode(mRootNode);
 					mRootNode->addChildNode(node);
 				}
-				int x = (int)floor(node->getPosition().x / 20.0f);
-				int y = (int)floor(node->getPosition().y / 20.0f);
-				x = glm::clamp(x, 0, 14);
-				y = glm::clamp(y, 0, 14);
+				int x = CellCoord(node->getPosition().x);
+				int y = CellCoord(node->getPosition().z);
 				node->setGridPosition(x, y);
 
-				nodes.at(x).at(y).push_back(node);
+				mCells[CellKey(x, y)].push_back(node);
+
+				// Only nodes placed directly in the world collide, children move with their parent
+				if (node->getParentNode() == mRootNode) {
+					node->setProxy(mBroadPhase.add(node, node->getCollisionLayer()));
+				}
 			}
 
-			void deleteNode(BaseNode *node);
-			void deleteNode(std::string name);
+			// Safe to call from any phase of a tick; the change happens when the tick commits
+			static void deleteNode(BaseNode *node);
+			static void deleteNode(std::string name);
+			static void reparentNode(BaseNode *node, BaseNode *parent);
+			static void tagNode(BaseNode *node, std::string tag);
+			static void untagNode(BaseNode *node, std::string tag);
+
+			// Put a node on a collision layer, done when it is created. Nodes start out as LayerScenery
+			static void setCollisionLayer(SceneNode *node, CollisionLayer layer);
+			inline static CollisionMatrix& getCollisionMatrix(void) { return mBroadPhase.getMatrix(); }
 			BaseNode* getNode(std::string node_name);
 
 
@@ -110,7 +214,8 @@ namespace game {
 				// Create scene node with the specified resources
 				T* scn = new T(node_name, geometry, material, texture);
 
-				addNode(scn, parent);
+				// The node can be set up by the caller right away, but only joins the scene when the tick commits
+				ChangeScene(CmdSpawn, scn, parent);
 
 				return scn;
 			}
@@ -122,13 +227,7 @@ namespace game {
 				T* scn = new T(node_name, geometry, material, lifespan, initialPos, initialVelocityVec, texture);
 
 				// Add node to the scene
-				mRootNode->addChildNode(scn);
-				scn->setParentNode(mRootNode);
-				int x = glm::clamp((int)floor(initialPos.x / 20.0f), 0, 14);
-				int y = glm::clamp((int)floor(initialPos.y / 20.0f), 0, 14);
-
-				nodes.at(x).at(y).push_back(scn);
-				scn->setGridPosition(x, y);
+				ChangeScene(CmdSpawn, scn, nullptr);
 
 				return scn;
 			}
@@ -159,6 +258,15 @@ namespace game {
 				return scn;
 			}
 
+			// Node Creation from a prefab, with no lookups: the node is made in the NodePool and set up as the
+			// prefab says. orientation and scale are the instance's own, applied on top of the prefab's
+			static SceneNode* Spawn(PrefabId prefab, const std::string& node_name, const glm::vec3& position, const glm::quat& orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f), BaseNode* parent = nullptr);
+			// Spawn count instances into the world at once. The pool is sized for them up front and the whole batch
+			// joins the scene together: one append to the root's children, one append per grid cell after a
+			// counting sort by cell, and one pass over the broad phase. nodes, if given, gets the nodes in order,
+			// to be set up further before the commit
+			static void SpawnBatch(const PrefabInstance* instances, size_t count, std::vector<SceneNode*>* nodes = nullptr);
+
 			template<class T> static T *CreateProjectileInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name, float lifespan, glm::vec3 initialPos, glm::vec3 initialVelocityVec)
 			{
 				Resource *geom = ResourceManager::getResource(object_name);
@@ -183,6 +291,18 @@ namespace game {
 				return scn;
 			}
 
+		private:
+			// Queue the change while a tick is running, apply it right away otherwise
+			static void ChangeScene(SceneCommandType type, BaseNode *node, BaseNode *parent, const std::string& tag = std::string());
+			static void ApplyChange(const SceneCommand& command);
+			static void RemoveFromScene(BaseNode *node);
+			static SceneNode* Instantiate(PrefabId prefab, const std::string& node_name, const glm::vec3& position, const glm::quat& orientation, const glm::vec3& scale);
+			// addNode for many nodes under the root
+			static void AddNodes(SceneNode* const* nodes, size_t count);
+			static bool Cast(const RayQuery& query, RayHit& hit);
+			static void CastAgainst(SceneNode *node, const RayQuery& query, const glm::vec3& end, RayHit& hit);
+			void RegisterContactHandlers(void);
+
 
 
 
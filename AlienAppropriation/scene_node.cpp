@@ -13,14 +13,25 @@
 #include <glm/gtx/norm.hpp>
 
 #include "scene_node.h"
+#include "broad_phase.h"
+#include "prefab.h"
 
 namespace game {
-	SceneNode::SceneNode(const std::string name) : BaseNode(name)
+	SceneNode::SceneNode(const std::string name) : BaseNode(name), mProxy(BroadPhase::NO_PROXY), mCollisionLayer(LayerScenery), mPrefab(Prefabs::NO_PREFAB), mHomeChunk(0), mPlanIndex(NOT_PLANNED)
 	{
+		radius = 1.0;
+		collisionType = Point;
+		mBoundsMin = glm::vec3(-1.0f);
+		mBoundsMax = glm::vec3(1.0f);
 	}
 
 	SceneNode::SceneNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture, const Resource *envmap)
 	: BaseNode(name)
+	, mProxy(BroadPhase::NO_PROXY)
+	, mCollisionLayer(LayerScenery)
+	, mPrefab(Prefabs::NO_PREFAB)
+	, mHomeChunk(0)
+	, mPlanIndex(NOT_PLANNED)
 {
     // Set geometry
     if (geometry->getType() == PointSet){
@@ -62,6 +73,14 @@ namespace game {
     mScale = glm::vec3(1.0, 1.0, 1.0);
 	radius = 1.0;
 	collisionType = Point;
+	if (geometry->hasBounds()) {
+		mBoundsMin = geometry->getBoundsMin();
+		mBoundsMax = geometry->getBoundsMax();
+	}
+	else {
+		mBoundsMin = glm::vec3(-1.0f);
+		mBoundsMax = glm::vec3(1.0f);
+	}
 	gridPosition = glm::vec2(floor(mPosition.x / 15), floor(mPosition.x / 15));
 }
 
@@ -89,6 +108,76 @@ glm::vec3 SceneNode::getscale(void) const {
 }
 
 
+CollisionShape SceneNode::getCollisionShape(void)
+{
+	CollisionShape shape;
+	glm::vec3 position = getPosition();
+	glm::vec3 half = 0.5f * (mBoundsMax - mBoundsMin) * mScale;
+	glm::vec3 offset = mOrientation * (0.5f * (mBoundsMax + mBoundsMin) * mScale);
+
+	shape.axis[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+	shape.axis[1] = glm::vec3(0.0f, 1.0f, 0.0f);
+	shape.axis[2] = glm::vec3(0.0f, 0.0f, 1.0f);
+
+	switch (collisionType) {
+	case Point:
+		shape.center = position;
+		shape.extent = glm::vec3(0.0f);
+		shape.radius = radius;
+		break;
+
+	case Capsule: {
+		// Segment along the longest axis, capped by half spheres as wide as the widest other axis
+		int along = (half.x >= half.y && half.x >= half.z) ? 0 : (half.y >= half.z ? 1 : 2);
+		float width = glm::max(half[(along + 1) % 3], half[(along + 2) % 3]);
+		for (int k = 0; k < 3; k++) {
+			shape.axis[k] = mOrientation * shape.axis[k];
+		}
+		shape.center = position + offset;
+		shape.extent = glm::vec3(0.0f);
+		shape.extent[along] = glm::max(half[along] - width, 0.0f);
+		shape.radius = width;
+		break;
+	}
+
+	case AlignedBox: {
+		// Box around the rotated mesh box
+		glm::vec3 aligned(0.0f);
+		for (int k = 0; k < 3; k++) {
+			aligned += glm::abs(mOrientation * shape.axis[k]) * half[k];
+		}
+		shape.center = position + offset;
+		shape.extent = aligned;
+		shape.radius = 0.0f;
+		break;
+	}
+
+	case OrientedBox:
+		for (int k = 0; k < 3; k++) {
+			shape.axis[k] = mOrientation * shape.axis[k];
+		}
+		shape.center = position + offset;
+		shape.extent = half;
+		shape.radius = 0.0f;
+		break;
+
+	default:
+		shape.center = position;
+		shape.extent = glm::vec3(0.0f);
+		shape.radius = 0.0f;
+		break;
+	}
+
+	return shape;
+}
+
+
+void SceneNode::getCollisionBounds(glm::vec3& min, glm::vec3& max)
+{
+	ShapeBounds(getCollisionShape(), min, max);
+}
+
+
 void SceneNode::setPosition(glm::vec3 position){
 
     mPosition = position;
@@ -207,42 +296,43 @@ GLuint SceneNode::getTexture(void) const {
 }
 
 
-void SceneNode::draw(SceneNode *camera, glm::mat4 parentTransf){
-
-	// Select proper material (shader program)
-	glUseProgram(mMaterial);
-
-	// Set geometry to draw
-	glBindBuffer(GL_ARRAY_BUFFER, mArrayBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElementArrayBuffer);
+void SceneNode::extract(RenderSnapshot& snapshot, const NodeTransform& parent){
 
-	// Set globals for camera
-	camera->SetupShader(mMaterial);
+	// Aply transformations *ISROT*
+	NodeTransform transf;
+	transf.position = parent.position + parent.orientation * mPosition;
+	transf.orientation = parent.orientation * mOrientation;
 
-	// Set world matrix and other shader input variables
-	SetupShader(mMaterial, parentTransf);
-
-	// draw geometry
-	if (mMode == GL_POINTS) {
-		glDrawArrays(mMode, 0, mSize);
-	}
-	else {
-		glDrawElements(mMode, mSize, GL_UNSIGNED_INT, 0);
-	}
+	emitRenderItem(snapshot, transf.position, transf.orientation);
 
 	for (BaseNode* bn : getChildNodes())
 	{
-		dynamic_cast<SceneNode*>(bn)->draw(camera, parentTransf);
+		dynamic_cast<SceneNode*>(bn)->extract(snapshot, transf);
 	}
 	
 }
 
 
+void SceneNode::emitRenderItem(RenderSnapshot& snapshot, const glm::vec3& position, const glm::quat& orientation){
+
+	RenderItem item;
+	item.id = mId;
+	item.position = position;
+	item.orientation = orientation;
+	item.scale = mScale;
+	item.mode = mMode;
+	item.arrayBuffer = mArrayBuffer;
+	item.elementArrayBuffer = mElementArrayBuffer;
+	item.size = mSize;
+	item.material = mMaterial;
+	item.texture = mTexture;
+	item.envmap = mEnvmap;
+	snapshot.items.push_back(item);
+}
+
+
 void SceneNode::update(double deltaTime)
 {
-	mPosition = glm::clamp(mPosition, 0.0f, 300.0f); // clamp to map limits
-	gridPosition = glm::vec2(floor(mPosition.x / 15), floor(mPosition.z / 15));
-
 	for (BaseNode* bn : getChildNodes())
 	{
 		bn->update(deltaTime);
@@ -253,65 +343,6 @@ void SceneNode::update(double deltaTime)
 
 
 
-void SceneNode::SetupShader(GLuint program, glm::mat4& parentTransf /*= glm::mat4(1.0)*/){
-
-    // Set attributes for shaders
-    GLint vertex_att = glGetAttribLocation(program, "vertex");
-    glVertexAttribPointer(vertex_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(vertex_att);
-
-    GLint normal_att = glGetAttribLocation(program, "normal");
-    glVertexAttribPointer(normal_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (3*sizeof(GLfloat)));
-    glEnableVertexAttribArray(normal_att);
-
-    GLint color_att = glGetAttribLocation(program, "color");
-    glVertexAttribPointer(color_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (6*sizeof(GLfloat)));
-    glEnableVertexAttribArray(color_att);
-
-    GLint tex_att = glGetAttribLocation(program, "uv");
-    glVertexAttribPointer(tex_att, 2, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (9*sizeof(GLfloat)));
-    glEnableVertexAttribArray(tex_att);
-
-	// Aply transformations *ISROT*
-	glm::mat4 rotation = glm::mat4_cast(mOrientation);
-	glm::mat4 translation = glm::translate(parentTransf, mPosition);
-
-	parentTransf = translation * rotation;
-
-    GLint world_mat = glGetUniformLocation(program, "world_mat");
-    glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(glm::scale(parentTransf, mScale)));
-	 // Normal matrix
-    glm::mat4 normal_matrix = glm::transpose(glm::inverse(parentTransf));
-    GLint normal_mat = glGetUniformLocation(program, "normal_mat");
-    glUniformMatrix4fv(normal_mat, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-
-
-	// Texture
-	if (mTexture) {
-		GLint tex = glGetUniformLocation(program, "texture_map");
-		glUniform1i(tex, 0); // Assign the first texture to the map
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mTexture); // First texture we bind
-		// Define texture interpolation
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	}
-
-	if (!mEnvmap) {
-		GLint useEnv = glGetUniformLocation(program, "useEnvMap");
-		glUniform1i(useEnv, false);
-	}
-
-
-    // Timer
-    GLint timer_var = glGetUniformLocation(program, "timer");
-    double current_time = glfwGetTime();
-    glUniform1f(timer_var, (float) current_time);
-}
-
 // Source code from https://github.com/opengl-tutorials/ogl/blob/master/common/quaternion_utils.cpp
 glm::quat SceneNode::QuatBetweenVectors(glm::vec3 start, glm::vec3 dest)
 {
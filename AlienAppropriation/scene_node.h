@@ -11,10 +11,23 @@
 
 #include "base_node.h"
 #include "resource.h"
+#include "render_snapshot.h"
+#include "broad_phase.h"
+#include "narrow_phase.h"
 
 namespace game {
+
+	// Index of a prefab, see class Prefabs
+	typedef uint16_t PrefabId;
 	
-	enum CollisionType { Point, Capsule, None };
+	// Shape a node collides as. Every shape but Point is fitted to the box around the node's mesh
+	enum CollisionType {
+		Point,       // Sphere of the node's radius
+		Capsule,     // Upright along the mesh's longest axis, as wide as the other two
+		AlignedBox,  // Box along the world axes around the rotated mesh box
+		OrientedBox, // The mesh box, turned with the node
+		None
+	};
 
 	// class SceneNode
 	// A node that exists within a scene. It has a 3D transform.
@@ -33,6 +46,13 @@ namespace game {
 			glm::vec2 gridPosition;
 			float radius;
 			CollisionType collisionType;
+			glm::vec3 mBoundsMin; // Box around the mesh in model space
+			glm::vec3 mBoundsMax;
+			uint32_t mProxy; // Broad phase proxy, BroadPhase::NO_PROXY if the node does not collide
+			CollisionLayer mCollisionLayer; // Set with SceneGraph::setCollisionLayer
+			PrefabId mPrefab; // What the node was spawned from, Prefabs::NO_PREFAB if it was made by hand
+			uint64_t mHomeChunk; // Key of the map chunk that planned the node, see MapGenerator
+			uint32_t mPlanIndex; // Its object in that chunk's plan, NOT_PLANNED if the map did not place it
 
 			// drawing
 			GLuint mArrayBuffer; // References to geometry: vertex and array buffers
@@ -49,13 +69,18 @@ namespace game {
 			// Source code from https://github.com/opengl-tutorials/ogl/blob/master/common/quaternion_utils.cpp
 			glm::quat QuatBetweenVectors(glm::vec3 start, glm::vec3 dest);
 
+			// Add this node's geometry to a snapshot with the given world transform
+			void emitRenderItem(RenderSnapshot& snapshot, const glm::vec3& position, const glm::quat& orientation);
+
 		public:
+			static const uint32_t NOT_PLANNED = 0xffffffff;
+
 			SceneNode(const std::string name);
 			SceneNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture = NULL, const Resource *envmap = NULL);
 			~SceneNode();
 
-			// Draw the node relative to its parent according to scene parameters in 'camera'
-			virtual void draw(SceneNode *camera, glm::mat4 parentTransf = glm::mat4(1.0));
+			// Add the node and its children to a render snapshot, relative to the parent's world transform
+			virtual void extract(RenderSnapshot& snapshot, const NodeTransform& parent);
 			virtual void update(double deltaTime);
 
 			// Transformations
@@ -71,6 +96,13 @@ namespace game {
 			inline glm::vec2 getGridPosition(void) { return gridPosition; }
 			inline float getRadius(void) { return radius; }
 			inline CollisionType getCollisionType(void) { return collisionType; }
+			CollisionShape getCollisionShape(void); // In world space, from the current transform
+			virtual void getCollisionBounds(glm::vec3& min, glm::vec3& max); // Box around the collision shape
+			inline uint32_t getProxy(void) const { return mProxy; }
+			inline CollisionLayer getCollisionLayer(void) const { return mCollisionLayer; }
+			inline PrefabId getPrefab(void) const { return mPrefab; }
+			inline uint64_t getHomeChunk(void) const { return mHomeChunk; }
+			inline uint32_t getPlanIndex(void) const { return mPlanIndex; }
 
 			// OpenGL variables
 			GLenum getMode(void) const;
@@ -87,7 +119,11 @@ namespace game {
 			void setGridPosition(glm::vec3 pos);
 			void setGridPosition(int x, int y);
 			void setEnvMap(Resource *envmap);
-			virtual void SetupShader(GLuint program, glm::mat4& parentTransf = glm::mat4(1.0));	// Set matrices that transform the node in a shader program
+			inline void setProxy(uint32_t proxy) { mProxy = proxy; }
+			inline void setCollisionLayer(CollisionLayer layer) { mCollisionLayer = layer; }
+			inline void setCollisionType(CollisionType type) { collisionType = type; }
+			inline void setPrefab(PrefabId prefab) { mPrefab = prefab; }
+			inline void setHome(uint64_t chunk, uint32_t planIndex) { mHomeChunk = chunk; mPlanIndex = planIndex; }
 
 
 	}; // class SceneNode
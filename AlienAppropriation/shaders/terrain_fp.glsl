@@ -0,0 +1,31 @@
+// Renders the terrain texture with a directional light
+
+#version 130
+
+// Attributes passed from the vertex shader
+in vec3 position_interp;
+in vec3 normal_interp;
+in vec4 color_interp;
+in vec2 uv_interp;
+
+// Uniform (global) buffer
+uniform sampler2D texture_map;
+
+// Material attributes (constants)
+uniform vec3 light_direction = vec3(-1.0, -0.7, -1.0); //direction of the directional light
+uniform vec4 diffuse_color = vec4(0.6, 0.6, 0.6, 1.0);
+uniform float Ia = 0.4; // Ambient light amount
+
+void main() 
+{
+	// Compute Lambertian term Id
+	vec3 N = normalize(normal_interp);
+	vec3 L = -normalize(light_direction);
+	float Id = max(dot(N, L), 0.0);
+
+    // Retrieve texture value
+    vec4 pixel = texture(texture_map, uv_interp);
+
+    // Assign illumination to the fragment, as in litTexture
+    gl_FragColor = pixel * Ia + Id * diffuse_color;
+}
@@ -0,0 +1,70 @@
+#version 130
+
+// Vertex buffer: a patch of the terrain in grid steps, see TerrainLodNode
+in vec3 vertex;
+in vec3 normal;
+in vec3 color;
+in vec2 uv;
+
+// Uniform (global) buffer
+uniform mat4 world_mat; // Translation to the patch corner, scaled by the spacing of its grid
+uniform mat4 view_mat;
+uniform mat4 projection_mat;
+
+// Terrain
+uniform sampler2D height_map; // One texel per height sample, repeating
+uniform float terrain_cell_size;
+uniform vec3 lod_center; // Where the patches were selected from
+uniform float lod_range_ratio; // A level is drawn out to this many times its node size
+uniform float lod_patch_cells; // Grid steps along a full patch
+
+// Morphing to the next level starts this far into a level's range
+const float morph_start = 0.7;
+
+// Attributes forwarded to the fragment shader
+out vec3 position_interp;
+out vec3 normal_interp;
+out vec4 color_interp;
+out vec2 uv_interp;
+
+float height(vec2 world)
+{
+    // Texel centres sit on the samples, so linear filtering interpolates like Terrain::getHeight, and
+    // wrapping repeats the tile like it does
+    vec2 texels = vec2(textureSize(height_map, 0));
+    return textureLod(height_map, (world / terrain_cell_size + 0.5) / texels, 0.0).r;
+}
+
+void main()
+{
+    float spacing = world_mat[0][0];
+    vec2 corner = world_mat[3].xz;
+    vec2 grid = vertex.xz;
+
+    // Morph factor from the distance to the unmorphed vertex, which neighbouring patches share
+    vec2 world = corner + grid * spacing;
+    float range = lod_range_ratio * spacing * lod_patch_cells;
+    float viewer_distance = length(lod_center - vec3(world.x, height(world), world.y));
+    float morph = clamp((viewer_distance - morph_start * range) / ((1.0 - morph_start) * range), 0.0, 1.0);
+
+    // Odd vertices slide onto the even ones, which are the grid of the next level
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+
+    world = corner + grid * spacing;
+    vec3 position = vec3(world.x, height(world), world.y);
+
+    gl_Position = projection_mat * view_mat * vec4(position, 1.0);
+
+    // Transform vertex position without including projection
+    position_interp = vec3(view_mat * vec4(position, 1.0));
+
+    // Normal from central differences, like Terrain::getNormal
+    float dx = height(world + vec2(terrain_cell_size, 0.0)) - height(world - vec2(terrain_cell_size, 0.0));
+    float dz = height(world + vec2(0.0, terrain_cell_size)) - height(world - vec2(0.0, terrain_cell_size));
+    normal_interp = normalize(vec3(-dx, 2.0 * terrain_cell_size, -dz));
+
+    color_interp = vec4(color, 1.0);
+
+    // The ground texture repeats every 10 units
+    uv_interp = world / 10.0;
+}
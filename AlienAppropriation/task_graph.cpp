@@ -0,0 +1,182 @@
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+
+#include "task_graph.h"
+
+namespace game {
+
+TaskGraph::TaskGraph(void)
+	: mRemaining(0)
+	, mCompiled(false)
+{
+}
+
+
+TaskGraph::~TaskGraph()
+{
+}
+
+
+int TaskGraph::addTask(const std::string& name, uint32_t reads, uint32_t writes, std::function<void()> body)
+{
+	std::unique_ptr<Task> task(new Task());
+	task->name = name;
+	task->reads = reads;
+	task->writes = writes;
+	task->body = body;
+	task->dependencyCount = 0;
+	task->pending = 0;
+	task->averageMs = 0.0;
+
+	mTasks.push_back(std::move(task));
+	mCompiled = false;
+	return (int)mTasks.size() - 1;
+}
+
+
+void TaskGraph::compile(void)
+{
+	size_t count = mTasks.size();
+	for (auto& task : mTasks) {
+		task->successors.clear();
+		task->dependencyCount = 0;
+	}
+
+	// ancestors[i][j] is true if task j always finishes before task i starts
+	std::vector<std::vector<bool>> ancestors(count, std::vector<bool>(count, false));
+
+	for (size_t i = 0; i < count; i++) {
+		Task& later = *mTasks[i];
+
+		// Every earlier task that conflicts with this one
+		// Write after write, read after write and write after read all force an order
+		std::vector<size_t> conflicts;
+		for (size_t j = 0; j < i; j++) {
+			Task& earlier = *mTasks[j];
+			if ((earlier.writes & (later.reads | later.writes)) || (earlier.reads & later.writes)) {
+				conflicts.push_back(j);
+			}
+		}
+
+		// Only keep direct edges: drop a conflict if another one already waits for it
+		for (size_t j : conflicts) {
+			bool implied = false;
+			for (size_t k : conflicts) {
+				if (k != j && ancestors[k][j]) { implied = true; break; }
+			}
+			if (implied) continue;
+
+			mTasks[j]->successors.push_back((int)i);
+			later.dependencyCount++;
+		}
+
+		for (size_t j : conflicts) {
+			ancestors[i][j] = true;
+			for (size_t a = 0; a < count; a++) {
+				if (ancestors[j][a]) ancestors[i][a] = true;
+			}
+		}
+	}
+
+	mCompiled = true;
+}
+
+
+void TaskGraph::run(WorkerPool& pool)
+{
+	if (!mCompiled) compile();
+	if (mTasks.empty()) return;
+
+	mRemaining = (int)mTasks.size();
+	for (auto& task : mTasks) {
+		task->pending = task->dependencyCount;
+	}
+
+	// Start every phase without dependencies; the rest are started as their inputs finish
+	for (int i = 0; i < (int)mTasks.size(); i++) {
+		if (mTasks[i]->dependencyCount == 0) {
+			pool.submit([this, &pool, i]() { Execute(pool, i); });
+		}
+	}
+
+	// Help out until the whole graph is done
+	while (mRemaining > 0) {
+		if (!pool.runPendingJob()) std::this_thread::yield();
+	}
+
+	if (mError) {
+		std::exception_ptr error = mError;
+		mError = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+
+void TaskGraph::Execute(WorkerPool& pool, int index)
+{
+	Task& task = *mTasks[index];
+
+	// A phase that threw may have left things half done, so the ones after it are skipped
+	bool failed;
+	{
+		std::lock_guard<std::mutex> lock(mErrorMutex);
+		failed = mError != nullptr;
+	}
+	if (!failed) {
+		try {
+			auto start = std::chrono::steady_clock::now();
+			task.body();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			task.averageMs = (task.averageMs == 0.0) ? ms : task.averageMs * 0.95 + ms * 0.05;
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mErrorMutex);
+			if (!mError) mError = std::current_exception();
+		}
+	}
+
+	for (int s : task.successors) {
+		if (--mTasks[s]->pending == 0) {
+			pool.submit([this, &pool, s]() { Execute(pool, s); });
+		}
+	}
+
+	// Nothing may touch the graph after this, run() is allowed to return
+	mRemaining--;
+}
+
+
+void TaskGraph::writeDot(std::ostream& out) const
+{
+	out << "digraph frame {" << std::endl;
+	out << "\trankdir=LR;" << std::endl;
+	out << "\tnode [shape=box];" << std::endl;
+
+	for (size_t i = 0; i < mTasks.size(); i++) {
+		char timing[32];
+		snprintf(timing, sizeof(timing), "%.3f ms", mTasks[i]->averageMs);
+		out << "\tt" << i << " [label=\"" << mTasks[i]->name << "\\n" << timing << "\"];" << std::endl;
+	}
+	for (size_t i = 0; i < mTasks.size(); i++) {
+		for (int s : mTasks[i]->successors) {
+			out << "\tt" << i << " -> t" << s << ";" << std::endl;
+		}
+	}
+
+	out << "}" << std::endl;
+}
+
+
+std::string TaskGraph::summary(void) const
+{
+	std::ostringstream out;
+	char timing[32];
+	for (size_t i = 0; i < mTasks.size(); i++) {
+		snprintf(timing, sizeof(timing), "%.3fms", mTasks[i]->averageMs);
+		out << (i ? " | " : "") << mTasks[i]->name << " " << timing;
+	}
+	return out.str();
+}
+
+} // namespace game
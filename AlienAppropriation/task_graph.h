@@ -0,0 +1,85 @@
+#ifndef TASK_GRAPH_H_
+#define TASK_GRAPH_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include <ostream>
+#include <functional>
+#include <stdint.h>
+
+#include "worker_pool.h"
+
+namespace game {
+
+	// Shared state a frame phase can read or write
+	// Two phases may only run at the same time if neither writes something the other touches
+	enum FrameResource : uint32_t {
+		ResInput      = 1 << 0, // Queued key events
+		ResCamera     = 1 << 1, // Camera transform and velocity
+		ResPlayer     = 1 << 2, // Player stats and weapons
+		ResBehaviour  = 1 << 3, // Entity behaviour state and timers, and the kinematics and heading tables entities register in
+		ResTransforms = 1 << 4, // Node positions, orientations and velocities
+		ResHierarchy  = 1 << 5, // Parent/child links, tags, node creation and deletion
+		ResGrid       = 1 << 6, // Spatial grid cells
+		ResSkybox     = 1 << 7,
+		ResRenderList = 1 << 8, // The render snapshot being filled in
+		ResCommands   = 1 << 9  // Scene changes queued for the end of tick commit. Queueing is thread safe and only reads it
+	};
+
+	// class TaskGraph
+	// Runs the phases of a simulation tick on the shared worker pool
+	// Phases are added in the order they would run on a single thread, each declaring what it reads
+	// and writes. compile() turns the declarations into dependencies: a phase waits for every earlier
+	// phase it conflicts with, and phases that do not conflict run in parallel
+	class TaskGraph {
+
+	public:
+		TaskGraph(void);
+		~TaskGraph();
+
+		// Add a phase. Returns its index
+		int addTask(const std::string& name, uint32_t reads, uint32_t writes, std::function<void()> body);
+
+		// Build the dependency edges. Must be called after the last addTask and before run
+		void compile(void);
+
+		// Run every phase once, respecting dependencies. Returns when all of them are done
+		// If a phase throws, the phases after it are skipped and run rethrows the exception on the calling thread
+		void run(WorkerPool& pool);
+
+		// Profiling
+		// Graph with average timings in Graphviz dot format, and a one line summary for the log
+		void writeDot(std::ostream& out) const;
+		std::string summary(void) const;
+
+	private:
+		struct Task {
+			std::string name;
+			uint32_t reads;
+			uint32_t writes;
+			std::function<void()> body;
+
+			std::vector<int> successors;
+			int dependencyCount;
+			std::atomic<int> pending;
+
+			double averageMs; // Smoothed run time
+		};
+
+		std::vector<std::unique_ptr<Task>> mTasks;
+		std::atomic<int> mRemaining;
+		bool mCompiled;
+		std::mutex mErrorMutex;
+		std::exception_ptr mError; // The first phase that threw this run
+
+		void Execute(WorkerPool& pool, int index);
+
+	}; // class TaskGraph
+
+} // namespace game
+
+#endif // TASK_GRAPH_H_
@@ -0,0 +1,335 @@
+#include <math.h>
+#include <random>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TERRAIN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TERRAIN_SSE
+#endif
+
+#include "terrain.h"
+
+namespace game {
+
+std::vector<float> Terrain::mHeights;
+int Terrain::mCellsX = 0;
+int Terrain::mCellsZ = 0;
+float Terrain::mCellSize = 1.0f;
+float Terrain::mMinHeight = 0.0f;
+float Terrain::mMaxHeight = 0.0f;
+std::atomic<float> Terrain::mViewHalfAngle(3.14159265f);
+std::atomic<float> Terrain::mViewFar(1.0e9f);
+glm::vec3 Terrain::mViewerPosition(0.0f);
+glm::vec3 Terrain::mViewerDirection(0.0f, 0.0f, -1.0f);
+float Terrain::mViewerSlack = 0.0f;
+
+// The renderer draws in between snapshots, so chunks just outside the view are kept
+static const float VIEW_MARGIN = 0.1f; // Radians
+
+
+// Value noise: random heights on a coarse lattice, blended smoothly in between, summed over a few octaves
+// The lattices wrap around, so the height map tiles
+void Terrain::Generate(int cellsX, int cellsZ, float cellSize, float amplitude, unsigned int seed)
+{
+	mCellsX = cellsX;
+	mCellsZ = cellsZ;
+	mCellSize = cellSize;
+	mHeights.assign((cellsX + 1) * (cellsZ + 1), 0.0f);
+
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	const int OCTAVES = 3;
+	int spacing = 16; // Cells between lattice points of the first octave
+	float weight = 1.0f;
+	float total = 0.0f;
+	for (int octave = 0; octave < OCTAVES; octave++) {
+		int latticeX = std::max(cellsX / spacing, 1);
+		int latticeZ = std::max(cellsZ / spacing, 1);
+		std::vector<float> lattice(latticeX * latticeZ);
+		for (float& value : lattice) value = unit(random);
+
+		for (int z = 0; z <= cellsZ; z++) {
+			for (int x = 0; x <= cellsX; x++) {
+				float u = (float)x * latticeX / cellsX, v = (float)z * latticeZ / cellsZ;
+				int x0 = (int)u % latticeX, z0 = (int)v % latticeZ;
+				int x1 = (x0 + 1) % latticeX, z1 = (z0 + 1) % latticeZ;
+				float tx = u - floorf(u), tz = v - floorf(v);
+				tx = tx * tx * (3.0f - 2.0f * tx);
+				tz = tz * tz * (3.0f - 2.0f * tz);
+				float a = lattice[z0 * latticeX + x0] + (lattice[z0 * latticeX + x1] - lattice[z0 * latticeX + x0]) * tx;
+				float b = lattice[z1 * latticeX + x0] + (lattice[z1 * latticeX + x1] - lattice[z1 * latticeX + x0]) * tx;
+				mHeights[z * (cellsX + 1) + x] += weight * (a + (b - a) * tz);
+			}
+		}
+
+		total += weight;
+		weight *= 0.5f;
+		spacing = std::max(spacing / 2, 1);
+	}
+
+	for (float& height : mHeights) height *= amplitude / total;
+
+	auto range = std::minmax_element(mHeights.begin(), mHeights.end());
+	mMinHeight = *range.first;
+	mMaxHeight = *range.second;
+}
+
+
+float Terrain::getHeight(float x, float z)
+{
+	if (mHeights.empty()) return 0.0f;
+
+	// Wrap into the first tile; the last row and column repeat the first, so ix + 1 is always a sample
+	float fx = x / mCellSize, fz = z / mCellSize;
+	fx -= floorf(fx / mCellsX) * mCellsX;
+	fz -= floorf(fz / mCellsZ) * mCellsZ;
+	int ix = std::min((int)fx, mCellsX - 1);
+	int iz = std::min((int)fz, mCellsZ - 1);
+	float tx = fx - ix, tz = fz - iz;
+
+	float a = Sample(ix, iz) + (Sample(ix + 1, iz) - Sample(ix, iz)) * tx;
+	float b = Sample(ix, iz + 1) + (Sample(ix + 1, iz + 1) - Sample(ix, iz + 1)) * tx;
+	return a + (b - a) * tz;
+}
+
+
+void Terrain::getHeights(const float* x, const float* z, float* out, size_t count)
+{
+	size_t i = 0;
+	if (mHeights.empty()) {
+		std::fill(out, out + count, 0.0f);
+		return;
+	}
+
+	const float* heights = mHeights.data();
+	const int row = mCellsX + 1;
+
+#if defined(TERRAIN_AVX2)
+	const __m256 inv = _mm256_set1_ps(1.0f / mCellSize);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 cellsX = _mm256_set1_ps((float)mCellsX), cellsZ = _mm256_set1_ps((float)mCellsZ);
+	const __m256 invCellsX = _mm256_set1_ps(1.0f / mCellsX), invCellsZ = _mm256_set1_ps(1.0f / mCellsZ);
+	const __m256 lastX = _mm256_set1_ps((float)(mCellsX - 1)), lastZ = _mm256_set1_ps((float)(mCellsZ - 1));
+	const __m256i rowStride = _mm256_set1_epi32(row);
+	const __m256i one = _mm256_set1_epi32(1);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 fx = _mm256_mul_ps(_mm256_loadu_ps(x + i), inv);
+		__m256 fz = _mm256_mul_ps(_mm256_loadu_ps(z + i), inv);
+		// Rounding can leave a wrapped coordinate a hair below zero
+		fx = _mm256_max_ps(_mm256_sub_ps(fx, _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(fx, invCellsX)), cellsX)), zero);
+		fz = _mm256_max_ps(_mm256_sub_ps(fz, _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(fz, invCellsZ)), cellsZ)), zero);
+		__m256 cx = _mm256_min_ps(_mm256_floor_ps(fx), lastX);
+		__m256 cz = _mm256_min_ps(_mm256_floor_ps(fz), lastZ);
+		__m256 tx = _mm256_sub_ps(fx, cx), tz = _mm256_sub_ps(fz, cz);
+
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(cz), rowStride), _mm256_cvttps_epi32(cx));
+		__m256 h00 = _mm256_i32gather_ps(heights, index, 4);
+		__m256 h10 = _mm256_i32gather_ps(heights, _mm256_add_epi32(index, one), 4);
+		index = _mm256_add_epi32(index, rowStride);
+		__m256 h01 = _mm256_i32gather_ps(heights, index, 4);
+		__m256 h11 = _mm256_i32gather_ps(heights, _mm256_add_epi32(index, one), 4);
+
+		__m256 a = _mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h10, h00), tx));
+		__m256 b = _mm256_add_ps(h01, _mm256_mul_ps(_mm256_sub_ps(h11, h01), tx));
+		_mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), tz)));
+	}
+#elif defined(TERRAIN_SSE)
+	// No gather in SSE: the index and weight arithmetic is vectorized, the loads are not
+	const __m128 inv = _mm_set1_ps(1.0f / mCellSize);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 cellsX = _mm_set1_ps((float)mCellsX), cellsZ = _mm_set1_ps((float)mCellsZ);
+	const __m128 invCellsX = _mm_set1_ps(1.0f / mCellsX), invCellsZ = _mm_set1_ps(1.0f / mCellsZ);
+	const __m128 lastX = _mm_set1_ps((float)(mCellsX - 1)), lastZ = _mm_set1_ps((float)(mCellsZ - 1));
+	const __m128 rowStride = _mm_set1_ps((float)row);
+	const __m128 unit = _mm_set1_ps(1.0f);
+
+	// No floor in SSE2 either: truncate, then step down where that rounded up
+	auto floor4 = [&](__m128 v) {
+		__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+		return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), unit));
+	};
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 fx = _mm_mul_ps(_mm_loadu_ps(x + i), inv);
+		__m128 fz = _mm_mul_ps(_mm_loadu_ps(z + i), inv);
+		// Rounding can leave a wrapped coordinate a hair below zero
+		fx = _mm_max_ps(_mm_sub_ps(fx, _mm_mul_ps(floor4(_mm_mul_ps(fx, invCellsX)), cellsX)), zero);
+		fz = _mm_max_ps(_mm_sub_ps(fz, _mm_mul_ps(floor4(_mm_mul_ps(fz, invCellsZ)), cellsZ)), zero);
+		// Truncating is flooring from here on
+		__m128 cx = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(fx)), lastX);
+		__m128 cz = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(fz)), lastZ);
+		__m128 tx = _mm_sub_ps(fx, cx), tz = _mm_sub_ps(fz, cz);
+
+		alignas(16) int index[4];
+		_mm_store_si128((__m128i*)index, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(cz, rowStride), cx)));
+		__m128 h00 = _mm_set_ps(heights[index[3]], heights[index[2]], heights[index[1]], heights[index[0]]);
+		__m128 h10 = _mm_set_ps(heights[index[3] + 1], heights[index[2] + 1], heights[index[1] + 1], heights[index[0] + 1]);
+		__m128 h01 = _mm_set_ps(heights[index[3] + row], heights[index[2] + row], heights[index[1] + row], heights[index[0] + row]);
+		__m128 h11 = _mm_set_ps(heights[index[3] + row + 1], heights[index[2] + row + 1], heights[index[1] + row + 1], heights[index[0] + row + 1]);
+
+		__m128 a = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(h10, h00), tx));
+		__m128 b = _mm_add_ps(h01, _mm_mul_ps(_mm_sub_ps(h11, h01), tx));
+		_mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), tz)));
+	}
+#endif
+
+	for (; i < count; i++) {
+		out[i] = getHeight(x[i], z[i]);
+	}
+}
+
+
+glm::vec3 Terrain::getNormal(float x, float z)
+{
+	float dx = getHeight(x + mCellSize, z) - getHeight(x - mCellSize, z);
+	float dz = getHeight(x, z + mCellSize) - getHeight(x, z - mCellSize);
+	return glm::normalize(glm::vec3(-dx, 2.0f * mCellSize, -dz));
+}
+
+
+void Terrain::setViewVolume(float fovDegrees, float aspect, float farDistance)
+{
+	// Cone through the corners of the frustum
+	float tanVertical = tanf(glm::radians(fovDegrees) / 2.0f);
+	float tanHorizontal = tanVertical * aspect;
+	mViewHalfAngle = atanf(sqrtf(tanVertical * tanVertical + tanHorizontal * tanHorizontal));
+	mViewFar = farDistance;
+}
+
+
+void Terrain::setViewer(const RenderView& view)
+{
+	// The camera looks down its -forward axis, see Camera::ComputeViewMatrix
+	mViewerPosition = view.position;
+	mViewerDirection = -glm::normalize(view.orientation * view.forward);
+	mViewerSlack = view.thirdPerson ? glm::length(view.playerOffset) : 0.0f;
+}
+
+
+bool Terrain::isVisible(const glm::vec3& center, float radius)
+{
+	radius += mViewerSlack;
+	glm::vec3 toCenter = center - mViewerPosition;
+	float distance = glm::length(toCenter);
+	if (distance <= radius) return true;
+	if (distance - radius > mViewFar) return false;
+
+	float angle = acosf(glm::clamp(glm::dot(toCenter, mViewerDirection) / distance, -1.0f, 1.0f));
+	return angle <= mViewHalfAngle + asinf(radius / distance) + VIEW_MARGIN;
+}
+
+
+TerrainLodNode::TerrainLodNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture)
+	: SceneNode(name, geometry, material, texture)
+	, mQuarterArrayBuffer(0)
+	, mQuarterElementArrayBuffer(0)
+	, mQuarterSize(0)
+{
+	collisionType = None;
+	mCollisionLayer = LayerNone;
+
+	mLeafSize = PATCH_CELLS * Terrain::getCellSize();
+}
+
+
+TerrainLodNode::~TerrainLodNode()
+{
+}
+
+
+void TerrainLodNode::setQuarterPatch(const Resource *geometry)
+{
+	mQuarterArrayBuffer = geometry->getArrayBuffer();
+	mQuarterElementArrayBuffer = geometry->getElementArrayBuffer();
+	mQuarterSize = geometry->getSize();
+}
+
+
+void TerrainLodNode::extract(RenderSnapshot& snapshot, const NodeTransform& parent)
+{
+	// Roots tile the plane; walk the ones the top level's range reaches. Anything past it is past the far plane
+	const int top = LOD_LEVELS - 1;
+	float rootSize = mLeafSize * (float)(1 << top);
+	glm::vec3 viewer = Terrain::getViewerPosition();
+	int firstX = (int)floorf((viewer.x - Range(top)) / rootSize), lastX = (int)floorf((viewer.x + Range(top)) / rootSize);
+	int firstZ = (int)floorf((viewer.z - Range(top)) / rootSize), lastZ = (int)floorf((viewer.z + Range(top)) / rootSize);
+	for (int z = firstZ; z <= lastZ; z++) {
+		for (int x = firstX; x <= lastX; x++) {
+			Select(snapshot, x * rootSize, z * rootSize, rootSize, top);
+		}
+	}
+
+	for (BaseNode* bn : getChildNodes())
+	{
+		dynamic_cast<SceneNode*>(bn)->extract(snapshot, parent);
+	}
+}
+
+
+// Distance from the viewer to the node's box, heights included
+bool TerrainLodNode::Intersects(float x, float z, float size, float range) const
+{
+	glm::vec3 viewer = Terrain::getViewerPosition();
+	glm::vec3 min(x, Terrain::getMinHeight(), z);
+	glm::vec3 max(x + size, Terrain::getMaxHeight(), z + size);
+	glm::vec3 closest = glm::clamp(viewer, min, max);
+	return glm::length(viewer - closest) <= range;
+}
+
+
+// False if the node is out of its level's range, which leaves it to the level above
+bool TerrainLodNode::Select(RenderSnapshot& snapshot, float x, float z, float size, int level)
+{
+	if (!Intersects(x, z, size, Range(level))) return false;
+
+	if (level == 0 || !Intersects(x, z, size, Range(level - 1))) {
+		EmitPatch(snapshot, x, z, size, level, false);
+		return true;
+	}
+
+	float half = size / 2.0f;
+	for (int child = 0; child < 4; child++) {
+		float childX = x + (child & 1) * half;
+		float childZ = z + (child >> 1) * half;
+		if (!Select(snapshot, childX, childZ, half, level - 1)) {
+			EmitPatch(snapshot, childX, childZ, half, level, true);
+		}
+	}
+	return true;
+}
+
+
+void TerrainLodNode::EmitPatch(RenderSnapshot& snapshot, float x, float z, float size, int level, bool quarter)
+{
+	if (quarter && mQuarterSize == 0) return;
+
+	glm::vec3 center(x + size / 2.0f, (Terrain::getMinHeight() + Terrain::getMaxHeight()) / 2.0f, z + size / 2.0f);
+	float radius = glm::length(glm::vec3(size, Terrain::getMaxHeight() - Terrain::getMinHeight(), size)) / 2.0f;
+	if (!Terrain::isVisible(center, radius)) return;
+
+	// The mesh is in grid steps, so the scale is the spacing of the level's grid
+	float spacing = size / (quarter ? PATCH_CELLS / 2 : PATCH_CELLS);
+
+	RenderItem item;
+	// Node indices wrap, but patches that share an id are too far apart to be drawn together
+	uint32_t indexX = (uint32_t)(int)floorf(x / size) & 0xfff, indexZ = (uint32_t)(int)floorf(z / size) & 0x1fff;
+	item.id = PATCH_ID_BIT | (quarter ? 0x40000000 : 0) | ((uint32_t)level << 25) | (indexZ << 12) | indexX;
+	item.position = glm::vec3(x, 0.0f, z);
+	item.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	item.scale = glm::vec3(spacing, 1.0f, spacing);
+	item.mode = mMode;
+	item.arrayBuffer = quarter ? mQuarterArrayBuffer : mArrayBuffer;
+	item.elementArrayBuffer = quarter ? mQuarterElementArrayBuffer : mElementArrayBuffer;
+	item.size = quarter ? mQuarterSize : mSize;
+	item.material = mMaterial;
+	item.texture = mTexture;
+	item.envmap = mEnvmap;
+	snapshot.items.push_back(item);
+}
+
+} // namespace game
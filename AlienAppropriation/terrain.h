@@ -0,0 +1,118 @@
+#ifndef TERRAIN_H_
+#define TERRAIN_H_
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <stddef.h>
+
+#include <glm/glm.hpp>
+
+#include "scene_node.h"
+#include "render_snapshot.h"
+
+namespace game {
+
+	// class Terrain
+	// The ground: one height map, repeated in every direction so the world has no edge, drawn by TerrainLodNode
+	// Heights are samples on a regular grid of cells; between samples they are bilinear, so a query is
+	// four loads and a few multiplies wherever it is
+	class Terrain {
+
+	public:
+		// Build the height map: cellsX by cellsZ cells of cellSize, smooth noise between 0 and amplitude that tiles
+		static void Generate(int cellsX, int cellsZ, float cellSize, float amplitude, unsigned int seed);
+
+		// Height of the ground under (x, z)
+		static float getHeight(float x, float z);
+		// getHeight for count points. Uses AVX2 or SSE when the build enables them
+		static void getHeights(const float* x, const float* z, float* out, size_t count);
+		static glm::vec3 getNormal(float x, float z);
+
+		inline static float getCellSize(void) { return mCellSize; }
+		// Size of one tile of the height map
+		inline static float getSizeX(void) { return mCellsX * mCellSize; }
+		inline static float getSizeZ(void) { return mCellsZ * mCellSize; }
+		inline static float getMinHeight(void) { return mMinHeight; }
+		inline static float getMaxHeight(void) { return mMaxHeight; }
+		// The raw samples, getSampleCountX per row, for uploading as a texture. The last row and column
+		// repeat the first, so the tile itself is one sample smaller each way
+		inline static const float* getSamples(void) { return mHeights.data(); }
+		inline static int getSampleCountX(void) { return mCellsX + 1; }
+		inline static int getSampleCountZ(void) { return mCellsZ + 1; }
+
+		// Culling. The view volume comes from the projection (any thread), the viewer from the
+		// camera when a snapshot is extracted
+		static void setViewVolume(float fovDegrees, float aspect, float farDistance);
+		static void setViewer(const RenderView& view);
+		inline static glm::vec3 getViewerPosition(void) { return mViewerPosition; }
+		static bool isVisible(const glm::vec3& center, float radius);
+
+	private:
+		static std::vector<float> mHeights; // (cellsX + 1) * (cellsZ + 1) samples, one row of x per z
+		static int mCellsX;
+		static int mCellsZ;
+		static float mCellSize;
+		static float mMinHeight;
+		static float mMaxHeight;
+
+		static std::atomic<float> mViewHalfAngle; // Half angle of a cone around the frustum
+		static std::atomic<float> mViewFar;
+		static glm::vec3 mViewerPosition;
+		static glm::vec3 mViewerDirection;
+		static float mViewerSlack; // How far the eye can be from the camera node
+
+		inline static float Sample(int x, int z) { return mHeights[z * (mCellsX + 1) + x]; }
+
+	}; // class Terrain
+
+
+	// class TerrainLodNode
+	// Draws the terrain as a continuous level of detail quadtree (CDLOD) around the viewer
+	// Every tick the quadtrees are walked from the roots around the viewer: a node is drawn whole once it is
+	// past the range of the level below it, otherwise it is split. Each drawn node is the same patch mesh, scaled to the node
+	// and given its heights by the vertex shader from the height map texture, so nothing is rebuilt as the
+	// viewer moves. Towards the end of its range a level's vertices morph onto the grid of the next level,
+	// so there are no seams or pops between levels.
+	// The number of patches drawn depends on the ranges and the far plane, not on where the viewer is
+	class TerrainLodNode : public SceneNode {
+
+	public:
+		// Grid steps along a patch. Leaf patches have one step per height map cell
+		static const int PATCH_CELLS = 16;
+		// Each level is drawn out to this many times its node size from the viewer. It has to stay well
+		// above the diagonal of a node for neighbouring patches to be at most one level apart
+		static constexpr float LOD_RANGE_RATIO = 4.0f;
+		// Levels in a quadtree. The top level's range has to reach past the far plane
+		static const int LOD_LEVELS = 5;
+
+		// Items for terrain patches carry this bit in their id, with the patch's place in the quadtree in the
+		// rest, so a patch keeps its id from one snapshot to the next
+		static const uint32_t PATCH_ID_BIT = 0x80000000;
+
+		// geometry is the full patch, a grid of PATCH_CELLS steps in grid units
+		TerrainLodNode(const std::string name, const Resource *geometry, const Resource *material, const Resource *texture = NULL);
+		~TerrainLodNode();
+
+		// Half-resolution patch for the quarters of a split node that are still drawn at its level:
+		// a grid of PATCH_CELLS / 2 steps
+		void setQuarterPatch(const Resource *geometry);
+
+		virtual void extract(RenderSnapshot& snapshot, const NodeTransform& parent);
+
+	private:
+		float mLeafSize; // Level 0 are the leaves
+		GLuint mQuarterArrayBuffer;
+		GLuint mQuarterElementArrayBuffer;
+		GLsizei mQuarterSize;
+
+		inline float Range(int level) const { return LOD_RANGE_RATIO * mLeafSize * (float)(1 << level); }
+		bool Intersects(float x, float z, float size, float range) const;
+		bool Select(RenderSnapshot& snapshot, float x, float z, float size, int level);
+		void EmitPatch(RenderSnapshot& snapshot, float x, float z, float size, int level, bool quarter);
+
+	}; // class TerrainLodNode
+
+} // namespace game
+
+#endif // TERRAIN_H_
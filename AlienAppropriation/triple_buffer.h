@@ -0,0 +1,62 @@
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <stdint.h>
+
+namespace game {
+
+	// class TripleBuffer
+	// Lock-free hand-off of the latest value from one producer thread to one consumer thread.
+	// The producer always owns a back buffer and the consumer a front buffer; the third buffer sits in
+	// the middle and is swapped atomically, so neither side ever waits for the other. If the producer
+	// publishes several times before the consumer looks, the consumer simply sees the newest one.
+	template<class T>
+	class TripleBuffer {
+
+	public:
+		TripleBuffer()
+			: mBack(0)
+			, mMiddle(1 << kIndexShift)
+			, mFront(2)
+		{
+		}
+
+		// Producer side: the buffer to fill in, and publishing it once it is complete
+		inline T& backBuffer() { return mBuffers[mBack]; }
+
+		void publish()
+		{
+			uint8_t previous = mMiddle.exchange((uint8_t)((mBack << kIndexShift) | kFreshBit), std::memory_order_acq_rel);
+			mBack = (previous >> kIndexShift) & kIndexMask;
+		}
+
+		// Consumer side: grab the newest published buffer if there is one
+		// Returns true if the front buffer changed
+		bool update()
+		{
+			if ((mMiddle.load(std::memory_order_relaxed) & kFreshBit) == 0) return false;
+
+			uint8_t previous = mMiddle.exchange((uint8_t)(mFront << kIndexShift), std::memory_order_acq_rel);
+			mFront = (previous >> kIndexShift) & kIndexMask;
+			return true;
+		}
+
+		inline const T& frontBuffer() const { return mBuffers[mFront]; }
+
+	private:
+		// The middle slot packs a buffer index and a flag saying whether it holds unread data
+		static const uint8_t kFreshBit = 1;
+		static const uint8_t kIndexShift = 1;
+		static const uint8_t kIndexMask = 3;
+
+		T mBuffers[3];
+		uint8_t mBack;
+		std::atomic<uint8_t> mMiddle;
+		uint8_t mFront;
+
+	}; // class TripleBuffer
+
+} // namespace game
+
+#endif // TRIPLE_BUFFER_H_
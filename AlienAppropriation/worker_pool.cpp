@@ -0,0 +1,153 @@
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "worker_pool.h"
+
+namespace game {
+
+// Set while this thread runs a background job, so the jobs it starts stay in the background
+static thread_local bool in_background_job_g = false;
+
+
+WorkerPool::WorkerPool(unsigned int threadCount)
+	: mStopping(false)
+{
+	for (unsigned int i = 0; i < threadCount; i++) {
+		mThreads.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+	}
+}
+
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWake.notify_all();
+
+	for (std::thread& t : mThreads) {
+		t.join();
+	}
+}
+
+
+WorkerPool& WorkerPool::Shared(void)
+{
+	static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+
+void WorkerPool::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(std::move(job));
+	}
+	mWake.notify_one();
+}
+
+
+void WorkerPool::submitBackground(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBackgroundJobs.push_back(std::move(job));
+	}
+	mWake.notify_one();
+}
+
+
+bool WorkerPool::runPendingJob(void)
+{
+	std::function<void()> job;
+	bool background = false;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mJobs.empty()) {
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+		else if (mThreads.empty() && !mBackgroundJobs.empty()) {
+			job = std::move(mBackgroundJobs.front());
+			mBackgroundJobs.pop_front();
+			background = true;
+		}
+		else {
+			return false;
+		}
+	}
+
+	RunJob(job, background);
+	return true;
+}
+
+
+void WorkerPool::RunJob(std::function<void()>& job, bool background)
+{
+	bool outer = in_background_job_g;
+	in_background_job_g = background;
+	job();
+	in_background_job_g = outer;
+}
+
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+	if (count == 0) return;
+
+	// Shared with the helper jobs, which may still be sitting in the queue after we return
+	struct State {
+		std::atomic<size_t> next;
+		std::atomic<size_t> remaining;
+		const std::function<void(size_t)>* body;
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->next = 0;
+	state->remaining = count;
+	state->body = &body;
+
+	auto work = [state, count]() {
+		for (size_t i = state->next++; i < count; i = state->next++) {
+			(*state->body)(i);
+			state->remaining--;
+		}
+	};
+
+	size_t helpers = std::min(mThreads.size(), count - 1);
+	for (size_t i = 0; i < helpers; i++) {
+		if (in_background_job_g) submitBackground(work);
+		else submit(work);
+	}
+
+	work();
+
+	// Other threads may still be finishing their last index
+	while (state->remaining > 0) {
+		if (!runPendingJob()) std::this_thread::yield();
+	}
+}
+
+
+void WorkerPool::WorkerLoop(void)
+{
+	for (;;) {
+		std::function<void()> job;
+		bool background;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mStopping || !mJobs.empty() || !mBackgroundJobs.empty(); });
+			if (mStopping && mJobs.empty() && mBackgroundJobs.empty()) return;
+			background = mJobs.empty();
+			std::deque<std::function<void()>>& queue = background ? mBackgroundJobs : mJobs;
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		RunJob(job, background);
+	}
+}
+
+} // namespace game
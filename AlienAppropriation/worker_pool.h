@@ -0,0 +1,59 @@
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace game {
+
+	// class WorkerPool
+	// A fixed set of worker threads shared by everything that wants to run work in parallel
+	// Threads that wait on pool work (parallelFor, TaskGraph::run) execute queued jobs themselves while
+	// they wait, so waiting from inside a job never deadlocks and a pool with no workers still works
+	// Background jobs are kept apart and only the workers run them, so a long one never lands on a waiter
+	class WorkerPool {
+
+	public:
+		WorkerPool(unsigned int threadCount);
+		~WorkerPool();
+
+		// The pool used by the game, sized to the machine (one thread is left for the caller)
+		static WorkerPool& Shared(void);
+
+		// Queue a job to be run by any thread
+		void submit(std::function<void()> job);
+
+		// Queue a job that nothing waits on to finish soon, like planning a map chunk. Only the workers run
+		// these, after the jobs from submit, so the simulation thread never picks one up while it waits out a tick
+		void submitBackground(std::function<void()> job);
+
+		// Run one job from submit on the calling thread. Returns false if there was nothing to do
+		// A pool without workers has no one else to run background jobs, so then it runs those too
+		bool runPendingJob(void);
+
+		// Call body(i) for every i in [0, count) using the workers and the calling thread
+		// Returns once every call has finished. Called from a background job, its helpers are background jobs too
+		void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+		inline size_t getThreadCount(void) const { return mThreads.size(); }
+
+	private:
+		std::vector<std::thread> mThreads;
+		std::deque<std::function<void()>> mJobs;
+		std::deque<std::function<void()>> mBackgroundJobs;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		bool mStopping;
+
+		void WorkerLoop(void);
+		void RunJob(std::function<void()>& job, bool background);
+
+	}; // class WorkerPool
+
+} // namespace game
+
+#endif // WORKER_POOL_H_
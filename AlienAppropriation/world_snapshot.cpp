@@ -0,0 +1,456 @@
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "world_snapshot.h"
+#include "byte_stream.h"
+#include "block_compressor.h"
+#include "prefab.h"
+#include "projectile_node.h"
+#include "player_node.h"
+
+namespace game {
+
+// A file, read only, mapped into memory for as long as the object lives
+class MappedFile {
+
+public:
+	MappedFile(void) : mData(NULL), mSize(0)
+#ifdef _WIN32
+		, mFile(INVALID_HANDLE_VALUE), mMapping(NULL)
+#endif
+	{
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (mData) UnmapViewOfFile(mData);
+		if (mMapping) CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+#else
+		if (mData) munmap((void*)mData, mSize);
+#endif
+	}
+
+	// Returns false if the file cannot be opened
+	bool open(const std::string& path)
+	{
+#ifdef _WIN32
+		mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (mFile == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(mFile, &size)) return false;
+		mSize = (size_t)size.QuadPart;
+		if (mSize == 0) return true; // Nothing to map
+		mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mMapping) return false;
+		mData = (const char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+		return mData != NULL;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			close(fd);
+			return false;
+		}
+		mSize = (size_t)info.st_size;
+		if (mSize == 0) {
+			close(fd);
+			return true;
+		}
+		void* data = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping keeps the file open
+		close(fd);
+		if (data == MAP_FAILED) return false;
+		mData = (const char*)data;
+		return true;
+#endif
+	}
+
+	inline const char* getData(void) const { return mData; }
+	inline size_t getSize(void) const { return mSize; }
+
+private:
+	const char* mData;
+	size_t mSize;
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#endif
+
+}; // class MappedFile
+
+
+// Snapshot files: a header, then the contents, which are compressed if the flag says so
+// The contents are the seed, the names of the prefabs used, the camera, the player, the map's state, the nodes
+// spawned from prefabs and the missiles
+static const char SNAPSHOT_MAGIC[4] = { 'A', 'A', 'S', 'N' };
+static const uint32_t SNAPSHOT_COMPRESSED = 1;
+
+struct SnapshotHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t payloadSize; // Of the contents
+	uint64_t storedSize;  // Of what follows the header
+};
+
+// Per node flags
+static const uint8_t NODE_ENTITY = 1;   // Followed by its velocity
+static const uint8_t NODE_GROUNDED = 2;
+static const uint8_t NODE_PLANNED = 4;  // Followed by its home chunk and plan index
+
+
+WorldSnapshot::WorldSnapshot(void)
+	: mFile(NULL)
+	, mPayload(NULL)
+	, mPayloadSize(0)
+	, mSeed(0)
+{
+}
+
+
+WorldSnapshot::~WorldSnapshot()
+{
+	delete mFile;
+}
+
+
+void WorldSnapshot::Save(const std::string& path, SceneGraph* scene, const MapGenerator& map, unsigned int seed, bool compress)
+{
+	std::vector<SceneNode*> nodes;
+	std::vector<HeatMissileNode*> missiles;
+	std::vector<PrefabId> prefabs; // The prefabs used, in the order the file numbers them
+	std::vector<uint16_t> fileIndex(Prefabs::getCount(), 0xffff);
+	for (BaseNode* child : SceneGraph::getRootNode()->getChildNodes()) {
+		if (HeatMissileNode* missile = dynamic_cast<HeatMissileNode*>(child)) {
+			missiles.push_back(missile);
+			continue;
+		}
+		SceneNode* node = dynamic_cast<SceneNode*>(child);
+		if (!node || node->getPrefab() == Prefabs::NO_PREFAB) continue;
+		if (fileIndex[node->getPrefab()] == 0xffff) {
+			fileIndex[node->getPrefab()] = (uint16_t)prefabs.size();
+			prefabs.push_back(node->getPrefab());
+		}
+		nodes.push_back(node);
+	}
+
+	std::vector<char> payload;
+	ByteWriter writer(payload);
+	writer.put((uint32_t)seed);
+
+	writer.put((uint32_t)prefabs.size());
+	for (PrefabId prefab : prefabs) {
+		writer.putString(Prefabs::getName(prefab));
+	}
+
+	Camera* camera = scene->getCameraNode();
+	writer.put(camera->getPosition());
+	writer.put(camera->getOrientation());
+	writer.put(camera->getVelocityRelative());
+	writer.put(camera->getPlayerForward());
+
+	PlayerNode* player = SceneGraph::getPlayerNode();
+	writer.put(*player->getHullStrength());
+	writer.put(*player->getEnergy());
+	writer.put((int32_t)player->getCowsCollected());
+	writer.put((int32_t)player->getHayCollected());
+
+	map.WriteState(writer);
+
+	writer.put((uint32_t)nodes.size());
+	for (SceneNode* node : nodes) {
+		writer.put(fileIndex[node->getPrefab()]);
+		writer.putString(node->getName());
+		writer.put(node->getPosition());
+		writer.put(node->getOrientation());
+		writer.put(node->getscale());
+
+		EntityNode* entity = dynamic_cast<EntityNode*>(node);
+		uint8_t flags = 0;
+		if (entity) flags |= NODE_ENTITY;
+		if (entity && entity->getIsGrounded()) flags |= NODE_GROUNDED;
+		if (node->getPlanIndex() != SceneNode::NOT_PLANNED) flags |= NODE_PLANNED;
+		writer.put(flags);
+		if (entity) writer.put(entity->getVelocity());
+		if (flags & NODE_PLANNED) {
+			writer.put(node->getHomeChunk());
+			writer.put(node->getPlanIndex());
+		}
+
+		const std::vector<std::string>& tags = node->getTags();
+		writer.put((uint32_t)tags.size());
+		for (const std::string& tag : tags) {
+			writer.putString(tag);
+		}
+	}
+
+	writer.put((uint32_t)missiles.size());
+	for (HeatMissileNode* missile : missiles) {
+		writer.putString(missile->getName());
+		writer.put(missile->getPosition());
+		writer.put(missile->getVelocity());
+		writer.put(missile->getOrientation());
+		writer.put(missile->getRemainingLife());
+	}
+
+	// The whole file in one buffer: header, then the contents as they are or compressed
+	SnapshotHeader header;
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = VERSION;
+	header.flags = 0;
+	header.reserved = 0;
+	header.payloadSize = payload.size();
+
+	std::vector<char> file(sizeof(header));
+	if (compress) {
+		BlockCompressor::Compress(payload.data(), payload.size(), file);
+	}
+	// Stored as it is when compressing does not pay
+	if (compress && file.size() - sizeof(header) < payload.size()) {
+		header.flags |= SNAPSHOT_COMPRESSED;
+	}
+	else {
+		file.resize(sizeof(header));
+		file.insert(file.end(), payload.begin(), payload.end());
+	}
+	header.storedSize = file.size() - sizeof(header);
+	memcpy(file.data(), &header, sizeof(header));
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out.write(file.data(), file.size())) {
+		throw(GameException(std::string("Could not write snapshot \"") + path + std::string("\"")));
+	}
+}
+
+
+bool WorldSnapshot::open(const std::string& path)
+{
+	mPath = path;
+	delete mFile;
+	mFile = new MappedFile();
+	if (!mFile->open(path)) return false;
+
+	SnapshotHeader header;
+	if (mFile->getSize() < sizeof(header)) {
+		throw(GameException(std::string("\"") + path + std::string("\" is not a snapshot")));
+	}
+	memcpy(&header, mFile->getData(), sizeof(header));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION) {
+		throw(GameException(std::string("\"") + path + std::string("\" is not a snapshot")));
+	}
+	if (header.storedSize != mFile->getSize() - sizeof(header)) {
+		throw(GameException(std::string("Snapshot \"") + path + std::string("\" is cut short")));
+	}
+
+	const char* stored = mFile->getData() + sizeof(header);
+	if (header.flags & SNAPSHOT_COMPRESSED) {
+		mDecompressed.resize((size_t)header.payloadSize);
+		if (!BlockCompressor::Decompress(stored, (size_t)header.storedSize, mDecompressed.data(), mDecompressed.size())) {
+			throw(GameException(std::string("Snapshot \"") + path + std::string("\" is damaged")));
+		}
+		mPayload = mDecompressed.data();
+		mPayloadSize = mDecompressed.size();
+	}
+	else {
+		mPayload = stored;
+		mPayloadSize = (size_t)header.storedSize;
+	}
+
+	ByteReader reader(mPayload, mPayloadSize, std::string("Snapshot \"") + path + std::string("\""));
+	uint32_t seed;
+	reader.get(seed);
+	mSeed = seed;
+	return true;
+}
+
+
+void WorldSnapshot::restore(SceneGraph* scene, MapGenerator& map)
+{
+	// Read all of it first: a snapshot that is damaged anywhere throws here, before the scene is touched
+	ByteReader reader(mPayload, mPayloadSize, std::string("Snapshot \"") + mPath + std::string("\""));
+	uint32_t seed;
+	reader.get(seed);
+	if (seed != map.getSeed()) {
+		throw(GameException(std::string("Snapshot \"") + mPath + std::string("\" is of another world, seed ") + std::to_string(seed)));
+	}
+
+	uint32_t prefabCount;
+	reader.get(prefabCount);
+	std::vector<PrefabId> prefabs;
+	for (uint32_t i = 0; i < prefabCount; i++) {
+		std::string name = reader.getString();
+		PrefabId prefab = Prefabs::find(name);
+		if (prefab == Prefabs::NO_PREFAB) {
+			throw(GameException(std::string("Snapshot \"") + mPath + std::string("\" uses unknown prefab \"") + name + std::string("\"")));
+		}
+		prefabs.push_back(prefab);
+	}
+
+	glm::vec3 cameraPosition, cameraVelocity, playerForward;
+	glm::quat cameraOrientation;
+	reader.get(cameraPosition);
+	reader.get(cameraOrientation);
+	reader.get(cameraVelocity);
+	reader.get(playerForward);
+
+	float hull, energy;
+	int32_t cows, hay;
+	reader.get(hull);
+	reader.get(energy);
+	reader.get(cows);
+	reader.get(hay);
+	if (cows < 0 || hay < 0) {
+		throw(GameException(std::string("Snapshot \"") + mPath + std::string("\" is damaged")));
+	}
+
+	MapGenerator::State mapState;
+	MapGenerator::ReadState(reader, mapState);
+
+	struct NodeState {
+		uint8_t flags;
+		glm::vec3 velocity;
+		uint64_t homeChunk;
+		uint32_t planIndex;
+		std::vector<std::string> tags;
+	};
+
+	uint32_t nodeCount;
+	reader.get(nodeCount);
+	std::vector<PrefabInstance> instances;
+	std::vector<NodeState> states;
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		PrefabInstance instance;
+		NodeState state;
+		uint16_t index;
+		glm::vec3 position, scale;
+		glm::quat orientation;
+		reader.get(index);
+		if (index >= prefabs.size()) {
+			throw(GameException(std::string("Snapshot \"") + mPath + std::string("\" is damaged")));
+		}
+		instance.prefab = prefabs[index];
+		instance.name = reader.getString();
+		reader.get(position);
+		reader.get(orientation);
+		reader.get(scale);
+
+		// The snapshot has the final transform; take the prefab's part back out, SpawnBatch puts it in again
+		const Prefab& prefab = Prefabs::get(instance.prefab);
+		instance.position = position - prefab.offset;
+		instance.orientation = orientation * glm::inverse(prefab.orientation);
+		instance.scale = scale / prefab.scale;
+
+		reader.get(state.flags);
+		if (state.flags & NODE_ENTITY) reader.get(state.velocity);
+		state.homeChunk = 0;
+		state.planIndex = SceneNode::NOT_PLANNED;
+		if (state.flags & NODE_PLANNED) {
+			reader.get(state.homeChunk);
+			reader.get(state.planIndex);
+		}
+		uint32_t tagCount;
+		reader.get(tagCount);
+		for (uint32_t t = 0; t < tagCount; t++) {
+			state.tags.push_back(reader.getString());
+		}
+
+		instances.push_back(std::move(instance));
+		states.push_back(std::move(state));
+	}
+
+	struct MissileState {
+		std::string name;
+		glm::vec3 position;
+		glm::vec3 velocity;
+		glm::quat orientation;
+		float life;
+	};
+
+	uint32_t missileCount;
+	reader.get(missileCount);
+	std::vector<MissileState> missiles;
+	for (uint32_t i = 0; i < missileCount; i++) {
+		MissileState missile;
+		missile.name = reader.getString();
+		reader.get(missile.position);
+		reader.get(missile.velocity);
+		reader.get(missile.orientation);
+		reader.get(missile.life);
+		missiles.push_back(std::move(missile));
+	}
+
+	if (!reader.atEnd()) {
+		throw(GameException(std::string("Snapshot \"") + mPath + std::string("\" is damaged")));
+	}
+
+	// All of it is good, put it in place
+	Camera* camera = scene->getCameraNode();
+	camera->setPosition(cameraPosition);
+	camera->setOrientation(cameraOrientation);
+	camera->setVelocity(cameraVelocity);
+	camera->setPlayerForward(playerForward);
+
+	PlayerNode* player = SceneGraph::getPlayerNode();
+	*player->getHullStrength() = hull;
+	*player->getEnergy() = energy;
+	player->restoreCollected(cows, hay);
+
+	// Everything the snapshot replaces goes
+	for (BaseNode* child : SceneGraph::getRootNode()->getChildNodes()) {
+		SceneNode* node = dynamic_cast<SceneNode*>(child);
+		if (node && (node->getPrefab() != Prefabs::NO_PREFAB || dynamic_cast<HeatMissileNode*>(node))) {
+			SceneGraph::deleteNode(node);
+		}
+	}
+
+	map.setState(mapState);
+
+	std::vector<SceneNode*> nodes;
+	nodes.reserve(instances.size());
+	SceneGraph::SpawnBatch(instances.data(), instances.size(), &nodes);
+	for (size_t i = 0; i < nodes.size(); i++) {
+		SceneNode* node = nodes[i];
+		const NodeState& state = states[i];
+		EntityNode* entity = dynamic_cast<EntityNode*>(node);
+		if (entity && (state.flags & NODE_ENTITY)) {
+			entity->setVelocity(state.velocity);
+			entity->setIsGrounded((state.flags & NODE_GROUNDED) != 0);
+		}
+		// Ground entities start facing heading 0; the saved orientation is the heading they had
+		if (entity) entity->setHeadingFrom(node->getOrientation());
+		node->setHome(state.homeChunk, state.planIndex);
+
+		// Tags changed since the node was spawned (a bale that was lifted, say) are as they were
+		std::vector<std::string> current = node->getTags();
+		for (const std::string& tag : current) {
+			if (std::find(state.tags.begin(), state.tags.end(), tag) == state.tags.end()) node->removeTag(tag);
+		}
+		for (const std::string& tag : state.tags) {
+			if (!node->hasTag(tag)) node->addTag(tag);
+		}
+	}
+
+	for (const MissileState& state : missiles) {
+		HeatMissileNode* missile = SceneGraph::CreateProjectileInstance<HeatMissileNode>(state.name, "missileMesh", "texturedMaterial", "missileTexture", state.life, state.position, state.velocity);
+		missile->setOrientation(state.orientation);
+		SceneGraph::setCollisionLayer(missile, LayerProjectile);
+	}
+}
+
+} // namespace game
@@ -0,0 +1,57 @@
+#ifndef WORLD_SNAPSHOT_H_
+#define WORLD_SNAPSHOT_H_
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scene_graph.h"
+#include "map_generator.h"
+
+namespace game {
+
+	class MappedFile;
+
+	// class WorldSnapshot
+	// A session in one file: the world seed, the camera, the player's stats and what it carries, every node spawned
+	// from a prefab with its transform, tags and motion, the missiles in flight, and the chunks the map has loaded
+	// and still has queued. The file is built in one buffer and written at once, compressed with BlockCompressor
+	// if asked. Opening one maps the file into memory and reads it in place, and restoring spawns the nodes with
+	// SceneGraph::SpawnBatch, so a large scene comes back in a fraction of the time it takes to generate
+	// Behaviours are suspended coroutines, which cannot be written out: restored entities start theirs over
+	class WorldSnapshot {
+
+	public:
+		static const uint32_t VERSION = 2;
+
+		// Write the world as it is now, on the simulation thread between ticks or before the first one
+		static void Save(const std::string& path, SceneGraph* scene, const MapGenerator& map, unsigned int seed, bool compress);
+
+		WorldSnapshot(void);
+		~WorldSnapshot();
+
+		// Returns false if the file does not exist, throws if it is not a snapshot
+		bool open(const std::string& path);
+		// The world the snapshot was taken in. The terrain comes from the seed, so it must be restored into the same one
+		inline unsigned int getSeed(void) const { return mSeed; }
+
+		// Replace what was spawned from prefabs, the map's chunks, the missiles and the player's state with the
+		// snapshot's. Changes go through the scene graph like any other, so call it where the scene may change
+		// The whole snapshot is read and checked first: if it throws, nothing has changed
+		void restore(SceneGraph* scene, MapGenerator& map);
+
+	private:
+		std::string mPath;
+		MappedFile* mFile;
+		std::vector<char> mDecompressed;
+		// Where the contents are: in the mapped file, or in mDecompressed
+		const char* mPayload;
+		size_t mPayloadSize;
+		unsigned int mSeed;
+
+	}; // class WorldSnapshot
+
+} // namespace game
+
+#endif // WORLD_SNAPSHOT_H_